@@ -0,0 +1,315 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <utility>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include <omp.h>
+
+#include "kmercode/hash_funcs.h"
+#include "kmercode/Kmer.hpp"
+#include "kmercode/Buffer.h"
+#include "kmercode/common.h"
+#include "kmercode/fq_reader.h"
+#include "kmercode/ParallelFASTQ.h"
+
+#include "mtspgemm2017/utility.h"
+#include "mtspgemm2017/CSC.h"
+#include "mtspgemm2017/CSR.h"
+#include "mtspgemm2017/common.h"
+#include "mtspgemm2017/IO.h"
+#include "mtspgemm2017/overlapping.h"
+#include "mtspgemm2017/align.h"
+
+using namespace std;
+
+//
+// bella-test: checks of the alignment kernels and the seed sampling on small synthetic reads, exits with 1 if any check fails
+// Run with: make -f makefile-nersc check
+//
+
+static int failures = 0;
+
+#define EXPECT(cond, what) do { if(!(cond)) { ++failures; cerr << "FAILED " << (what) << " (" << #cond << ")" << endl; } } while(0)
+
+static string randomRead(mt19937 & rng, int len)
+{
+    static const char bases[] = "ACGT";
+    string seq(len, 'A');
+    for(char & c : seq)
+        c = bases[rng() % 4];
+    return seq;
+}
+
+static string reverseStrand(const string & seq)
+{
+    string rc(seq.rbegin(), seq.rend());
+    for(char & c : rc)
+        c = complementBase(c);
+    return rc;
+}
+
+/**
+ * @brief mutate copies seq with substitutions, insertions and deletions, each at a third of the error rate
+ */
+static string mutate(mt19937 & rng, const string & seq, double erate)
+{
+    static const char bases[] = "ACGT";
+    uniform_real_distribution<double> coin(0.0, 1.0);
+    string out;
+    for(char c : seq)
+    {
+        double r = coin(rng);
+        if(r < erate/3)         // substitution (possibly silent)
+            out.push_back(bases[rng() % 4]);
+        else if(r < 2*erate/3)  // insertion
+        {
+            out.push_back(c);
+            out.push_back(bases[rng() % 4]);
+        }
+        else if(r >= erate)     // kept, deletion otherwise
+            out.push_back(c);
+    }
+    return out;
+}
+
+/**
+ * @brief testPafCigar aligns two overlapping reads on the given strand, writes the PAF line with its CIGAR and scores
+ * the CIGAR again against the forward target and the query, reverse-complemented for '-'
+ */
+static void testPafCigar(mt19937 & rng, char strand)
+{
+    const int k = 17;
+    string what = string("PAF CIGAR, strand ") + strand;
+    string genome = randomRead(rng, 12000);
+
+    readType_ read1, read2;     // row read (target) and column read (query)
+    read1.seq = mutate(rng, genome.substr(0, 8000), 0.1);
+    read2.seq = mutate(rng, genome.substr(5000), 0.1);
+    if(strand == '-')
+        read1.seq = reverseStrand(read1.seq);
+    read1.nametag = "target";
+    read2.nametag = "query";
+    read1.readid = 0;
+    read2.readid = 1;
+    encodeRead(read1);
+    encodeRead(read2);
+
+    // a k-mer of the query found in the target on the expected strand
+    int i = -1, j = 0;
+    for(; j + k <= (int)read2.seq.length(); ++j)
+    {
+        string kmer = read2.seq.substr(j, k);
+        size_t at = read1.seq.find(strand == '+' ? kmer : reverseStrand(kmer));
+        if(at != string::npos)
+        {
+            i = at;
+            break;
+        }
+    }
+    EXPECT(i >= 0, what + ": shared k-mer");
+    if(i < 0) return;
+
+    BELLApars pars;
+    pars.outputPaf = true;
+    pars.outputCigar = true;
+    pars.adapThr = false;
+    pars.defaultThr = 0;
+
+    alignContext_ ctx;
+    seqAnResult result = alignSeqAn(read1, read2, i, j, k, ctx);
+    EXPECT(result.strand == (strand == '+' ? "n" : "c"), what + ": seed strand");
+
+    char filename[] = "/tmp/bella-test-XXXXXX";
+    int fd = mkstemp(filename);
+    EXPECT(fd >= 0, what + ": temporary file");
+    if(fd < 0) return;
+    close(fd);
+    size_t outputted = 0, alignedtrue = 0, alignedfalse = 0;
+    bool passed;
+    {
+        OverlapWriter writer(filename, 1);
+        PostAlignDecision(result, read1, read2, pars, adaptiveSlope(0.1), 1, writer.stream(0), outputted, alignedtrue, alignedfalse, passed);
+    }
+    ifstream in(filename);
+    string line;
+    getline(in, line);
+    in.close();
+    unlink(filename);
+    EXPECT(passed && outputted == 1, what + ": overlap accepted");
+
+    // qname qlen qbeg qend strand tname tlen tbeg tend score ov mapq cg:Z:cigar
+    istringstream fields(line);
+    string qname, pafstrand, tname, tag;
+    int qlen, qbeg, qend, tlen, tbeg, tend, score, ov, mapq;
+    fields >> qname >> qlen >> qbeg >> qend >> pafstrand >> tname >> tlen >> tbeg >> tend >> score >> ov >> mapq >> tag;
+    EXPECT(pafstrand == string(1, strand), what + ": PAF strand");
+    EXPECT(tag.compare(0, 5, "cg:Z:") == 0, what + ": cg:Z: tag");
+    if(tag.compare(0, 5, "cg:Z:") != 0) return;
+
+    string query = (strand == '-') ? reverseStrand(read2.seq) : read2.seq;
+    int q = (strand == '-') ? qlen - qend : qbeg;
+    int t = tbeg;
+    int rescore = 0, matches = 0, columns = 0;
+    istringstream cigar(tag.substr(5));
+    int len;
+    char op;
+    while(cigar >> len >> op)
+    {
+        for(int c = 0; c < len; ++c, ++columns)
+        {
+            if(op == 'M')
+            {
+                bool match = (q < (int)query.length() && t < (int)read1.seq.length() && query[q] == read1.seq[t]);
+                rescore += match ? 1 : -1;
+                matches += match;
+                ++q; ++t;
+            }
+            else if(op == 'I') { --rescore; ++q; }
+            else if(op == 'D') { --rescore; ++t; }
+        }
+    }
+    EXPECT(t == tend, what + ": CIGAR spans the target block");
+    EXPECT(q == ((strand == '-') ? qlen - qbeg : qend), what + ": CIGAR spans the query block");
+    EXPECT(rescore == result.score && rescore == score, what + ": CIGAR score is the reported score");
+    EXPECT(matches > 0.8 * columns, what + ": CIGAR identity");
+}
+
+/**
+ * @brief testCascadeThreshold checks that a cascade level never stops early on, or scores at or below the threshold
+ * for, an extension that AlignmentPasses accepts
+ */
+static void testCascadeThreshold(mt19937 & rng)
+{
+    const int k = 17;
+    BELLApars pars;
+    double ratioPhi = adaptiveSlope(0.15);
+    alignContext_ ctx;
+    int checked = 0, pruned = 0;
+
+    for(int pair = 0; pair < 24; ++pair)
+    {
+        double erate = 0.1 + 0.05 * (pair % 4);     // 10% to 25%, the last ones mostly fail
+        int offset = 200 + (rng() % 2000);
+        string genome = randomRead(rng, 5000);
+        readType_ read1, read2;
+        read1.seq = mutate(rng, genome.substr(0, 2500 + (rng() % 2000)), erate/2);
+        read2.seq = mutate(rng, genome.substr(offset), erate/2);
+        encodeRead(read1);
+        encodeRead(read2);
+        int read1len = read1.seq.length(), read2len = read2.seq.length();
+        int i = offset + 100, j = 100;              // on the true diagonal, up to the indels
+
+        for(int band : {16, 64, 256})
+        {
+            int diag = seedDiagonal(i, j, read1len, k, 'n');
+            int thr = CascadeThreshold(read1len, read2len, diag, band/2, pars, ratioPhi);
+            size_t cells;
+            seqAnResult pruning = alignSeqAnBanded(read1, read2, i, j, k, band, thr, ctx, cells);
+            seqAnResult full = alignSeqAnBanded(read1, read2, i, j, k, band, INT_MIN, ctx, cells);
+            bool passes = AlignmentPasses(full, read1len, read2len, pars, ratioPhi);
+            string what = "cascade threshold, pair " + to_string(pair) + ", band " + to_string(band);
+            EXPECT(!passes || full.score > thr, what + ": accepted extensions score above the threshold");
+            EXPECT(!passes || !pruning.earlyExit, what + ": accepted extensions are not stopped early");
+            EXPECT(pruning.earlyExit || pruning.score == full.score, what + ": extensions that do not stop are unchanged");
+            ++checked;
+            pruned += pruning.earlyExit;
+        }
+    }
+    EXPECT(pruned > 0 && pruned < checked, "cascade threshold: some extensions stop early, not all");
+}
+
+/**
+ * @brief testDiagonalFilter checks that the filter keeps pairs whose seeds agree, drops pairs whose seeds disagree on
+ * strand or diagonal, and leaves the seed list of the pair untouched
+ */
+static void testDiagonalFilter(mt19937 & rng)
+{
+    const int k = 17;
+    string row = randomRead(rng, 2000);
+    string col = row.substr(500);           // col[j] = row[j+500], diagonal -500
+    string rowrc = reverseStrand(row);      // rowrc[j] = complement of row[1999-j]
+    double erate = 0.15;
+    bool sameStrand;
+    vector<pair<int,int>> seeds;
+
+    // seeds on the same diagonal: kept, the order is unchanged
+    vector<pair<int,int>> pos = {{600, 100}, {1200, 700}, {1800, 1300}};
+    vector<pair<int,int>> before = pos;
+    EXPECT(diagonalFilter(pos, row, col, k, erate, sameStrand, seeds), "consistent seeds are kept");
+    EXPECT(seeds == before, "consistent seeds keep their order");
+
+    // a third seed on a far diagonal: kept, the two consistent seeds are extended first, pos is not reordered
+    pos = {{1500, 100}, {600, 100}, {1800, 1300}};
+    before = pos;
+    EXPECT(diagonalFilter(pos, row, col, k, erate, sameStrand, seeds), "pair with a consistent majority is kept");
+    EXPECT(seeds.size() == 3 && seeds[0] == before[1] && seeds[1] == before[2] && seeds[2] == before[0], "consistent seeds go first");
+    EXPECT(pos == before, "the seeds of the pair are not modified");
+
+    // two seeds on diagonals too far apart for the error rate: dropped
+    pos = {{600, 100}, {1700, 100}};
+    before = pos;
+    EXPECT(!diagonalFilter(pos, row, col, k, erate, sameStrand, seeds), "seeds on inconsistent diagonals are dropped");
+    EXPECT(sameStrand, "seeds on inconsistent diagonals are on the same strand");
+    EXPECT(pos == before, "the seeds of a dropped pair are not modified");
+
+    // one seed on each strand: dropped
+    string mixed = col;
+    mixed.replace(1000, k, rowrc.substr(300, k));   // a reverse-complement hit of row[1683..1699]
+    pos = {{600, 100}, {1999-300-k+1, 1000}};
+    EXPECT(seedStrand(row, mixed, pos[1].first, pos[1].second, k) == 'c', "planted seed is on the reverse strand");
+    EXPECT(!diagonalFilter(pos, row, mixed, k, erate, sameStrand, seeds), "seeds on different strands are dropped");
+    EXPECT(!sameStrand, "seeds on different strands are reported as such");
+
+    // a single seed always passes
+    pos = {{600, 100}};
+    EXPECT(diagonalFilter(pos, row, col, k, erate, sameStrand, seeds) && seeds == pos, "single seed passes");
+}
+
+/**
+ * @brief testSyncmerStrands checks that a syncmer sampled at j in a read is sampled at len-k-j in its reverse complement
+ */
+static void testSyncmerStrands(mt19937 & rng)
+{
+    const int k = 17;
+    string read = randomRead(rng, 5000);
+    string rc = reverseStrand(read);
+    int nkmers = read.length() - k + 1;
+
+    for(string spec : {"open:12", "open:13", "closed:11", "closed:12"})
+    {
+        seedSampling_ sampling;
+        sampling.parse(spec);
+        vector<int> fwd, rev;
+        selectSeeds(read, k, sampling, [](int) { return 0ULL; }, fwd);
+        selectSeeds(rc, k, sampling, [](int) { return 0ULL; }, rev);
+        for(int & p : rev)
+            p = nkmers - 1 - p;
+        sort(rev.begin(), rev.end());
+        EXPECT(!fwd.empty() && fwd == rev, spec + ": the same k-mers are sampled on both strands");
+    }
+}
+
+int main()
+{
+    mt19937 rng(20180101);
+
+    testSyncmerStrands(rng);
+    testDiagonalFilter(rng);
+    testPafCigar(rng, '+');
+    testPafCigar(rng, '-');
+    testCascadeThreshold(rng);
+
+    if(failures > 0)
+    {
+        cerr << failures << " check(s) failed" << endl;
+        return 1;
+    }
+    cout << "All alignment checks passed" << endl;
+    return 0;
+}
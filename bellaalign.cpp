@@ -0,0 +1,315 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <istream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <algorithm>
+#include <utility>
+#include <array>
+#include <tuple>
+#include <queue>
+#include <memory>
+#include <stack>
+#include <functional>
+#include <cstring>
+#include <string.h>
+#include <math.h>
+#include <cassert>
+#include <ios>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/sysctl.h>
+#include <map>
+#include <unordered_map>
+#include <omp.h>
+
+#include "libcuckoo/cuckoohash_map.hh"
+#include "kmercount.h"
+
+#include "kmercode/hash_funcs.h"
+#include "kmercode/Kmer.hpp"
+#include "kmercode/Buffer.h"
+#include "kmercode/common.h"
+#include "kmercode/fq_reader.h"
+#include "kmercode/ParallelFASTQ.h"
+#include "kmercode/bound.hpp"
+
+#include "mtspgemm2017/utility.h"
+#include "mtspgemm2017/CSC.h"
+#include "mtspgemm2017/CSR.h"
+#include "mtspgemm2017/common.h"
+#include "mtspgemm2017/IO.h"
+#include "mtspgemm2017/overlapping.h"
+#include "mtspgemm2017/candidates.h"
+#include "mtspgemm2017/align.h"
+
+using namespace std;
+
+//
+// bella-align: pairwise alignment of a candidate overlap matrix written by bella -M
+// The k-mer counting and the SpGEMM are done once; alignment parameter sweeps only run this
+//
+
+int main (int argc, char *argv[]) {
+
+    cout << "\nBELLA - Alignment of a candidate overlap matrix (bella -M)\n" << endl;
+
+    option_t *optList, *thisOpt;
+    optList = NULL;
+    optList = GetOptList(argc, argv, (char*)"i:o:a:c:w:nb:y:Dm:pCBh");
+
+    char *cand_file = NULL;                 // candidate matrix from bella -M (i)
+    char *out_file = NULL;                  // output filename (o)
+
+    BELLApars b_parameters;
+
+    if(optList == NULL)
+    {
+        cout << "BELLA execution terminated: not enough parameters or invalid option" << endl;
+        cout << "Run with -h to print out the command line options\n" << endl;
+        return 0;
+    }
+
+    while (optList!=NULL) {
+        thisOpt = optList;
+        optList = optList->next;
+        switch (thisOpt->option) {
+            case 'i': {
+                if(thisOpt->argument == NULL)
+                {
+                    cout << "BELLA execution terminated: -i requires an argument" << endl;
+                    cout << "Run with -h to print out the command line options\n" << endl;
+                    return 0;
+                }
+                cand_file = strdup(thisOpt->argument);
+                break;
+            }
+            case 'o': {
+                if(thisOpt->argument == NULL)
+                {
+                    cout << "BELLA execution terminated: -o requires an argument" << endl;
+                    cout << "Run with -h to print out the command line options\n" << endl;
+                    return 0;
+                }
+                out_file = (char*)malloc(strlen(thisOpt->argument) + strlen(".out") + 1);
+                strcpy(out_file, thisOpt->argument);
+                strcat(out_file, ".out");
+                break;
+            }
+            case 'a': {
+                b_parameters.defaultThr = atoi(thisOpt->argument);
+                b_parameters.adapThr = false;
+                break;
+            }
+            case 'c': {
+                if(stod(thisOpt->argument) > 1.0 || stod(thisOpt->argument) < 0.0)
+                {
+                    cout << "BELLA execution terminated: -c requires a value in [0,1]" << endl;
+                    cout << "Run with -h to print out the command line options\n" << endl;
+                    return 0;
+                }
+                b_parameters.deltaChernoff = stod(thisOpt->argument);
+                break;
+            }
+            case 'w': {
+                b_parameters.relaxMargin = atoi(thisOpt->argument);
+                break;
+            }
+            case 'n': b_parameters.alignEnd = true; break;
+            case 'b': {
+                if(thisOpt->argument == NULL)
+                {
+                    cout << "BELLA execution terminated: -b requires a comma-separated list of bands" << endl;
+                    cout << "Run with -h to print out the command line options\n" << endl;
+                    return 0;
+                }
+                char* bands = strdup(thisOpt->argument);
+                for(char* band = strtok(bands, ","); band != NULL; band = strtok(NULL, ","))
+                    b_parameters.cascadeBands.push_back(atoi(band));
+                free(bands);
+                if(b_parameters.cascadeBands.size() > MAX_CASCADE_LEVELS)
+                {
+                    cout << "BELLA execution terminated: -b supports at most " << MAX_CASCADE_LEVELS << " levels" << endl;
+                    cout << "Run with -h to print out the command line options\n" << endl;
+                    return 0;
+                }
+                break;
+            }
+            case 'y': {
+                b_parameters.cascadeCutoff = stod(thisOpt->argument);
+                break;
+            }
+            case 'D': b_parameters.diagFilter = true; break;
+            case 'm': {
+                b_parameters.totalMemory = stod(thisOpt->argument);
+                b_parameters.userDefMem = true;
+                cout << "User defined memory set to " << b_parameters.totalMemory << " MB " << endl;
+                break;
+            }
+            case 'p': b_parameters.outputPaf = true; break;
+            case 'C': b_parameters.outputCigar = true; break;
+            case 'B': b_parameters.outputBinary = true; break;
+            case 'h': {
+                cout << "Usage:\n" << endl;
+                cout << " -i : candidate overlap matrix written by bella -M (required)" << endl;
+                cout << " -o : output filename (required)" << endl;
+                cout << " -a : use fixed alignment threshold [50]" << endl;
+                cout << " -m : total RAM of the system in MB [auto estimated if possible or 8,000 if not]" << endl;
+                cout << " -w : relaxMargin parameter for alignment on edges [300]" << endl;
+                cout << " -c : alignment score deviation from the mean [0.1]" << endl;
+                cout << " -n : filter out alignment on edge [false]" << endl;
+                cout << " -b : alignment cascade, comma-separated bands in diagonals (0 = full matrix), e.g. 32,256,0 [no cascade]" << endl;
+                cout << " -y : cascade cut-off: failed pairs scoring at least this fraction of the threshold go to the next level [0.5]" << endl;
+                cout << " -D : skip pairs whose shared k-mers disagree on strand and diagonal [false]" << endl;
+                cout << " -p : output in PAF format [false]" << endl;
+                cout << " -C : output the CIGAR of accepted alignments as cg:Z: tag, requires -p [false]" << endl;
+                cout << " -B : output binary overlap records, convert with bench/ovl2text [false]\n" << endl;
+
+                FreeOptList(thisOpt); // Done with this list, free it
+                return 0;
+            }
+        }
+    }
+
+    if(cand_file == NULL || out_file == NULL)
+    {
+        cout << "BELLA execution terminated: missing arguments" << endl;
+        cout << "Run with -h to print out the command line options\n" << endl;
+        return 0;
+    }
+    if(b_parameters.outputBinary && (b_parameters.outputPaf || b_parameters.outputCigar))
+    {
+        cout << "Binary output is converted to PAF by bench/ovl2text: -p and -C ignored" << endl;
+        b_parameters.outputPaf = false;
+        b_parameters.outputCigar = false;
+    }
+    if(b_parameters.outputCigar && !b_parameters.outputPaf)
+    {
+        cout << "CIGAR output requires -p: -C ignored" << endl;
+        b_parameters.outputCigar = false;
+    }
+
+    free(optList);
+    free(thisOpt);
+
+#if defined (__linux__)
+    int cputhreads = cgroupThreads();
+    if(getenv("OMP_NUM_THREADS") == NULL && cputhreads > 0 && cputhreads < omp_get_max_threads())
+        omp_set_num_threads(cputhreads);
+#endif
+    double all = omp_get_wtime();
+
+    //
+    // Candidate matrix and read store
+    //
+
+    CandidateMatrix cand;
+    if(!cand.open(cand_file))
+        return 1;
+    const candHeader_ & info = cand.info();
+    int kmer_len = info.kmerlen;
+    b_parameters.errorRate = info.errorrate;
+    b_parameters.allKmer = info.allkmer;
+    b_parameters.kmerRift = info.kmerrift;
+    b_parameters.homopolymer = info.homopolymer;
+    seedShape().homopolymer = b_parameters.homopolymer;
+    seedShape().mask = std::string(info.seedmask, strnlen(info.seedmask, sizeof(info.seedmask)));
+
+    readVector_ reads;
+    cand.loadReads(reads);
+    size_t bases = 0;
+    #pragma omp parallel for reduction(+:bases)
+    for(size_t i = 0; i < reads.size(); ++i)
+    {
+        encodeRead(reads[i]);
+        bases += reads[i].seq.length();
+    }
+
+    double ratioPhi = adaptiveSlope(b_parameters.errorRate);
+    cout << "Candidate matrix: " << cand_file << " | reads: " << info.numreads << " | pairs: " << info.nnz << " | seeds: " << info.npos << endl;
+    cout << "K-mer length: " << kmer_len << " | error rate: " << b_parameters.errorRate << endl;
+    cout << "Output filename: " << out_file << endl;
+    if(b_parameters.adapThr)
+        cout << "Constant of adaptive threshold: " << ratioPhi*(1-b_parameters.deltaChernoff) << endl;
+    else cout << "Default alignment score threshold: " << b_parameters.defaultThr << endl;
+    if(b_parameters.alignEnd)
+        cout << "Constraint: alignment on edge with a margin of " << b_parameters.relaxMargin << " bps" << endl;
+    if(!b_parameters.cascadeBands.empty())
+    {
+        cout << "Alignment cascade bands:";
+        for(int band : b_parameters.cascadeBands)
+            cout << " " << band;
+        cout << " | cut-off: " << b_parameters.cascadeCutoff << endl;
+    }
+
+    remove(out_file);   // delete file to avoid errors in output
+    if(b_parameters.outputBinary && !writeOverlapHeader(out_file, reads))
+        return 1;
+
+    //
+    // Stages: the seed values of a stage are materialized next to the read store, the matrix stays mapped
+    //
+
+    int numThreads = omp_get_max_threads();
+    memoryPlan_ plan;
+    planCounting(plan, estimateMemory(b_parameters), numThreads, 0, true);
+    double readbytes = readStoreBytes(bases, reads.size(), true);
+    double seedsperpair = info.nnz ? (double)info.npos / info.nnz : 0;
+    double nnzbytes = sizeof(spmatPtr_) + 2 * MALLOC_CHUNK + 16 + sizeof(spmatType_) + seedsperpair * sizeof(pair<int,int>);  // as in planSpGEMM
+    double available = std::max(plan.budget - readbytes - 2.0 * numThreads * plan.writerBuffer, 0.1 * plan.budget);
+    uint64_t nnzperstage = std::max((uint64_t)1, (uint64_t)(available / (safety_net * nnzbytes)));
+
+    const uint64_t * colptr = cand.colptr();
+    const uint64_t * rowids = cand.rowids();
+    uint64_t ncols = info.numreads;
+    vector<uint64_t> colStart(1, 0);
+    while(colStart.back() < ncols)
+    {
+        // as in HashSpGEMM: the last column that keeps the stage within its share, at least one column
+        uint64_t target = colptr[colStart.back()] + nnzperstage;
+        uint64_t next = std::upper_bound(colptr, colptr+ncols+1, target) - colptr - 1;
+        colStart.push_back(std::max(next, colStart.back()+1));
+    }
+    int stages = colStart.size()-1;
+    cout << "Available RAM is assumed to be: " << plan.budget / (1024 * 1024) << " MB | read store: " << readbytes / (1024 * 1024) << " MB" << endl;
+    cout << "Stages: " << stages << " | max nnz per stage: " << nnzperstage << endl;
+
+    OverlapWriter writer(out_file, numThreads, plan.writerBuffer);
+    vector<alignContext_> contexts(numThreads);
+    size_t totalcells = 0;
+    size_t totaloutput = 0;
+    double totalaligntime = 0;
+
+    for(int b = 0; b < stages; ++b)
+    {
+        double ovl = omp_get_wtime();
+        uint64_t begnz = colptr[colStart[b]];
+        uint64_t endnz = colptr[colStart[b+1]];
+        spmatPtr_ * values = new spmatPtr_[endnz-begnz];
+        cand.values(begnz, endnz, values);
+        double ov2 = omp_get_wtime();
+
+        alignStats_ alignstats = RunPairWiseAlignments(colStart[b], colStart[b+1], begnz, colptr, rowids + begnz, values, reads,
+            kmer_len, writer, b_parameters, ratioPhi, contexts);
+        double aligntime = omp_get_wtime()-ov2-alignstats.timeoutputt;
+        delete [] values;
+
+        totalcells += alignstats.cells;
+        totaloutput += alignstats.outputted;
+        totalaligntime += aligntime;
+        cout << "\nColumns [" << colStart[b] << " - " << colStart[b+1] << "] seeds loaded in " << ov2-ovl << "s | alignment time: " << aligntime << "s | read pairs aligned this stage: "
+            << alignstats.alignedpairs << endl;
+        cout << "DP cells: " << alignstats.cells << " | GCUPS: " << alignstats.cells / aligntime / 1e9 << " | load imbalance (max/mean thread time): "
+            << alignstats.threadtimemax / alignstats.threadtimemean << endl;
+        cout << "Outputted " << alignstats.outputted << " lines in " << alignstats.timeoutputt << "s" << endl;
+    }
+
+    cout << "\nTotal DP cells: " << totalcells << " | GCUPS: " << totalcells / totalaligntime / 1e9 << endl;
+    cout << "Total lines: " << totaloutput << endl;
+    cout << "Total running time: " << omp_get_wtime()-all << "s\n" << endl;
+    return 0;
+}
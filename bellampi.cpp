@@ -0,0 +1,481 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <istream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <algorithm>
+#include <utility>
+#include <array>
+#include <tuple>
+#include <queue>
+#include <memory>
+#include <stack>
+#include <functional>
+#include <cstring>
+#include <string.h>
+#include <math.h>
+#include <cassert>
+#include <ios>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/sysctl.h>
+#include <map>
+#include <unordered_map>
+#include <mpi.h>
+#include <omp.h>
+
+#include "libcuckoo/cuckoohash_map.hh"
+#include "kmercount.h"
+
+#include "kmercode/hash_funcs.h"
+#include "kmercode/Kmer.hpp"
+#include "kmercode/Buffer.h"
+#include "kmercode/common.h"
+#include "kmercode/fq_reader.h"
+#include "kmercode/ParallelFASTQ.h"
+#include "kmercode/bound.hpp"
+
+#include "mtspgemm2017/utility.h"
+#include "mtspgemm2017/CSC.h"
+#include "mtspgemm2017/CSR.h"
+#include "mtspgemm2017/common.h"
+#include "mtspgemm2017/IO.h"
+#include "mtspgemm2017/overlapping.h"
+#include "mtspgemm2017/distributed.h"
+#include "mtspgemm2017/align.h"
+#include "distkmercount.h"
+
+using namespace std;
+
+//
+// bella-mpi: BELLA on a square grid of MPI processes (mpirun -np 1, 4, 9, ...)
+// Reads are parsed in byte ranges of the fastq(s), k-mers are counted by owner process, A and A^T are distributed by
+// blocks and C = A A^T is formed by Sparse SUMMA; every process aligns the pairs of its block of C
+//
+
+// prints the reason on the first process and leaves MPI
+int terminate(bool root, const string & reason)
+{
+    if(root)
+    {
+        cout << "BELLA execution terminated: " << reason << endl;
+        cout << "Run with -h to print out the command line options\n" << endl;
+    }
+    MPI_Finalize();
+    return 0;
+}
+
+int main (int argc, char *argv[]) {
+
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    procGrid_ grid;
+    bool square = makeGrid(grid);
+    bool root = (grid.rank == 0);
+
+    if(root)
+        cout << "\nBELLA - Long Read Aligner for De Novo Genome Assembly (distributed, " << grid.nprocs << " processes)\n" << endl;
+    if(!square)
+        return terminate(root, "the number of processes must be a square (1, 4, 9, ...)");
+
+    option_t *optList, *thisOpt;
+    optList = NULL;
+    optList = GetOptList(argc, argv, (char*)"i:o:d:hk:Ka:ze:w:nc:r:pDCBb:y:");
+
+    char *all_inputs_fofn = NULL;           // List of fastqs (i)
+    char *out_file = NULL;                  // output filename (o)
+    int kmer_len = 17;                      // default k-mer length (k)
+    double erate = 0.15;                    // default error rate (e)
+    int depth = 0;                          // depth/coverage required (d)
+
+    BELLApars b_parameters;
+
+    if(optList == NULL)
+        return terminate(root, "not enough parameters or invalid option");
+
+    while (optList!=NULL) {
+        thisOpt = optList;
+        optList = optList->next;
+        switch (thisOpt->option) {
+            case 'i': {
+                if(thisOpt->argument == NULL)
+                    return terminate(root, "-i requires an argument");
+                all_inputs_fofn = strdup(thisOpt->argument);
+                break;
+            }
+            case 'o': {
+                if(thisOpt->argument == NULL)
+                    return terminate(root, "-o requires an argument");
+                out_file = (char*)malloc(strlen(thisOpt->argument) + strlen(".out") + 1);
+                strcpy(out_file, thisOpt->argument);
+                strcat(out_file, ".out");
+                break;
+            }
+            case 'd': {
+                if(thisOpt->argument == NULL)
+                    return terminate(root, "-d requires an argument");
+                depth = atoi(thisOpt->argument);
+                break;
+            }
+            case 'p': b_parameters.outputPaf = true; break;
+            case 'C': b_parameters.outputCigar = true; break;
+            case 'B': b_parameters.outputBinary = true; break;
+            case 'z': b_parameters.skipAlignment = true; break;
+            case 'n': b_parameters.alignEnd = true; break;
+            case 'K': b_parameters.allKmer = true; break;
+            case 'D': b_parameters.diagFilter = true; break;
+            case 'k': {
+                kmer_len = atoi(thisOpt->argument);
+                break;
+            }
+            case 'r': {
+                b_parameters.kmerRift = atoi(thisOpt->argument);
+                break;
+            }
+            case 'e': {
+                b_parameters.skipEstimate = true;
+                erate = strtod(thisOpt->argument, NULL);
+                break;
+            }
+            case 'a': {
+                b_parameters.defaultThr = atoi(thisOpt->argument);
+                b_parameters.adapThr = false;
+                break;
+            }
+            case 'w': {
+                b_parameters.relaxMargin = atoi(thisOpt->argument);
+                break;
+            }
+            case 'c': {
+                if(stod(thisOpt->argument) > 1.0 || stod(thisOpt->argument) < 0.0)
+                    return terminate(root, "-c requires a value in [0,1]");
+                b_parameters.deltaChernoff = stod(thisOpt->argument);
+                break;
+            }
+            case 'b': {
+                if(thisOpt->argument == NULL)
+                    return terminate(root, "-b requires a comma-separated list of bands");
+                char* bands = strdup(thisOpt->argument);
+                for(char* band = strtok(bands, ","); band != NULL; band = strtok(NULL, ","))
+                    b_parameters.cascadeBands.push_back(atoi(band));
+                free(bands);
+                if(b_parameters.cascadeBands.size() > MAX_CASCADE_LEVELS)
+                    return terminate(root, "-b supports at most " + to_string(MAX_CASCADE_LEVELS) + " levels");
+                break;
+            }
+            case 'y': {
+                b_parameters.cascadeCutoff = stod(thisOpt->argument);
+                break;
+            }
+            case 'h': {
+                if(root)
+                {
+                    cout << "Usage: mpirun -np <square number of processes> bella-mpi [options]\n" << endl;
+                    cout << " -i : list of fastq(s) (required)" << endl;
+                    cout << " -o : output filename (required)" << endl;
+                    cout << " -d : depth/coverage (required)" << endl;
+                    cout << " -k : k-mer length [17]" << endl;
+                    cout << " -a : use fixed alignment threshold [50]" << endl;
+                    cout << " -e : error rate [auto estimated from fastq]" << endl;
+                    cout << " -z : skip the pairwise alignment [false]" << endl;
+                    cout << " -w : relaxMargin parameter for alignment on edges [300]" << endl;
+                    cout << " -c : alignment score deviation from the mean [0.1]" << endl;
+                    cout << " -n : filter out alignment on edge [false]" << endl;
+                    cout << " -r : kmerRift: bases separating two k-mers used as seeds for a read [1,000]" << endl;
+                    cout << " -K : use all k-mers separated by kmerRift as seeds [false]" << endl;
+                    cout << " -b : alignment cascade, comma-separated bands in diagonals (0 = full matrix), e.g. 32,256,0 [no cascade]" << endl;
+                    cout << " -y : cascade cut-off: failed pairs scoring at least this fraction of the threshold go to the next level [0.5]" << endl;
+                    cout << " -D : skip pairs whose shared k-mers disagree on strand and diagonal [false]" << endl;
+                    cout << " -p : output in PAF format [false]" << endl;
+                    cout << " -C : output the CIGAR of accepted alignments as cg:Z: tag, requires -p [false]\n" << endl;
+                }
+                FreeOptList(thisOpt); // Done with this list, free it
+                MPI_Finalize();
+                return 0;
+            }
+        }
+    }
+
+    if(all_inputs_fofn == NULL || out_file == NULL || depth == 0)
+        return terminate(root, "missing arguments");
+
+    if(b_parameters.outputBinary)
+    {
+        if(root) cout << "Binary output is written by the single-process bella: -B ignored" << endl;
+        b_parameters.outputBinary = false;
+    }
+    if(b_parameters.outputCigar && (!b_parameters.outputPaf || b_parameters.skipAlignment))
+    {
+        if(root) cout << "CIGAR output requires -p and the pairwise alignment: -C ignored" << endl;
+        b_parameters.outputCigar = false;
+    }
+
+    free(optList);
+    free(thisOpt);
+
+    double all = MPI_Wtime();
+    Kmer::set_k(kmer_len);
+    size_t upperlimit = 10000000; // in bytes
+
+    // the list of fastq(s) is read once and broadcast
+    vector<filedata> allfiles;
+    uint64_t nfiles = 0;
+    if(root)
+    {
+        allfiles = GetFiles(all_inputs_fofn);
+        nfiles = allfiles.size();
+    }
+    MPI_Bcast(&nfiles, 1, MPIType<uint64_t>(), 0, MPI_COMM_WORLD);
+    allfiles.resize(nfiles);
+    MPI_Bcast(allfiles.data(), nfiles * sizeof(filedata), MPI_BYTE, 0, MPI_COMM_WORLD);
+
+    if(root)
+    {
+        cout << "Process grid: " << grid.dim << " x " << grid.dim << " | threads per process: " << omp_get_max_threads() << endl;
+        cout << "Output filename: " << out_file << endl;
+        cout << "K-mer length: " << kmer_len << endl;
+        cout << "Depth: " << depth << "X" << endl;
+        if(b_parameters.skipAlignment)
+            cout << "Compute alignment: false" << endl;
+        else cout << "Compute alignment: true" << endl;
+        if(!b_parameters.allKmer)
+            cout << "Seeding: two-kmer" << endl;
+        else cout << "Seeding: all-kmer" << endl;
+    }
+
+    //
+    // Fastq(s) parsing and error estimation: every process parses a byte range of every file
+    //
+
+    double parsefastq = MPI_Wtime();
+    readVector_ myreads;
+    double errorsum;
+    DistributedParse(allfiles, myreads, errorsum, upperlimit, b_parameters, grid);
+
+    uint64_t mycount = myreads.size(), numreads = 0;
+    MPI_Allreduce(&mycount, &numreads, 1, MPIType<uint64_t>(), MPI_SUM, MPI_COMM_WORLD);
+    if(!b_parameters.skipEstimate)
+    {
+        double totalerror = 0;
+        MPI_Allreduce(&errorsum, &totalerror, 1, MPIType<double>(), MPI_SUM, MPI_COMM_WORLD);
+        erate = totalerror / numreads;
+    }
+    b_parameters.errorRate = erate;
+    int lower = computeLower(depth, erate, kmer_len);
+    int upper = computeUpper(depth, erate, kmer_len);
+    vector<uint64_t> readbounds = blockBounds(numreads, grid.dim);
+
+    if(root)
+    {
+        cout << "Fastq(s) parsing took: " << MPI_Wtime()-parsefastq << "s" << endl;
+        cout << "Total number of reads: " << numreads << endl;
+        cout << "Error rate estimate is " << erate << endl;
+        cout << "Reliable lower bound: " << lower << endl;
+        cout << "Reliable upper bound: " << upper << "\n" << endl;
+    }
+
+    //
+    // Distributed k-mer counting and construction of the blocks of A (reads x k-mers) and A^T
+    //
+
+    vector<uint64_t> kmerbounds;
+    vector<tuple<size_t,size_t,size_t>> occurrences;
+    vector<tuple<size_t,size_t,size_t>> transtuples;
+    uint64_t nkmers = DistributedCount(myreads, kmer_len, lower, upper, grid, readbounds, kmerbounds, occurrences, transtuples);
+    if(nkmers == 0)
+        return terminate(root, "0 entries within reliable range (reduce k-mer length)");
+    if(root)
+        cout << "Entries within reliable range: " << nkmers << endl;
+
+    double matcreat = MPI_Wtime();
+    size_t myreadrange = readbounds[grid.myrow+1] - readbounds[grid.myrow];
+    size_t mykmerrange = kmerbounds[grid.mycol+1] - kmerbounds[grid.mycol];
+    CSC<size_t,size_t> spmat(occurrences, myreadrange, mykmerrange,
+                            [] (size_t & p1, size_t & p2)
+                            {
+                                return p1;
+                            });
+    std::vector<tuple<size_t,size_t,size_t>>().swap(occurrences);
+
+    CSC<size_t,size_t> transpmat(transtuples, kmerbounds[grid.myrow+1] - kmerbounds[grid.myrow], readbounds[grid.mycol+1] - readbounds[grid.mycol],
+                            [] (size_t & p1, size_t & p2)
+                            {
+                                return p1;
+                            });
+    std::vector<tuple<size_t,size_t,size_t>>().swap(transtuples);
+    if(root)
+        cout << "Sparse matrix construction took: " << MPI_Wtime()-matcreat << "s\n" << endl;
+
+    //
+    // Overlap detection: Sparse SUMMA on the grid, LocalSpGEMM on every pair of blocks
+    //
+
+    auto multop = [] (size_t & pi, size_t & pj)                     // n-th k-mer positions on read i and on read j
+            {   spmatPtr_ value(make_shared<spmatType_>());
+                value->count = 1;
+                value->pos.push_back(make_pair(pi, pj));
+                return value;
+            };
+    auto addop = [&kmer_len,&b_parameters] (spmatPtr_ & m1, spmatPtr_ & m2)
+            {
+                for(int i = 0; i < m1->pos.size(); ++i)
+                {
+                    int left  = m2->pos[i].first - kmer_len - b_parameters.kmerRift;
+                    int right = m2->pos[i].first + kmer_len + b_parameters.kmerRift;
+                    int newseed  = m1->pos[i].first;
+
+                    if(!isinrift(newseed, left, right))       // seeds separated by <kmerRift> bases
+                    {
+                        left  = m2->pos[i].second - kmer_len - b_parameters.kmerRift;
+                        right = m2->pos[i].second + kmer_len + b_parameters.kmerRift;
+                        newseed  = m1->pos[i].second;
+
+                        if(!isinrift(newseed, left, right))   // seeds separated by <kmerRift> bases
+                            if(!b_parameters.allKmer)         // save at most two kmers as seeds
+                            {
+                                m2->count = m2->count+m1->count;
+                                m2->pos.clear();  // free from previous positions and save only two pos
+
+                                m2->pos.push_back(make_pair(m2->pos[i].first, m2->pos[i].second));
+                                m2->pos.push_back(make_pair(m1->pos[i].first, m1->pos[i].second));
+
+                                break;
+                            }
+                            else   // save all possible kmers as seeds
+                            {
+                                m2->count = m2->count+m1->count;
+                                m2->pos.push_back(m1->pos[i]);
+                            }
+                    }
+                }
+                return m2;
+            };
+    // the k-mer ranges reach a pair in k-mer id order, as in HashSpGEMM: the seeds a later range kept are added one by
+    // one, its shared k-mers that addop dropped (too close to its own seeds) only count
+    auto mergeop = [&addop] (spmatPtr_ & later, spmatPtr_ & earlier)
+            {
+                for(size_t p = 0; p < later->pos.size(); ++p)
+                {
+                    spmatPtr_ seed(make_shared<spmatType_>());
+                    seed->count = 1;
+                    seed->pos.push_back(later->pos[p]);
+                    earlier = addop(seed, earlier);
+                }
+                earlier->count += later->count - later->pos.size();
+                return earlier;
+            };
+
+    double spgemm = MPI_Wtime();
+    vector<size_t> colptrC, rowidsC;
+    vector<spmatPtr_> valuesC;
+    uint64_t myflops = SparseSUMMA(grid, spmat, transpmat, multop, addop, mergeop, true, colptrC, rowidsC, valuesC);
+    double myspgemmtime = MPI_Wtime()-spgemm;
+
+    uint64_t mynnz = rowidsC.size(), nnzc = 0, flops = 0;
+    MPI_Reduce(&mynnz, &nnzc, 1, MPIType<uint64_t>(), MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&myflops, &flops, 1, MPIType<uint64_t>(), MPI_SUM, 0, MPI_COMM_WORLD);
+    if(root)
+        cout << "Sparse SUMMA took: " << myspgemmtime << "s | FLOPS is " << flops << " | nnz(output): " << nnzc << endl;
+
+    //
+    // Pairwise alignment of the block: the columns read first, then the rows (when they are a different range)
+    //
+
+    readVector_ rowreads, colreads;
+    ShipReads(myreads, readbounds, grid, rowreads, colreads);
+    readVector_().swap(myreads);
+
+    readVector_ reads;
+    reads.swap(colreads);
+    if(grid.myrow != grid.mycol)
+    {
+        size_t shift = reads.size();
+        reads.insert(reads.end(), rowreads.begin(), rowreads.end());
+        for(size_t i = 0; i < rowidsC.size(); ++i)
+            rowidsC[i] += shift;
+    }
+    readVector_().swap(rowreads);
+    if(!b_parameters.skipAlignment)
+    {
+        #pragma omp parallel for
+        for(size_t i = 0; i < reads.size(); ++i)
+            encodeRead(reads[i]);
+    }
+
+    double ratioPhi = adaptiveSlope(erate);
+    if(root)
+    {
+        if(b_parameters.adapThr)
+            cout << "Constant of adaptive threshold: " << ratioPhi*(1-b_parameters.deltaChernoff) << endl;
+        else cout << "Default alignment score threshold: " << b_parameters.defaultThr << endl;
+    }
+
+    // every process writes its part, then the parts are copied to their offsets in the output file
+    string partfile = string(out_file) + "." + to_string(grid.rank);
+    remove(partfile.c_str());
+    int numThreads = omp_get_max_threads();
+    alignStats_ alignstats;
+    double aligning = MPI_Wtime();
+    {
+        OverlapWriter writer(partfile.c_str(), numThreads);
+        vector<alignContext_> contexts(numThreads);
+        size_t ncols = colptrC.size()-1;
+        alignstats = RunPairWiseAlignments((size_t)0, ncols, (size_t)0, colptrC.data(), rowidsC.data(), valuesC.data(), reads,
+            kmer_len, writer, b_parameters, ratioPhi, contexts);
+    }
+    double myaligntime = MPI_Wtime()-aligning;
+    vector<spmatPtr_>().swap(valuesC);
+
+    struct stat st;
+    uint64_t mybytes = (stat(partfile.c_str(), &st) == 0) ? st.st_size : 0, offset = 0, total = 0;
+    MPI_Exscan(&mybytes, &offset, 1, MPIType<uint64_t>(), MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(&mybytes, &total, 1, MPIType<uint64_t>(), MPI_SUM, MPI_COMM_WORLD);
+    if(root) offset = 0;
+
+    if(root) remove(out_file);  // delete file to avoid errors in output
+    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_File fh;
+    if(MPI_File_open(MPI_COMM_WORLD, out_file, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+    {
+        if(root) fprintf(stderr, "File %s failed to open\n", out_file);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_set_size(fh, total);
+    FILE * part = fopen(partfile.c_str(), "rb");
+    vector<char> chunk(1 << 26);
+    for(uint64_t done = 0; part != NULL && done < mybytes; )
+    {
+        size_t got = fread(chunk.data(), 1, std::min((uint64_t)chunk.size(), mybytes - done), part);
+        if(got == 0) break;
+        MPI_File_write_at(fh, offset + done, chunk.data(), got, MPI_BYTE, MPI_STATUS_IGNORE);
+        done += got;
+    }
+    if(part != NULL) fclose(part);
+    MPI_File_close(&fh);
+    remove(partfile.c_str());
+
+    // load balance across the grid: the blocks above the diagonal have no pairs
+    uint64_t counters[3] = { alignstats.alignedpairs, alignstats.outputted, alignstats.cells }, totals[3];
+    double times[2] = { myspgemmtime, myaligntime }, maxtimes[2], sumtimes[2];
+    MPI_Reduce(counters, totals, 3, MPIType<uint64_t>(), MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(times, maxtimes, 2, MPIType<double>(), MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(times, sumtimes, 2, MPIType<double>(), MPI_SUM, 0, MPI_COMM_WORLD);
+    if(root)
+    {
+        cout << "\nRead pairs aligned: " << totals[0] << " | lines: " << totals[1] << " | DP cells: " << totals[2] << endl;
+        cout << "SpGEMM time (max over processes): " << maxtimes[0] << "s | load imbalance (max/mean): " << maxtimes[0] / max(sumtimes[0] / grid.nprocs, 1e-9) << endl;
+        cout << "Alignment time (max over processes): " << maxtimes[1] << "s | load imbalance (max/mean): " << maxtimes[1] / max(sumtimes[1] / grid.nprocs, 1e-9) << endl;
+        if(maxtimes[1] > 0)
+            cout << "GCUPS: " << totals[2] / maxtimes[1] / 1e9 << endl;
+        cout << "Output: " << total << " bytes written to " << out_file << endl;
+        cout << "Total running time: " << MPI_Wtime()-all << "s\n" << endl;
+    }
+
+    freeGrid(grid);
+    MPI_Finalize();
+    return 0;
+}
@@ -4,56 +4,99 @@
 #include <string>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <algorithm>
 #include <cmath>
 #include <numeric>
 #include <vector>
-#include <sys/types.h> 
-#include <sys/stat.h> 
+#include <unordered_map>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <math.h>
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <unistd.h>
-#include <ctype.h> 
-#include <sstream>
-#include <set>
+#include <ctype.h>
 #include <memory>
 #include <typeinfo>
 
-struct entry {
-	std::string a;
-	std::string b;
-	int overlap;
-};
+typedef uint32_t readid_t;	// interned read name
+typedef uint64_t pairkey_t;	// pair of reads (a, b) as a single integer, a in the upper half
 
-struct overlap {
-	std::string read;
-	std::string ref;
-	int start, end;
-};
+inline pairkey_t makeKey(readid_t a, readid_t b) { return ((pairkey_t)a << 32) | b; }
+inline readid_t firstRead(pairkey_t key) { return (readid_t)(key >> 32); }
+inline readid_t secondRead(pairkey_t key) { return (readid_t)key; }
+
+// (a, b) and (b, a) have the same canonical key, the smaller id first
+inline pairkey_t canonical(pairkey_t key)
+{
+	readid_t a = firstRead(key), b = secondRead(key);
+	return (a < b) ? key : makeKey(b, a);
+}
 
-bool operator< (const entry& lhs, const entry& rhs)
-	{ return (lhs.a < rhs.a) || ((!(rhs.a < lhs.a)) && (lhs.b < rhs.b)); }
+// a column of an output line, points into the line buffer and it is not null-terminated
+struct field {
+	const char* ptr;
+	size_t len;
 
-struct classcom {
-	bool operator() (const entry& lhs, const entry& rhs) const
-	{ return (lhs.a < rhs.a) || ((!(rhs.a < lhs.a)) && (lhs.b < rhs.b)); }
+	bool operator== (const field& rhs) const
+	{ return len == rhs.len && std::memcmp(ptr, rhs.ptr, len) == 0; }
+	bool operator== (const char* rhs) const
+	{ return len == std::strlen(rhs) && std::memcmp(ptr, rhs, len) == 0; }
 };
 
-std::vector<std::string> split (const std::string &s, char delim)
+// parses the column as std::stoi does, never reading past its end
+inline int toInt(const field& f)
 {
-	std::vector<std::string> result;
-	std::stringstream ss (s);
-	std::string item;
+	size_t i = 0;
+	bool negative = false;
+	if(i < f.len && (f.ptr[i] == '-' || f.ptr[i] == '+'))
+		negative = (f.ptr[i++] == '-');
 
-	while (std::getline (ss, item, delim))
+	long n = 0;
+	for(; i < f.len && isdigit((unsigned char)f.ptr[i]); ++i)
+		n = 10 * n + (f.ptr[i] - '0');
+	return (int)(negative ? -n : n);
+}
+
+// splits [begin, end) at every delim as std::getline does (no empty last column)
+inline void split(const char* begin, const char* end, char delim, std::vector<field>& result)
+{
+	result.clear();
+	while(begin < end)
 	{
-		result.push_back (item);
+		const char* stop = (const char*)std::memchr(begin, delim, end - begin);
+		if(stop == NULL) stop = end;
+		result.push_back({begin, (size_t)(stop - begin)});
+		begin = stop + 1;
 	}
-
-	return result;
 }
 
-#endif
\ No newline at end of file
+// read (or reference) names to dense ids, the ground truth names come first
+class readTable {
+public:
+	// concurrent lookups are safe as long as no one interns, scratch avoids an allocation per lookup
+	bool find(const field& name, readid_t& id, std::string& scratch) const
+	{
+		scratch.assign(name.ptr, name.len);
+		auto it = ids.find(scratch);
+		if(it == ids.end()) return false;
+		id = it->second;
+		return true;
+	}
+
+	readid_t intern(const field& name)
+	{
+		auto it = ids.emplace(std::string(name.ptr, name.len), (readid_t)ids.size());
+		return it.first->second;
+	}
+
+	size_t size() const { return ids.size(); }
+
+private:
+	std::unordered_map<std::string, readid_t> ids;
+};
+
+#endif
@@ -13,11 +13,9 @@ extern "C" {
 }
 #endif
 
-#include "IntervalTree.h"
 #include "evaluation.h"
 #include "def.h"
 #include <omp.h>
-#include <set>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -78,7 +76,7 @@ int main (int argc, char* argv[]) {
 				break;
 			}
 			case 'l': {
-				minOverlap = stoi(thisOpt->argument);
+				minOverlap = std::stoi(thisOpt->argument);
 				break;
 			}
 			case 'z': {
@@ -137,14 +135,14 @@ int main (int argc, char* argv[]) {
 	}
 
 	if(G == NULL) {
-		cout << "\nProgram execution terminated: missing argument." 	<< endl;
-		cout << "Run with -h to print out the command line options.\n" 	<< endl;
+		std::cout << "\nProgram execution terminated: missing argument." 	<< std::endl;
+		std::cout << "Run with -h to print out the command line options.\n" 	<< std::endl;
 		return 0;
 	}
 
 	if(M != NULL && i == NULL) {
-		cout << "\nProgram execution terminated: missing argument." 													<< std::endl;
-		cout << "Please add MECAT idx2read file with -i option. Run with -h to print out the command line options.\n" 	<< std::endl;
+		std::cout << "\nProgram execution terminated: missing argument." 													<< std::endl;
+		std::cout << "Please add MECAT idx2read file with -i option. Run with -h to print out the command line options.\n" 	<< std::endl;
 		return 0;
 	}
 
@@ -154,12 +152,14 @@ int main (int argc, char* argv[]) {
 	bool duplicate = false; // some software doesn't output both (A,B) and (B,A)
 	std::ifstream data(G);
 
-	std::set<entry, classcom> Gset = readTruthOutput(data, minOverlap, isSimulated); // ground truth
-	std::set<entry, classcom> Sset; // software output
+	readTable names; // read names to ids, the ground truth names first
+
+	std::vector<pairkey_t> Gset = readTruthOutput(data, minOverlap, isSimulated, names); // ground truth
+	std::vector<pairkey_t> Sset; // software output
 
 	if(B) {
 		std::ifstream reads(B);
-		Sset = readBellaOutput(reads, minOverlap, isAligned);
+		Sset = readBellaOutput(reads, names, minOverlap, isAligned);
 		duplicate = true;
 		std::cout << "Bella" << std::endl;
 		evaluate(Sset, Gset, minOverlap, duplicate, isAligned);
@@ -167,7 +167,7 @@ int main (int argc, char* argv[]) {
 
 	if(m) {
 		std::ifstream reads(m);
-		Sset = readMinimapOutput(reads, minOverlap, isAligned);
+		Sset = readMinimapOutput(reads, names, minOverlap, isAligned);
 		duplicate = true;
 		std::cout << "Minimap2" << std::endl;
 		evaluate(Sset, Gset, minOverlap, duplicate, isAligned);
@@ -176,7 +176,7 @@ int main (int argc, char* argv[]) {
 	if(M) {
 		std::ifstream reads(M);
 		std::ifstream index(i);
-		Sset = readMecatOutput(reads, index, minOverlap, isAligned);
+		Sset = readMecatOutput(reads, index, names, minOverlap, isAligned);
 		duplicate = true;
 		std::cout << "Mecat" << std::endl;
 		evaluate(Sset, Gset, minOverlap, duplicate, isAligned);
@@ -184,7 +184,7 @@ int main (int argc, char* argv[]) {
 
 	if(H) {
 		std::ifstream reads(H);
-		Sset = readMhapOutput(reads, minOverlap, isAligned);
+		Sset = readMhapOutput(reads, names, minOverlap, isAligned);
 		duplicate = false;
 		std::cout << "Mhap" << std::endl;
 		evaluate(Sset, Gset, minOverlap, duplicate, isAligned);
@@ -192,7 +192,7 @@ int main (int argc, char* argv[]) {
 
 	if(L) {
 		std::ifstream reads(L);
-		Sset = readBlasrOutput(reads, minOverlap, isAligned);
+		Sset = readBlasrOutput(reads, names, minOverlap, isAligned);
 		duplicate = false;
 		std::cout << "Blasr" << std::endl;
 		evaluate(Sset, Gset, minOverlap, duplicate, isAligned);
@@ -200,7 +200,7 @@ int main (int argc, char* argv[]) {
 
 	if(D) {
 		std::ifstream reads(D);
-		Sset = readDalignerOutput(reads, minOverlap, isAligned);
+		Sset = readDalignerOutput(reads, names, minOverlap, isAligned);
 		duplicate = false;
 		std::cout << "Daligner" << std::endl;
 		evaluate(Sset, Gset, minOverlap, duplicate, isAligned);
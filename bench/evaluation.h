@@ -4,13 +4,15 @@
 #include <string>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <algorithm>
 #include <cmath>
 #include <numeric>
 #include <vector>
 #include <map>
-#include <sys/types.h> 
-#include <sys/stat.h> 
+#include <unordered_map>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <math.h>
 #include <limits.h>
 #include <bitset>
@@ -18,12 +20,10 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <unistd.h>
-#include <ctype.h> 
+#include <ctype.h>
 #include <sstream>
-#include <set>
 #include <memory>
 #include <typeinfo>
-#include <set>
 #include <iomanip>
 #include "def.h"
 
@@ -31,12 +31,128 @@
 #define DEBUG
 #endif
 
+#ifndef EVALBLOCK
+#define EVALBLOCK (64 * 1024 * 1024)	// bytes of an output file parsed at a time
+#endif
+
 void estimateOverlap(int begV, int endV, int lenV, int begH, int endH, int lenH, int& overlap) {
-	overlap = min(begV, begH) + min(lenV - endV, lenH - endH) + ((endV - begV) + (endH - begH)) / 2;
+	overlap = std::min(begV, begH) + std::min(lenV - endV, lenH - endH) + ((endV - begV) + (endH - begH)) / 2;
+}
+
+// sorts each thread's chunk, then merges the chunks pairwise
+template <typename T, typename Compare>
+void parallelSort(std::vector<T>& v, Compare comp)
+{
+	int nchunks = omp_get_max_threads();
+	std::vector<size_t> bounds(nchunks + 1);
+	for(int i = 0; i <= nchunks; ++i)
+		bounds[i] = v.size() * i / nchunks;
+
+#pragma omp parallel for
+	for(int i = 0; i < nchunks; ++i)
+		std::sort(v.begin() + bounds[i], v.begin() + bounds[i+1], comp);
+
+	for(int width = 1; width < nchunks; width *= 2)
+	{
+	#pragma omp parallel for
+		for(int i = 0; i < nchunks - width; i += 2*width)
+			std::inplace_merge(v.begin() + bounds[i], v.begin() + bounds[i+width],
+				v.begin() + bounds[std::min(i + 2*width, nchunks)], comp);
+	}
 }
 
-// from mecat index file to a std::map<uint32_t, std::string>
-void tomap(std::ifstream& idx2read, std::map<std::string, std::string>& namestable)
+// sorted keys without repetitions
+void sortUnique(std::vector<pairkey_t>& keys)
+{
+	parallelSort(keys, std::less<pairkey_t>());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+// concatenates and frees the per-thread vectors
+template <typename T>
+std::vector<T> concatenate(std::vector<std::vector<T>>& local)
+{
+	std::vector<size_t> offsets(local.size() + 1, 0);
+	for(size_t i = 0; i < local.size(); ++i)
+		offsets[i+1] = offsets[i] + local[i].size();
+
+	std::vector<T> result(offsets.back());
+#pragma omp parallel for
+	for(size_t i = 0; i < local.size(); ++i)
+	{
+		std::copy(local[i].begin(), local[i].end(), result.begin() + offsets[i]);
+		std::vector<T>().swap(local[i]);
+	}
+	return result;
+}
+
+/**
+ * @brief streamLines reads the file one block at a time and parses the complete lines of a block in parallel,
+ * every thread taking the lines that start in its share of the block
+ * @param parseLine called as parseLine(begin, end, thread) for each non-empty line, end excluding '\n'
+ * @param endBlock called once the lines of a block are parsed, while the lines are still in memory
+ */
+template <typename LineFn, typename BlockFn>
+void streamLines(std::ifstream& file, LineFn parseLine, BlockFn endBlock)
+{
+	if(!file.is_open())
+	{
+		std::cout << "Cannot open the input file" << std::endl;
+		exit(1);
+	}
+
+	int maxt = omp_get_max_threads();
+	std::vector<char> buffer(EVALBLOCK + 1);
+	size_t carry = 0;	// incomplete last line of the previous block
+	bool eof = false;
+
+	while(!eof)
+	{
+		file.read(buffer.data() + carry, buffer.size() - 1 - carry);
+		size_t nbytes = carry + file.gcount();
+		eof = !file;
+
+		size_t end = nbytes;
+		if(!eof)
+		{
+			while(end > 0 && buffer[end-1] != '\n') --end;
+			if(end == 0)	// a line longer than the buffer
+			{
+				carry = nbytes;
+				buffer.resize(2 * buffer.size());
+				continue;
+			}
+		}
+		buffer[nbytes] = '\0';
+		const char* data = buffer.data();
+
+	#pragma omp parallel num_threads(maxt)
+		{
+			int ithread = omp_get_thread_num();
+			int nthreads = omp_get_num_threads();
+			size_t b = end * ithread / nthreads;
+			size_t e = end * (ithread + 1) / nthreads;
+
+			// a line starting before b belongs to the previous thread
+			if(b > 0) while(b < end && data[b-1] != '\n') ++b;
+			while(b < e)
+			{
+				const char* nl = (const char*)std::memchr(data + b, '\n', end - b);
+				size_t stop = (nl != NULL) ? (size_t)(nl - data) : end;
+				if(stop > b) parseLine(data + b, data + stop, ithread);
+				b = stop + 1;
+			}
+		}
+		endBlock();
+
+		carry = nbytes - end;
+		std::memmove(buffer.data(), buffer.data() + end, carry);
+	}
+	file.close();
+}
+
+// from mecat index file to a std::unordered_map<std::string, std::string>
+void tomap(std::ifstream& idx2read, std::unordered_map<std::string, std::string>& namestable)
 {
 	std::string num, name, seq, idx;
 
@@ -58,551 +174,370 @@ void tomap(std::ifstream& idx2read, std::map<std::string, std::string>& namestab
 }
 
 // from mecat numeric id to read name
-std::string toread(std::string& idx, std::map<std::string, std::string>& namestable)
+field toread(const field& idx, const std::unordered_map<std::string, std::string>& namestable, std::string& scratch)
 {
-	std::string name;
-	auto it = namestable.find(idx);
+	scratch.assign(idx.ptr, idx.len);
+	auto it = namestable.find(scratch);
 
-	if(it != namestable.end()) return namestable[idx];
+	if(it != namestable.end()) return {it->second.data(), it->second.size()};
 	else exit(1);
 }
 
-std::set<entry, classcom> readTruthOutput(std::ifstream& file, int minOverlap, bool isSimulated)
+/**
+ * @brief readTruthOutput maps every read to the reference intervals it covers and sweeps the intervals of each reference
+ * sorted by start: the intervals after i overlap it by at least minOverlap only while they start minOverlap before its end
+ * @param names interns the read names, the tool outputs are looked up in it
+ * @return the sorted canonical keys of the true pairs, each stands for both (a, b) and (b, a)
+ */
+std::vector<pairkey_t> readTruthOutput(std::ifstream& file, int minOverlap, bool isSimulated, readTable& names)
 {
-	int maxt = 1;
-#pragma omp parallel
+	struct truthLine {
+		field ref, read;
+		int start, end;
+	};
+	struct mapping {
+		readid_t ref, read;
+		int start, end;
+	};
+
+	int maxt = omp_get_max_threads();
+	std::vector<std::vector<truthLine>> local(maxt);
+	std::vector<std::vector<field>> columns(maxt);
+	std::vector<mapping> mapped;
+	readTable refs;
+
+	streamLines(file, [&](const char* begin, const char* end, int ithread)
 	{
-		maxt = omp_get_num_threads();
-	}
-
-	int nOverlap = std::count(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>(), '\n');
-	file.seekg(0,std::ios_base::beg);
-
-	std::vector<std::string> entries;
-	entries.reserve(nOverlap);
-
-	if(file)
-		for (int i = 0; i < nOverlap; ++i) {
-			std::string line;
-			std::getline(file, line);
-			entries.push_back(line);
-		}
-	file.close();
-
-	std::map<std::string, std::vector<overlap>> intermediate;
-	std::vector<std::map<std::string, std::vector<overlap>>> local(maxt);
-
-#pragma omp parallel for
-	for(int i = 0; i < nOverlap; i++) {
-
-		int ithread = omp_get_thread_num();
-
-		std::vector<std::string> v = split(entries[i], ' ');
-		overlap ioverlap;
-
-		if(isSimulated) {
-			ioverlap.ref   =       v[0];
-			ioverlap.read  = "@" + v[3];
-			ioverlap.start =       stoi(v[1]);
-			ioverlap.end   =       stoi(v[2]);
-		} else {
-			ioverlap.ref   =       v[0];
-			ioverlap.read  = "@" + v[1];
-			ioverlap.start =       stoi(v[2]);
-			ioverlap.end   =       stoi(v[3]);
+		std::vector<field>& v = columns[ithread];
+		split(begin, end, ' ', v);
+		if(v.size() < 4) return;
+
+		if(isSimulated)
+			local[ithread].push_back({v[0], v[3], toInt(v[1]), toInt(v[2])});
+		else
+			local[ithread].push_back({v[0], v[1], toInt(v[2]), toInt(v[3])});
+	},
+	[&]()
+	{
+		// one line per mapped read, few enough to intern serially
+		for(int i = 0; i < maxt; ++i)
+		{
+			for(const truthLine& l : local[i])
+				mapped.push_back({refs.intern(l.ref), names.intern(l.read), l.start, l.end});
+			local[i].clear();
 		}
-		auto it = local[ithread].find(ioverlap.ref);
+	});
 
-		if(it == local[ithread].end()) {
-			std::vector<overlap> tmp;
-			tmp.push_back(ioverlap);
-			local[ithread].insert(std::map<std::string, std::vector<overlap>>::value_type(ioverlap.ref, tmp));
-		}
-		else {
-			it->second.push_back(ioverlap);
-			local[ithread][ioverlap.ref] = it->second;
-		}
-	}
+	parallelSort(mapped, [](const mapping& lhs, const mapping& rhs)
+		{ return (lhs.ref < rhs.ref) || (lhs.ref == rhs.ref && lhs.start < rhs.start); });
 
-	for(int i = 0; i < maxt; ++i)
+	std::vector<std::vector<pairkey_t>> pairs(maxt);
+#pragma omp parallel for schedule(dynamic, 1024)
+	for(size_t i = 0; i < mapped.size(); ++i)
 	{
-		intermediate = std::accumulate(local[i].begin(), local[i].end(), intermediate,
-				[](std::map<std::string, std::vector<overlap>>& m, 
-					const std::pair<std::string, std::vector<overlap>>& v)
-				{
-					m[v.first].insert(m[v.first].end(), v.second.begin(), v.second.end());
-					return m;
-				});
-	}
-
-	vector<Interval<std::string>> intervals;
-	vector<Interval<std::string>> queries;
-	std::set<entry, classcom> Gset;
+		int ithread = omp_get_thread_num();
+		const mapping& mi = mapped[i];
 
-	for(auto key = intermediate.begin(); key != intermediate.end(); ++key) {
-		for(auto it = key->second.begin(); it != key->second.end(); ++it)
+		for(size_t j = i + 1; j < mapped.size() && mapped[j].ref == mi.ref && mapped[j].start <= mi.end - minOverlap; ++j)
 		{
-			intervals.push_back(Interval<std::string>(it->start, it->end, it->read));
-			queries.push_back(Interval<std::string>(it->start, it->end, it->read));
-		}
+			const mapping& mj = mapped[j];
+			int alignment = std::min(mi.end, mj.end) - mj.start;
 
-		IntervalTree<string> tree;
-		tree = IntervalTree<std::string>(intervals);
-
-		for (auto q = queries.begin(); q != queries.end(); ++q) {
-			vector<Interval<std::string>> results;
-			tree.findOverlapping(q->start, q->stop, q->value, results, minOverlap, Gset);
+			if(alignment >= minOverlap && mi.read != mj.read) // do not count self alignment
+				pairs[ithread].push_back(canonical(makeKey(mi.read, mj.read)));
 		}
-
-		intervals.clear();
-		queries.clear();
 	}
+	std::vector<mapping>().swap(mapped);
+
+	std::vector<pairkey_t> Gset = concatenate(pairs);
+	sortUnique(Gset);
 
 #ifdef DEBUG
 	// in sam format all mapped segments in alignment lines are represented on the forward genomic strand
 	std::cout << std::endl;
-	std::cout << Gset.size() << " overlaps in the ground truth longer than " << minOverlap << " bp"<< std::endl;
+	std::cout << 2*Gset.size() << " overlaps in the ground truth longer than " << minOverlap << " bp"<< std::endl;
 	std::cout << std::endl;
 #endif
 
 	return Gset;
 };
 
-std::set<entry, classcom> readBellaOutput(std::ifstream& file, int minOverlap, bool alignment)
+// names and overlap length of a line of a tool output
+struct toolRecord {
+	field a, b;
+	int overlap;
+};
+
+/**
+ * @brief readOutput streams a tool output and keeps the pairs of distinct reads (overlapping at least minOverlap
+ * if alignment is true); names missing from the ground truth get new ids, so their pairs are false positives
+ * @param ncolumns lines with fewer columns are skipped
+ * @param toRecord toRecord(columns, record, scratch) sets the names and the overlap length of a line
+ * @return the sorted keys (a, b) in the order the tool reports them
+ */
+template <typename RecordFn>
+std::vector<pairkey_t> readOutput(std::ifstream& file, readTable& names, char delim, size_t ncolumns,
+	int minOverlap, bool alignment, RecordFn toRecord)
 {
-	int maxt = 1;
-#pragma omp parallel
+	struct unknownName {
+		size_t index;	// of the key
+		bool second;	// first or second read of the key
+		field name;
+	};
+	struct toolThread {
+		std::vector<field> v;
+		std::string scratch;
+		std::vector<pairkey_t> keys;
+		std::vector<unknownName> unknown;
+	};
+
+	int maxt = omp_get_max_threads();
+	std::vector<toolThread> local(maxt);
+
+	streamLines(file, [&](const char* begin, const char* end, int ithread)
 	{
-		maxt = omp_get_num_threads();
-	}
-
-	int nOverlap = std::count(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>(), '\n');
-	file.seekg(0,std::ios_base::beg);
-	std::vector<std::string> entries;
-
-	if(file)
-		for (int i = 0; i < nOverlap; ++i) {
-			std::string line;
-			std::getline(file, line);
-			entries.push_back(line);
-		}
-	file.close();
-
-	std::set<entry, classcom> result;
-	std::vector<std::set<entry, classcom>> local(maxt);
-
-#pragma omp parallel for
-	for(int i = 0; i < nOverlap; i++) {
-		int ithread = omp_get_thread_num();
-
-		std::vector<std::string> v = split(entries[i], '\t');
-		entry ientry;
-
-		//	std::cout << "What's up, dude?" << std::endl;
-		ientry.a = "@" + v[0];
-		ientry.b = "@" + v[1];
-
-		if(ientry.a != ientry.b) {
-
-			ientry.overlap = stoi(v[4]);
-
-			if(alignment) {
-				if(ientry.overlap >= minOverlap)
-					local[ithread].insert(ientry);
-			}
-			else {
-				local[ithread].insert(ientry);
+		toolThread& my = local[ithread];
+		split(begin, end, delim, my.v);
+		if(my.v.size() < ncolumns) return;
+
+		toolRecord r;
+		toRecord(my.v, r, my.scratch);
+
+		if(r.a == r.b) return;
+		if(alignment && r.overlap < minOverlap) return;
+
+		readid_t a = 0, b = 0;
+		if(!names.find(r.a, a, my.scratch)) my.unknown.push_back({my.keys.size(), false, r.a});
+		if(!names.find(r.b, b, my.scratch)) my.unknown.push_back({my.keys.size(), true,  r.b});
+		my.keys.push_back(makeKey(a, b));
+	},
+	[&]()
+	{
+		for(int i = 0; i < maxt; ++i)
+		{
+			for(const unknownName& u : local[i].unknown)
+			{
+				pairkey_t& key = local[i].keys[u.index];
+				readid_t id = names.intern(u.name);
+				key = u.second ? makeKey(firstRead(key), id) : makeKey(id, secondRead(key));
 			}
+			local[i].unknown.clear();
 		}
-	}
+	});
 
+	std::vector<std::vector<pairkey_t>> keys(maxt);
 	for(int i = 0; i < maxt; ++i)
-		result.insert(local[i].begin(), local[i].end());
+		keys[i].swap(local[i].keys);
+
+	std::vector<pairkey_t> result = concatenate(keys);
+	sortUnique(result);
+	return result;
+}
+
+std::vector<pairkey_t> readBellaOutput(std::ifstream& file, readTable& names, int minOverlap, bool alignment)
+{
+	std::vector<pairkey_t> result = readOutput(file, names, '\t', 5, minOverlap, alignment,
+		[](const std::vector<field>& v, toolRecord& r, std::string&)
+	{
+		r.a = v[0];
+		r.b = v[1];
+		r.overlap = toInt(v[4]);
+	});
 #ifdef DEBUG
 	std::cout << "Bella identified " << 2*result.size() << " overlaps" << std::endl;
 #endif
 	return result;
 };
 
-std::set<entry, classcom> readMinimapOutput(std::ifstream& file, int minOverlap, bool alignment)
+std::vector<pairkey_t> readMinimapOutput(std::ifstream& file, readTable& names, int minOverlap, bool alignment)
 {
-	int maxt = 1;
-#pragma omp parallel
+	std::vector<pairkey_t> result = readOutput(file, names, '\t', 9, minOverlap, alignment,
+		[](const std::vector<field>& v, toolRecord& r, std::string&)
 	{
-		maxt = omp_get_num_threads();
-	}
-
-	int nOverlap = std::count(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>(), '\n');
-	file.seekg(0,std::ios_base::beg);
-	std::vector<std::string> entries;
-
-	if(file)
-		for (int i = 0; i < nOverlap; ++i) {
-			std::string line;
-			std::getline(file, line);
-			entries.push_back(line);
+		r.a = v[0];
+		r.b = v[5];
+
+	//	paf format
+		int lenV = toInt(v[1]);
+		int begV = toInt(v[2]);
+		int endV = toInt(v[3]);
+		int lenH = toInt(v[6]);
+		int begH = toInt(v[7]);
+		int endH = toInt(v[8]);
+
+	//	coordinate are reported on the original strand in paf format
+		if(v[4] == "-") {
+			int tmp = begH;
+			begH = lenH - endH;
+			endH = lenH - tmp;
 		}
-	file.close();
-
-	std::set<entry, classcom> result;
-	std::vector<std::set<entry, classcom>> local(maxt);
-
-#pragma omp parallel for
-	for(int i = 0; i < nOverlap; i++) {
-		int ithread = omp_get_thread_num();
-
-		std::vector<std::string> v = split(entries[i], '\t');
-		entry ientry;
-
-	//	std::cout << "What's up, dude?" << std::endl;
-		ientry.a = "@" + v[0];
-		ientry.b = "@" + v[5];
-
-		if(ientry.a != ientry.b) {
-		//	paf format
-			int lenV = std::stoi(v[1]);
-			int begV = std::stoi(v[2]);
-			int endV = std::stoi(v[3]);
-			int lenH = std::stoi(v[6]);
-			int begH = std::stoi(v[7]);
-			int endH = std::stoi(v[8]);
-
-		//	coordinate are reported on the original strand in paf format
-			if(v[4] == "-") {
-				int tmp = begH;
-				begH = lenH - endH;
-				endH = lenH - tmp;
-			}
 
-		//	(int begV, int endV, int lenV, int begH, int endH, int lenH, int overlap)
-			estimateOverlap(begV, endV, lenV, 
-					begH, endH, lenH, ientry.overlap);
-
-			if(alignment) {
-				if(ientry.overlap >= minOverlap)
-					local[ithread].insert(ientry);
-			}
-			else {
-				local[ithread].insert(ientry);
-			}
-		}
-	}
-
-	for(int i = 0; i < maxt; ++i)
-		result.insert(local[i].begin(), local[i].end());
+	//	(int begV, int endV, int lenV, int begH, int endH, int lenH, int overlap)
+		estimateOverlap(begV, endV, lenV,
+				begH, endH, lenH, r.overlap);
+	});
 #ifdef DEBUG
 	std::cout << "Minimap2 identified " << 2*result.size() << " overlaps" << std::endl;
 #endif
 	return result;
 };
 
-std::set<entry, classcom> readMecatOutput(std::ifstream& file, std::ifstream& index, int minOverlap, bool alignment)
+std::vector<pairkey_t> readMecatOutput(std::ifstream& file, std::ifstream& index, readTable& names, int minOverlap, bool alignment)
 {
-	std::map<std::string, std::string> namestable;
+	std::unordered_map<std::string, std::string> namestable;
 	tomap(index, namestable);
 
-	int maxt = 1;
-#pragma omp parallel
+	std::vector<pairkey_t> result = readOutput(file, names, '\t', 12, minOverlap, alignment,
+		[&namestable](const std::vector<field>& v, toolRecord& r, std::string& scratch)
 	{
-		maxt = omp_get_num_threads();
-	}
-
-	int nOverlap = std::count(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>(), '\n');
-	file.seekg(0,std::ios_base::beg);
-	std::vector<std::string> entries;
-
-	if(file)
-		for (int i = 0; i < nOverlap; ++i) {
-			std::string line;
-			std::getline(file, line);
-			entries.push_back(line);
-		}
-	file.close();
-
-	std::set<entry, classcom> result;
-	std::vector<std::set<entry, classcom>> local(maxt);
-
-#pragma omp parallel for
-	for(int i = 0; i < nOverlap; i++) {
-		int ithread = omp_get_thread_num();
-
-		std::vector<std::string> v = split(entries[i], '\t');
-		entry ientry;
-
-	//	std::cout << "What's up, dude?" << std::endl;
-		ientry.a = "@" + toread(v[0], namestable);
-		ientry.b = "@" + toread(v[1], namestable);
-
-
-		if(ientry.a != ientry.b) {
-		//	mecat format
-			int begV = std::stoi(v[5]);
-			int endV = std::stoi(v[6]);
-			int lenV = std::stoi(v[7]);
-			int begH = std::stoi(v[9]);
-			int endH = std::stoi(v[10]);
-			int lenH = std::stoi(v[11]);
-
-		//	the positions are zero-based and are based on the forward strand, whatever which strand the sequence is mapped
-		//	(int begV, int endV, int lenV, int begH, int endH, int lenH, int overlap)
-			estimateOverlap(begV, endV, lenV, 
-					begH, endH, lenH, ientry.overlap);
-
-			if(alignment) {
-				if(ientry.overlap >= minOverlap)
-					local[ithread].insert(ientry);
-			}
-			else {
-				local[ithread].insert(ientry);
-			}
-		}
-	}
-
-	for(int i = 0; i < maxt; ++i)
-		result.insert(local[i].begin(), local[i].end());
+		r.a = toread(v[0], namestable, scratch);
+		r.b = toread(v[1], namestable, scratch);
+
+	//	mecat format
+		int begV = toInt(v[5]);
+		int endV = toInt(v[6]);
+		int lenV = toInt(v[7]);
+		int begH = toInt(v[9]);
+		int endH = toInt(v[10]);
+		int lenH = toInt(v[11]);
+
+	//	the positions are zero-based and are based on the forward strand, whatever which strand the sequence is mapped
+	//	(int begV, int endV, int lenV, int begH, int endH, int lenH, int overlap)
+		estimateOverlap(begV, endV, lenV,
+				begH, endH, lenH, r.overlap);
+	});
 #ifdef DEBUG
 	std::cout << "Mecat identified " << 2*result.size() << " overlaps" << std::endl;
 #endif
 	return result;
 };
 
-std::set<entry, classcom> readMhapOutput(std::ifstream& file, int minOverlap, bool alignment)
+std::vector<pairkey_t> readMhapOutput(std::ifstream& file, readTable& names, int minOverlap, bool alignment)
 {
-	int maxt = 1;
-#pragma omp parallel
+	// 	0		1		2				3				4				5		6			7		8					9			10		11
+	// [A ID] [B ID] [% error] [# shared min-mers] [0=A fwd, 1=A rc] [A start] [A end] [A length] [0=B fwd, 1=B rc] [B start] [B end] [B length]
+	std::vector<pairkey_t> result = readOutput(file, names, ' ', 12, minOverlap, alignment,
+		[](const std::vector<field>& v, toolRecord& r, std::string&)
 	{
-		maxt = omp_get_num_threads();
-	}
-
-	int nOverlap = std::count(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>(), '\n');
-	file.seekg(0,std::ios_base::beg);
-	std::vector<std::string> entries;
-
-	if(file)
-		for (int i = 0; i < nOverlap; ++i) {
-			std::string line;
-			std::getline(file, line);
-			entries.push_back(line);
-		}
-	file.close();
-
-	std::set<entry, classcom> result;
-	std::vector<std::set<entry, classcom>> local(maxt);
-
-#pragma omp parallel for
-	for(int i = 0; i < nOverlap; i++) {
-		int ithread = omp_get_thread_num();
-
-		std::vector<std::string> v = split(entries[i], ' ');
-		entry ientry;
-
-		ientry.a = "@" + v[0];
-		ientry.b = "@" + v[1];
-		// 	0		1		2				3				4				5		6			7		8					9			10		11
-		// [A ID] [B ID] [% error] [# shared min-mers] [0=A fwd, 1=A rc] [A start] [A end] [A length] [0=B fwd, 1=B rc] [B start] [B end] [B length]
-		if(ientry.a != ientry.b) {
-
-		//	mhap m4 format
-			int begV = std::stoi(v[5]);
-			int endV = std::stoi(v[6]);
-			int lenV = std::stoi(v[7]);
-			int begH = std::stoi(v[9]);
-			int endH = std::stoi(v[10]);
-			int lenH = std::stoi(v[11]);
-
-		//	(int begV, int endV, int lenV, int begH, int endH, int lenH, int overlap)
-			estimateOverlap(begV, endV, lenV, 
-					begH, endH, lenH, ientry.overlap);
-
-			if(alignment) {
-				if(ientry.overlap >= minOverlap)
-					local[ithread].insert(ientry);
-			}
-			else {
-				local[ithread].insert(ientry);
-			}
-		}
-	}
-
-	for(int i = 0; i < maxt; ++i)
-		result.insert(local[i].begin(), local[i].end());
+		r.a = v[0];
+		r.b = v[1];
+
+	//	mhap m4 format
+		int begV = toInt(v[5]);
+		int endV = toInt(v[6]);
+		int lenV = toInt(v[7]);
+		int begH = toInt(v[9]);
+		int endH = toInt(v[10]);
+		int lenH = toInt(v[11]);
+
+	//	(int begV, int endV, int lenV, int begH, int endH, int lenH, int overlap)
+		estimateOverlap(begV, endV, lenV,
+				begH, endH, lenH, r.overlap);
+	});
 #ifdef DEBUG
 	std::cout << "Mhap identified " << result.size() << " overlaps" << std::endl;
 #endif
 	return result;
 };
 
-std::set<entry, classcom> readBlasrOutput(std::ifstream& file, int minOverlap, bool alignment)
+std::vector<pairkey_t> readBlasrOutput(std::ifstream& file, readTable& names, int minOverlap, bool alignment)
 {
-	int maxt = 1;
-#pragma omp parallel
+	std::vector<pairkey_t> result = readOutput(file, names, ' ', 12, minOverlap, alignment,
+		[](const std::vector<field>& v, toolRecord& r, std::string&)
 	{
-		maxt = omp_get_num_threads();
-	}
-
-	int nOverlap = std::count(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>(), '\n');
-	file.seekg(0,std::ios_base::beg);
-	std::vector<std::string> entries;
-
-	if(file)
-		for (int i = 0; i < nOverlap; ++i) {
-			std::string line;
-			std::getline(file, line);
-			entries.push_back(line);
-		}
-	file.close();
-
-	std::set<entry, classcom> result;
-	std::vector<std::set<entry, classcom>> local(maxt);
-
-#pragma omp parallel for
-	for(int i = 0; i < nOverlap; i++) {
-		int ithread = omp_get_thread_num();
-
-		std::vector<std::string> v = split(entries[i], ' ');
-		entry ientry;
-	//	std::cout << "What's up, dude?" << std::endl;
-		ientry.a = "@" + v[0];
-		ientry.b = "@" + v[1];
-
-		if(ientry.a != ientry.b) {
-		//	blasr 4m format
-			int begV = std::stoi(v[5]);
-			int endV = std::stoi(v[6]);
-			int lenV = std::stoi(v[7]);
-			int begH = std::stoi(v[9]);
-			int endH = std::stoi(v[10]);
-			int lenH = std::stoi(v[11]);
-
-		//	figure out write to adam/sergey?
-			//if(v[8] == "1") {
-			//	int tmp = begH;
-			//	begH = lenH - endH;
-			//	endH = lenH - tmp;
-			//}
-
-		//	(int begV, int endV, int lenV, int begH, int endH, int lenH, int overlap)
-			estimateOverlap(begV, endV, lenV, 
-					begH, endH, lenH, ientry.overlap);
-
-			if(alignment) {
-				if(ientry.overlap >= minOverlap)
-					local[ithread].insert(ientry);
-			}
-			else {
-				local[ithread].insert(ientry);
-			}
-		}
-	}
-
-	for(int i = 0; i < maxt; ++i)
-		result.insert(local[i].begin(), local[i].end());
+		r.a = v[0];
+		r.b = v[1];
+
+	//	blasr 4m format
+		int begV = toInt(v[5]);
+		int endV = toInt(v[6]);
+		int lenV = toInt(v[7]);
+		int begH = toInt(v[9]);
+		int endH = toInt(v[10]);
+		int lenH = toInt(v[11]);
+
+	//	figure out write to adam/sergey?
+		//if(v[8] == "1") {
+		//	int tmp = begH;
+		//	begH = lenH - endH;
+		//	endH = lenH - tmp;
+		//}
+
+	//	(int begV, int endV, int lenV, int begH, int endH, int lenH, int overlap)
+		estimateOverlap(begV, endV, lenV,
+				begH, endH, lenH, r.overlap);
+	});
 #ifdef DEBUG
 	std::cout << "Blasr identified " << result.size() << " overlaps" << std::endl;
 #endif
 	return result;
 };
 
-std::set<entry, classcom> readDalignerOutput(std::ifstream& file, int minOverlap, bool alignment)
+std::vector<pairkey_t> readDalignerOutput(std::ifstream& file, readTable& names, int minOverlap, bool alignment)
 {
-	int maxt = 1;
-#pragma omp parallel
+	std::vector<pairkey_t> result = readOutput(file, names, ' ', 9, minOverlap, alignment,
+		[](const std::vector<field>& v, toolRecord& r, std::string&)
 	{
-		maxt = omp_get_num_threads();
-	}
-
-	int nOverlap = std::count(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>(), '\n');
-	file.seekg(0,std::ios_base::beg);
-	std::vector<std::string> entries;
-
-	if(file)
-		for (int i = 0; i < nOverlap; ++i) {
-			std::string line;
-			std::getline(file, line);
-			entries.push_back(line);
-		}
-	file.close();
-
-	std::set<entry, classcom> result;
-	std::vector<std::set<entry, classcom>> local(maxt);
-
-#pragma omp parallel for
-	for(int i = 0; i < nOverlap; i++) {
-		int ithread = omp_get_thread_num();
-
-		std::vector<std::string> v = split(entries[i], ' ');
-		entry ientry;
-	//	std::cout << "What's up, dude?" << std::endl;
-		ientry.a = "@" + v[0];
-		ientry.b = "@" + v[1];
-
-		if(ientry.a != ientry.b) {
-		//	daligner format according to our script
-			int begV = std::stoi(v[3]);
-			int endV = std::stoi(v[4]);
-			int lenV = std::stoi(v[5]);
-			int begH = std::stoi(v[6]);
-			int endH = std::stoi(v[7]);
-			int lenH = std::stoi(v[8]);
-
-			if(v[2] == "c") {
-				int tmp = begH;
-				begH = lenH - endH;
-				endH = lenH - tmp;
-			}
-
-		//	(int begV, int endV, int lenV, int begH, int endH, int lenH, int overlap)
-			estimateOverlap(begV, endV, lenV, 
-					begH, endH, lenH, ientry.overlap);
-
-			if(alignment) {
-				if(ientry.overlap >= minOverlap)
-					local[ithread].insert(ientry);
-			}
-			else {
-				local[ithread].insert(ientry);
-			}
+		r.a = v[0];
+		r.b = v[1];
+
+	//	daligner format according to our script
+		int begV = toInt(v[3]);
+		int endV = toInt(v[4]);
+		int lenV = toInt(v[5]);
+		int begH = toInt(v[6]);
+		int endH = toInt(v[7]);
+		int lenH = toInt(v[8]);
+
+		if(v[2] == "c") {
+			int tmp = begH;
+			begH = lenH - endH;
+			endH = lenH - tmp;
 		}
-	}
 
-	for(int i = 0; i < maxt; ++i)
-		result.insert(local[i].begin(), local[i].end());
+	//	(int begV, int endV, int lenV, int begH, int endH, int lenH, int overlap)
+		estimateOverlap(begV, endV, lenV,
+				begH, endH, lenH, r.overlap);
+	});
 #ifdef DEBUG
 	std::cout << "Daligner identified " << result.size() << " overlaps" << std::endl;
 #endif
 	return result;
 };
 
-void evaluate(std::set<entry, classcom>& Sset, const std::set<entry, classcom>& Gset, 
+/**
+ * @brief evaluate counts the reported pairs found in the ground truth; Gset holds one canonical key per true pair,
+ * so the ground truth has 2*Gset.size() ordered pairs, as many as the pairs reported by tools listing both (a, b) and (b, a)
+ */
+void evaluate(const std::vector<pairkey_t>& Sset, const std::vector<pairkey_t>& Gset,
 	int minOverlap, bool duplicate, bool alignment)
 {
-	std::set<entry, classcom> Tset;
+	size_t Tsize = 0;	// true positives
 
-	std::set_intersection(
-		Gset.begin(), Gset.end(),
-		Sset.begin(), Sset.end(),
-		std::inserter(Tset, Tset.end())
-	);
+#pragma omp parallel for reduction(+:Tsize)
+	for(size_t i = 0; i < Sset.size(); ++i)
+		if(std::binary_search(Gset.begin(), Gset.end(), canonical(Sset[i])))
+			++Tsize;
 
 	float RC;
 	if(duplicate)
 	{
 	#ifdef DEBUG
 		std::cout << "\t* " << 2*Sset.size() << " overlaps longer than " << minOverlap << " bp" << std::endl;
-		std::cout << "\t* " << 2*Tset.size() << " true positives" << std::endl;
+		std::cout << "\t* " << 2*Tsize << " true positives" << std::endl;
 	#endif
-		RC   = ((float)(2 * Tset.size()) / (float)Gset.size()) * 100;
+		RC   = ((float)(2 * Tsize) / (float)(2 * Gset.size())) * 100;
 	}
 	else
 	{
 	#ifdef DEBUG
 		std::cout << "\t* " << Sset.size() << " overlaps longer than " << minOverlap << " bp" << std::endl;
-		std::cout << "\t* " << Tset.size() << " true positives" << std::endl;
+		std::cout << "\t* " << Tsize << " true positives" << std::endl;
 	#endif
-		RC   = ((float)Tset.size()       / (float)Gset.size()) * 100;
+		RC   = ((float)Tsize       / (float)(2 * Gset.size())) * 100;
 	}
 
-	float PR = ((float)Tset.size()       / (float)Sset.size()) * 100;
+	float PR = ((float)Tsize       / (float)Sset.size()) * 100;
 	float F1 = (2 * RC * PR) / (RC + PR);
 
 	std::cout << std::setprecision(2) 	<< std::fixed;
@@ -13,7 +13,7 @@ extern "C" {
 }
 #endif
 
-#include "lostintranslation.h"  
+#include "lostintranslation.h"
 #include <omp.h>
 #include <fstream>
 #include <iostream>
@@ -125,28 +125,30 @@ int main (int argc, char* argv[]) {
     free(optList);
     free(thisOpt);
 
+    if(filename == NULL)
+    {
+        cout << "Output filename is missing, add it with -f" << endl;
+        return 0;
+    }
+
     if(b != NULL)
     {
-        ifstream input(b);
-        BELLA2PAF(input, filename);
+        BELLA2PAF(b, filename);
     }
     else if(m != NULL)
     {
-        ifstream input(m);
-        MHAP2PAF(input, filename);
+        MHAP2PAF(m, filename);
     }
     else if(r != NULL)
     {
-        ifstream input(r);
-        BLASR2PAF(input, filename);
+        BLASR2PAF(r, filename);
     }
     else if(t != NULL)
     {
         if(index != NULL)
         {
-            ifstream input(t);
             ifstream idx(index);
-            MECAT2PAF(input, filename, idx);
+            MECAT2PAF(t, filename, idx);
         }
         else
         {
@@ -156,8 +158,7 @@ int main (int argc, char* argv[]) {
     }
     else if(d != NULL)
     {
-        ifstream input(d);
-        DALIGNER2PAF(input, filename);
+        DALIGNER2PAF(d, filename);
     }
     //else if(B != NULL)
     //{
@@ -4,25 +4,27 @@
 #include <string>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <algorithm>
 #include <cmath>
 #include <numeric>
 #include <vector>
-#include <sys/types.h> 
-#include <sys/stat.h> 
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <math.h>
 #include <limits.h>
 #include <bitset>
-#include <map>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <unistd.h>
-#include <ctype.h> 
+#include <ctype.h>
 #include <sstream>
-#include <set>
 #include <memory>
 #include <typeinfo>
+#include "def.h"
 
 using namespace std;
 
@@ -40,14 +42,19 @@ using namespace std;
  * alignment block length (overlap length)      ---> GGGG: I compute this if missing
  * mapping quality (0-255; 255 for missing) */
 
-/* If PAF is generated from an alignment, column 10 equals the number of sequence matches, and column 11 equals the total 
-number of sequence matches, mismatches, insertions and deletions in the alignment. If alignment is not available, 
+/* If PAF is generated from an alignment, column 10 equals the number of sequence matches, and column 11 equals the total
+number of sequence matches, mismatches, insertions and deletions in the alignment. If alignment is not available,
 column 10 and 11 are still required but may be highly inaccurate. */
 
+/* input bytes translated per thread at a time, the output of a round is written before the next one starts */
+#ifndef CHUNKSIZE
+#define CHUNKSIZE (32 * 1024 * 1024)
+#endif
+
 //=======================================================================
-// 
+//
 // Common functions
-// 
+//
 //=======================================================================
 
 int estimate (int begpV, int endpV, int lenV, int begpH, int endpH, int lenH)
@@ -61,28 +68,42 @@ int estimate (int begpV, int endpV, int lenV, int begpH, int endpH, int lenH)
     return ovlen;
 }
 
-vector<std::string> split (const std::string &s, char delim)
+/* appends a column and its separator to a PAF line */
+inline void column (std::string& out, const field& f, char sep = '\t')
 {
-    std::vector<std::string> result;
-    std::stringstream ss (s);
-    std::string item;
+    out.append(f.ptr, f.len);
+    out.push_back(sep);
+}
 
-    while (std::getline (ss, item, delim))
-    {
-        result.push_back (item);
-    }
+inline void column (std::string& out, int64_t n, char sep = '\t')
+{
+    char buf[24];
+    int len = snprintf(buf, sizeof(buf), "%lld", (long long)n);
+    out.append(buf, len);
+    out.push_back(sep);
+}
 
-    return result;
+inline void column (std::string& out, const char* s, char sep = '\t')
+{
+    out.append(s);
+    out.push_back(sep);
 }
 
-/* from mecat index file to a map<uint32_t,string> : map<index,read-name> */
-void mecatidx (ifstream& idx2read, map<uint32_t, std::string>& names)
+/* mecat index to read name, indexes are dense so names are stored back to back and found by offset */
+struct mecatNames {
+    std::vector<char> pool;
+    std::vector<int64_t> offset;   // -1 if the index is not in idx2read
+    std::vector<uint32_t> length;
+};
+
+/* from mecat index file to a flat table: index -> read-name */
+void mecatidx (ifstream& idx2read, mecatNames& names)
 {
     string num, name, seq;
     uint32_t idx;
 
     if(idx2read.is_open())
-    {   
+    {
         string line;
         while(getline(idx2read, line))
         {
@@ -92,12 +113,23 @@ void mecatidx (ifstream& idx2read, map<uint32_t, std::string>& names)
             getline(linestream, name, ' ' );
 
             /* sequence on new line */
-            getline(idx2read, seq); 
+            getline(idx2read, seq);
 
             idx = stoi(num);
             /* remove first char'>' */
-            name.erase(0, 1); 
-            names.insert(std::make_pair(idx, name));
+            name.erase(0, 1);
+
+            if(idx >= names.offset.size())
+            {
+                names.offset.resize(idx + 1, -1);
+                names.length.resize(idx + 1, 0);
+            }
+            if(names.offset[idx] < 0)    // the first occurrence wins, as in a map
+            {
+                names.offset[idx] = names.pool.size();
+                names.length[idx] = name.size();
+                names.pool.insert(names.pool.end(), name.begin(), name.end());
+            }
         }
         cout << "MECAT idx2read table created" << endl;
     }
@@ -109,14 +141,10 @@ void mecatidx (ifstream& idx2read, map<uint32_t, std::string>& names)
 }
 
 /* from mecat numeric id to read name */
-std::string idx2read(uint32_t idx, map<uint32_t, std::string>& names)
+field idx2read(uint32_t idx, const mecatNames& names)
 {
-    map<uint32_t, std::string>::iterator it;
-    string name;
-
-    it = names.find(idx);
-    if(it != names.end())
-        return names[idx];
+    if(idx < names.offset.size() && names.offset[idx] >= 0)
+        return { names.pool.data() + names.offset[idx], names.length[idx] };
     else
     {
         cout << "Read " << idx << " not present in MECAT output" << endl;
@@ -124,160 +152,181 @@ std::string idx2read(uint32_t idx, map<uint32_t, std::string>& names)
     }
 }
 
-//=======================================================================
-// 
-// BELLA to PAF (BELLA directly outputs in PAF format if run with -p)
-// 
-//=======================================================================
-
-void BELLA2PAF(ifstream& input, char* filename)
+/**
+ * @brief translate maps the input and converts it in rounds: each thread takes a chunk of whole lines, translates it
+ * into its own buffer, and the buffers are written at their prefix-sum offsets, so the output keeps the input order
+ * @param toPAF toPAF(columns, out) appends the PAF line of an input line; lines with less than ncolumns are skipped
+ */
+template <typename LineFn>
+void translate(const char* inputname, char* filename, char delim, size_t ncolumns, LineFn toPAF)
 {
-    int maxt = 1;
-#pragma omp parallel
+    int fd = open(inputname, O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0)
     {
-        maxt = omp_get_num_threads();
+        cout << "Input file " << inputname << " failed to open" << endl;
+        exit(1);
     }
+    size_t filesize = st.st_size;
 
-    uint64_t numoverlap = std::count(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>(), '\n');
-    input.seekg(0, std::ios_base::beg);
-
-    vector<std::string> entries;
-    vector<std::stringstream> local(maxt);      
-
-    /* read input file */
-    if(input)
-        for (int i = 0; i < numoverlap; ++i)
+    const char* data = NULL;
+    if(filesize > 0)
+    {
+        data = (const char*)mmap(NULL, filesize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data == MAP_FAILED)
         {
-            std::string line;
-            std::getline(input, line);
-            entries.push_back(line);
+            cout << "Input file " << inputname << " failed to map" << endl;
+            exit(1);
         }
-    input.close();
-
-    /* transform BELLA output in PAF format */
-#pragma omp parallel for
-    for(uint64_t i = 0; i < numoverlap; i++) 
-    {
-        int ithread = omp_get_thread_num();
-        /* BELLA format: cname, rname, numkmer, score, rev, cstart, cend, clen, rstart, rend, rlen */
-        std::vector<std::string> v = split (entries[i], '\t');
-        /* improve readability */
-        std::string& nameV = v[0];
-        std::string& nameH = v[1];
-        std::string& score = v[3];
-        std::string& isRev = v[4];
-        std::string& begpV = v[5];
-        std::string& endpV = v[6];
-        std::string& lengV = v[7];
-        std::string& begpH = v[8];
-        std::string& endpH = v[9];
-        std::string& lengH = v[10];
-
-        /* change strand formatting */
-        if(isRev == "n") isRev = "+";         
-            else isRev = "-";
-
-        /* compute overlap length if missing (begpV, endpV, lenV, begpH, endpH, lenH) */
-        int ovlen = estimate (stoi(begpV), stoi(endpV), stoi(lengV), stoi(begpH), stoi(endpH), stoi(lengH));
-
-        local[ithread] << nameV << "\t" << lengV << "\t" << begpV << "\t" << endpV << "\t" << isRev 
-            << "\t" << nameH << "\t" << lengH << "\t" << begpH << "\t" << endpH << "\t" << score 
-                << "\t" << ovlen << "\t255" << endl;
+        madvise((void*)data, filesize, MADV_SEQUENTIAL);
     }
 
-    /* write to a new file */
-    int64_t * bytes = new int64_t[maxt];
-    for(int i = 0; i < maxt; ++i)
+    int out = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(out < 0)
     {
-        local[i].seekg(0, ios::end);
-        bytes[i] = local[i].tellg();
-        local[i].seekg(0, ios::beg);
+        cout << "File " << filename << " failed to open" << endl;
+        exit(1);
     }
-    int64_t bytestotal = std::accumulate(bytes, bytes + maxt, static_cast<int64_t>(0));
 
-    std::ofstream output(filename, std::ios::binary | std::ios::app);
-#ifdef PRINT
-    cout << "Creating or appending to output file with " << (double)bytestotal/(double)(1024 * 1024) << " MB" << endl;
-#endif
-    output.seekp(bytestotal - 1);
-    /* this will likely create a sparse file so the actual disks won't spin yet */
-    output.write("", 1); 
-    output.close();
+    int maxt = omp_get_max_threads();
+    vector<std::string> local(maxt);
+    vector<size_t> bounds(maxt + 1);
+    vector<int64_t> bytes(maxt + 1);
+    size_t round = 0;       // first input byte of the round
+    int64_t written = 0;    // output bytes so far
 
-    #pragma omp parallel
+    while(round < filesize)
     {
-        int ithread = omp_get_thread_num(); 
+        /* chunk boundaries moved forward to the next line start */
+        size_t last = min(filesize, round + (size_t)maxt * CHUNKSIZE);
+        bounds[0] = round;
+        for(int i = 1; i <= maxt; ++i)
+        {
+            size_t b = max(bounds[i-1], round + (last - round) * i / maxt);
+            if(i == maxt) b = last;
+            if(b > round && b < filesize && data[b-1] != '\n')
+            {
+                const char* nl = (const char*)memchr(data + b, '\n', filesize - b);
+                b = (nl != NULL) ? (nl - data) + 1 : filesize;
+            }
+            bounds[i] = b;
+        }
+
+    #pragma omp parallel num_threads(maxt)
+        {
+            int ithread = omp_get_thread_num();
+            std::vector<field> v;
+            std::string& text = local[ithread];
+            text.clear();
+
+            size_t b = bounds[ithread], e = bounds[ithread + 1];
+            while(b < e)
+            {
+                const char* nl = (const char*)memchr(data + b, '\n', e - b);
+                size_t stop = (nl != NULL) ? (nl - data) : e;
+                split(data + b, data + stop, delim, v);
+                if(v.size() >= ncolumns) toPAF(v, text);
+                b = stop + 1;
+            }
+            bytes[ithread + 1] = text.size();
+        }
 
-        FILE *ffinal;
-        /* then everyone fills it */
-        if ((ffinal = fopen(filename, "rb+")) == NULL) 
+        bytes[0] = written;
+        for(int i = 0; i < maxt; ++i)
+            bytes[i+1] += bytes[i];
+
+    #pragma omp parallel for num_threads(maxt)
+        for(int i = 0; i < maxt; ++i)
         {
-            fprintf(stderr, "File %s failed to open at thread %d\n", filename, ithread);
+            size_t done = 0;
+            while(done < local[i].size())
+            {
+                ssize_t w = pwrite(out, local[i].data() + done, local[i].size() - done, bytes[i] + done);
+                if(w < 0)
+                {
+                    fprintf(stderr, "File %s failed to write at thread %d\n", filename, i);
+                    exit(1);
+                }
+                done += w;
+            }
         }
-        int64_t bytesuntil = std::accumulate(bytes, bytes + ithread, static_cast<int64_t>(0));
-        fseek (ffinal , bytesuntil , SEEK_SET);
-        std::string text = local[ithread].str();
-        fwrite(text.c_str(),1, bytes[ithread], ffinal);
-        fflush(ffinal);
-        fclose(ffinal);
+        written = bytes[maxt];
+
+        /* the translated input is not needed anymore */
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t drop = (bounds[maxt] / page) * page;
+        if(drop > 0) madvise((void*)data, drop, MADV_DONTNEED);
+        round = bounds[maxt];
     }
-    delete [] bytes;
+
+#ifdef PRINT
+    cout << "Created output file with " << (double)written/(double)(1024 * 1024) << " MB" << endl;
+#endif
+    close(out);
+    if(data != NULL) munmap((void*)data, filesize);
+    close(fd);
 }
 
 //=======================================================================
-// 
-// MHAP to PAF
-// 
+//
+// BELLA to PAF (BELLA directly outputs in PAF format if run with -p)
+//
 //=======================================================================
 
-void MHAP2PAF(ifstream& input, char* filename)
+void BELLA2PAF(const char* input, char* filename)
 {
-    int maxt = 1;
-#pragma omp parallel
+    /* transform BELLA output in PAF format */
+    translate(input, filename, '\t', 11, [](const std::vector<field>& v, std::string& out)
     {
-        maxt = omp_get_num_threads();
-    }
+        /* BELLA format: cname, rname, numkmer, score, rev, cstart, cend, clen, rstart, rend, rlen */
+        /* improve readability */
+        const field& nameV = v[0];
+        const field& nameH = v[1];
+        const field& score = v[3];
+        const field& isRev = v[4];
+        const field& begpV = v[5];
+        const field& endpV = v[6];
+        const field& lengV = v[7];
+        const field& begpH = v[8];
+        const field& endpH = v[9];
+        const field& lengH = v[10];
 
-    uint64_t numoverlap = std::count(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>(), '\n');
-    input.seekg(0, std::ios_base::beg);
+        /* compute overlap length if missing (begpV, endpV, lenV, begpH, endpH, lenH) */
+        int ovlen = estimate (toInt(begpV), toInt(endpV), toInt(lengV), toInt(begpH), toInt(endpH), toInt(lengH));
 
-    vector<std::string> entries;
-    vector<std::stringstream> local(maxt);      
+        column(out, nameV); column(out, lengV); column(out, begpV); column(out, endpV);
+        /* change strand formatting */
+        column(out, (isRev == "n") ? "+" : "-");
+        column(out, nameH); column(out, lengH); column(out, begpH); column(out, endpH); column(out, score);
+        column(out, ovlen); column(out, "255", '\n');
+    });
+}
 
-    /* read input file */
-    if(input)
-        for (int i = 0; i < numoverlap; ++i)
-        {
-            std::string line;
-            std::getline(input, line);
-            entries.push_back(line);
-        }
-    input.close();
+//=======================================================================
+//
+// MHAP to PAF
+//
+//=======================================================================
 
+void MHAP2PAF(const char* input, char* filename)
+{
     /* transform MHAP output in PAF format */
-#pragma omp parallel for
-    for(uint64_t i = 0; i < numoverlap; i++) 
+    translate(input, filename, ' ', 12, [](const std::vector<field>& v, std::string& out)
     {
-        int ithread = omp_get_thread_num();
         /* MHAP format: cname, rname, err, nkmer, cstrand, cstart, cend, clen, rstrand, rstart, rend, rlen */
-        std::vector<std::string> v = split (entries[i], ' ');
         /* improve readability */
-        std::string& nameV = v[0];
-        std::string& nameH = v[1];
-        std::string& begpV = v[5];
-        std::string& endpV = v[6];
-        std::string& lengV = v[7];
-        std::string& isRev = v[8];
-        std::string& begpH = v[9];
-        std::string& endpH = v[10];
-        std::string& lengH = v[11];
-
-        /* change strand formatting */
-        if(isRev == "0") isRev = "+";         
-            else isRev = "-";
+        const field& nameV = v[0];
+        const field& nameH = v[1];
+        const field& begpV = v[5];
+        const field& endpV = v[6];
+        const field& lengV = v[7];
+        const field& isRev = v[8];
+        const field& begpH = v[9];
+        const field& endpH = v[10];
+        const field& lengH = v[11];
 
         /* compute overlap length if missing (begpV, endpV, lenV, begpH, endpH, lenH) */
-        int ovlen = estimate (stoi(begpV), stoi(endpV), stoi(lengV), stoi(begpH), stoi(endpH), stoi(lengH));
+        int ovlen = estimate (toInt(begpV), toInt(endpV), toInt(lengV), toInt(begpH), toInt(endpH), toInt(lengH));
 
         /* GGGG: If alignment is missing I estimate it as % of the overlap length and I determine that % using the error rate */
         // GGGG: Error rate is now hard-coded, need to be an input parameter
@@ -286,319 +335,120 @@ void MHAP2PAF(ifstream& input, char* filename)
         float identity = (1-error)*(1-error);
         int score = floor(identity*ovlen);
 
-        local[ithread] << nameV << "\t" << lengV << "\t" << begpV << "\t" << endpV << "\t" << isRev 
-            << "\t" << nameH << "\t" << lengH << "\t" << begpH << "\t" << endpH << "\t" << score 
-                << "\t" << ovlen << "\t255" << endl;
-    }
-
-    /* write to a new file */
-    int64_t * bytes = new int64_t[maxt];
-    for(int i = 0; i < maxt; ++i)
-    {
-        local[i].seekg(0, ios::end);
-        bytes[i] = local[i].tellg();
-        local[i].seekg(0, ios::beg);
-    }
-    int64_t bytestotal = std::accumulate(bytes, bytes + maxt, static_cast<int64_t>(0));
-
-    std::ofstream output(filename, std::ios::binary | std::ios::app);
-#ifdef PRINT
-    cout << "Creating or appending to output file with " << (double)bytestotal/(double)(1024 * 1024) << " MB" << endl;
-#endif
-    output.seekp(bytestotal - 1);
-    /* this will likely create a sparse file so the actual disks won't spin yet */
-    output.write("", 1); 
-    output.close();
-
-    #pragma omp parallel
-    {
-        int ithread = omp_get_thread_num(); 
-
-        FILE *ffinal;
-        /* then everyone fills it */
-        if ((ffinal = fopen(filename, "rb+")) == NULL) 
-        {
-            fprintf(stderr, "File %s failed to open at thread %d\n", filename, ithread);
-        }
-        int64_t bytesuntil = std::accumulate(bytes, bytes + ithread, static_cast<int64_t>(0));
-        fseek (ffinal , bytesuntil , SEEK_SET);
-        std::string text = local[ithread].str();
-        fwrite(text.c_str(),1, bytes[ithread], ffinal);
-        fflush(ffinal);
-        fclose(ffinal);
-    }
-    delete [] bytes;
+        column(out, nameV); column(out, lengV); column(out, begpV); column(out, endpV);
+        /* change strand formatting */
+        column(out, (isRev == "0") ? "+" : "-");
+        column(out, nameH); column(out, lengH); column(out, begpH); column(out, endpH); column(out, score);
+        column(out, ovlen); column(out, "255", '\n');
+    });
 }
 
 //=======================================================================
-// 
+//
 // MECAT to PAF
-// 
+//
 //=======================================================================
 
-void MECAT2PAF(ifstream& input, char* filename, ifstream& index)
+void MECAT2PAF(const char* input, char* filename, ifstream& index)
 {
-    map<uint32_t, std::string> names;
+    mecatNames names;
     mecatidx (index, names);
 
-    int maxt = 1;
-#pragma omp parallel
-    {
-        maxt = omp_get_num_threads();
-    }
-
-    uint64_t numoverlap = std::count(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>(), '\n');
-    input.seekg(0, std::ios_base::beg);
-
-    vector<std::string> entries;
-    vector<std::stringstream> local(maxt);      
-
-    /* read input file */
-    if(input)
-        for (int i = 0; i < numoverlap; ++i)
-        {
-            std::string line;
-            std::getline(input, line);
-            entries.push_back(line);
-        }
-    input.close();
-
     /* transform MECAT output in PAF format */
-#pragma omp parallel for
-    for(uint64_t i = 0; i < numoverlap; i++) 
+    translate(input, filename, '\t', 12, [&names](const std::vector<field>& v, std::string& out)
     {
-        std::stringstream linestream(entries[i]);
-        int ithread = omp_get_thread_num();
-
         /* MECAT format: cid, rid, score, id, cstr, cstart, cend, clen, rstr, rstart, rend, rlen */
-        std::vector<std::string> v = split (entries[i], '\t');
-
         /* mecat idx to nametag translation */
-        std::string nameV = idx2read (stoi(v[0]), names);
-        std::string nameH = idx2read (stoi(v[1]), names);
-
-        std::string& ident = v[2];
-        std::string& begpV = v[5];
-        std::string& endpV = v[6];
-        std::string& lengV = v[7];
-        std::string& isRev = v[8];
-        std::string& begpH = v[9];
-        std::string& endpH = v[10];
-        std::string& lengH = v[11];
-
-        /* change strand formatting */
-        if(isRev == "0") isRev = "+";         
-            else isRev = "-";
+        field nameV = idx2read (toInt(v[0]), names);
+        field nameH = idx2read (toInt(v[1]), names);
+
+        const field& ident = v[2];
+        const field& begpV = v[5];
+        const field& endpV = v[6];
+        const field& lengV = v[7];
+        const field& isRev = v[8];
+        const field& begpH = v[9];
+        const field& endpH = v[10];
+        const field& lengH = v[11];
 
         /* compute overlap length if missing (begpV, endpV, lenV, begpH, endpH, lenH) */
-        int ovlen = estimate (stoi(begpV), stoi(endpV), stoi(lengV), stoi(begpH), stoi(endpH), stoi(lengH));
+        int ovlen = estimate (toInt(begpV), toInt(endpV), toInt(lengV), toInt(begpH), toInt(endpH), toInt(lengH));
         /* If alignment is missing I estimate it as (ident) *ovlen */
-        int score = floor((stod(ident)*ovlen) / 100);
+        int score = floor((strtod(ident.ptr, NULL)*ovlen) / 100);
 
         /* GGGG: I might need to translate back idx to original names ---> YES, I NEED THE ORIGINAL NAMES. */
-        local[ithread] << nameV << "\t" << lengV << "\t" << begpV << "\t" << endpV << "\t" << isRev 
-            << "\t" << nameH << "\t" << lengH << "\t" << begpH << "\t" << endpH << "\t" << score 
-                << "\t" << ovlen << "\t255" << endl;
-    }
-
-    /* write to a new file */
-    int64_t * bytes = new int64_t[maxt];
-    for(int i = 0; i < maxt; ++i)
-    {
-        local[i].seekg(0, ios::end);
-        bytes[i] = local[i].tellg();
-        local[i].seekg(0, ios::beg);
-    }
-    int64_t bytestotal = std::accumulate(bytes, bytes + maxt, static_cast<int64_t>(0));
-
-    std::ofstream output(filename, std::ios::binary | std::ios::app);
-#ifdef PRINT
-    cout << "Creating or appending to output file with " << (double)bytestotal/(double)(1024 * 1024) << " MB" << endl;
-#endif
-    output.seekp(bytestotal - 1);
-    /* this will likely create a sparse file so the actual disks won't spin yet */
-    output.write("", 1); 
-    output.close();
-
-    #pragma omp parallel
-    {
-        int ithread = omp_get_thread_num(); 
-
-        FILE *ffinal;
-        /* then everyone fills it */
-        if ((ffinal = fopen(filename, "rb+")) == NULL) 
-        {
-            fprintf(stderr, "File %s failed to open at thread %d\n", filename, ithread);
-        }
-        int64_t bytesuntil = std::accumulate(bytes, bytes + ithread, static_cast<int64_t>(0));
-        fseek (ffinal , bytesuntil , SEEK_SET);
-        std::string text = local[ithread].str();
-        fwrite(text.c_str(),1, bytes[ithread], ffinal);
-        fflush(ffinal);
-        fclose(ffinal);
-    }
-    delete [] bytes;
+        column(out, nameV); column(out, lengV); column(out, begpV); column(out, endpV);
+        /* change strand formatting */
+        column(out, (isRev == "0") ? "+" : "-");
+        column(out, nameH); column(out, lengH); column(out, begpH); column(out, endpH); column(out, score);
+        column(out, ovlen); column(out, "255", '\n');
+    });
 }
 
 //=======================================================================
-// 
+//
 // BLASR to PAF
-// 
+//
 //=======================================================================
 
-void BLASR2PAF(ifstream& input, char* filename)
+void BLASR2PAF(const char* input, char* filename)
 {
-    int maxt = 1;
-#pragma omp parallel
-    {
-        maxt = omp_get_num_threads();
-    }
-
-    uint64_t numoverlap = std::count(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>(), '\n');
-    input.seekg(0, std::ios_base::beg);
-
-    vector<std::string> entries;
-    vector<std::stringstream> local(maxt);      
-
-    /* read input file */
-    if(input)
-        for (int i = 0; i < numoverlap; ++i)
-        {
-            std::string line;
-            std::getline(input, line);
-            entries.push_back(line);
-        }
-    input.close();
-
     /* transform BLASR output in PAF format */
-#pragma omp parallel for
-    for(uint64_t i = 0; i < numoverlap; i++) 
+    translate(input, filename, ' ', 13, [](const std::vector<field>& v, std::string& out)
     {
-        int ithread = omp_get_thread_num();
         /* BLASR format: cname, rname, score, id, cstr, cstart, cend, clen, rstr, rstart, rend, rlen, qv */
-        std::vector<std::string> v = split (entries[i], ' ');
         /* improve readability */
-        std::string& nameV = v[0];
-        std::string& nameH = v[1];
-        std::string& score = v[2];
-        std::string& strnV = v[4];
-        std::string& begpV = v[5];
-        std::string& endpV = v[6];
-        std::string& lengV = v[7];
-        std::string& strnH = v[8];
-        std::string& begpH = v[9];
-        std::string& endpH = v[10];
-        std::string& lengH = v[11];
-        std::string& mapQV = v[12];
-
-        /* change strand formatting */
-        std::string isRev;
-        if(strnH == strnV) isRev = "+";         
-            else isRev = "-";
+        const field& nameV = v[0];
+        const field& nameH = v[1];
+        const field& strnV = v[4];
+        const field& begpV = v[5];
+        const field& endpV = v[6];
+        const field& lengV = v[7];
+        const field& strnH = v[8];
+        const field& begpH = v[9];
+        const field& endpH = v[10];
+        const field& lengH = v[11];
+        const field& mapQV = v[12];
 
         // GGGG: BLSR scores are negatives? Dig into this.
-        score.erase(0, 1); 
+        field score = v[2];
+        if(score.len > 0) { score.ptr++; score.len--; }
         /* compute overlap length if missing (begpV, endpV, lenV, begpH, endpH, lenH) */
-        int ovlen = estimate (stoi(begpV), stoi(endpV), stoi(lengV), stoi(begpH), stoi(endpH), stoi(lengH));
-
-        local[ithread] << nameV << "\t" << lengV << "\t" << begpV << "\t" << endpV << "\t" << isRev 
-            << "\t" << nameH << "\t" << lengH << "\t" << begpH << "\t" << endpH << "\t" << score 
-                << "\t" << ovlen << "\t" << mapQV << endl;
-    }
+        int ovlen = estimate (toInt(begpV), toInt(endpV), toInt(lengV), toInt(begpH), toInt(endpH), toInt(lengH));
 
-    /* write to a new file */
-    int64_t * bytes = new int64_t[maxt];
-    for(int i = 0; i < maxt; ++i)
-    {
-        local[i].seekg(0, ios::end);
-        bytes[i] = local[i].tellg();
-        local[i].seekg(0, ios::beg);
-    }
-    int64_t bytestotal = std::accumulate(bytes, bytes + maxt, static_cast<int64_t>(0));
-
-    std::ofstream output(filename, std::ios::binary | std::ios::app);
-#ifdef PRINT
-    cout << "Creating or appending to output file with " << (double)bytestotal/(double)(1024 * 1024) << " MB" << endl;
-#endif
-    output.seekp(bytestotal - 1);
-    /* this will likely create a sparse file so the actual disks won't spin yet */
-    output.write("", 1); 
-    output.close();
-
-    #pragma omp parallel
-    {
-        int ithread = omp_get_thread_num(); 
-
-        FILE *ffinal;
-        /* then everyone fills it */
-        if ((ffinal = fopen(filename, "rb+")) == NULL) 
-        {
-            fprintf(stderr, "File %s failed to open at thread %d\n", filename, ithread);
-        }
-        int64_t bytesuntil = std::accumulate(bytes, bytes + ithread, static_cast<int64_t>(0));
-        fseek (ffinal , bytesuntil , SEEK_SET);
-        std::string text = local[ithread].str();
-        fwrite(text.c_str(),1, bytes[ithread], ffinal);
-        fflush(ffinal);
-        fclose(ffinal);
-    }
-    delete [] bytes;
+        column(out, nameV); column(out, lengV); column(out, begpV); column(out, endpV);
+        /* change strand formatting */
+        column(out, (strnH == strnV) ? "+" : "-");
+        column(out, nameH); column(out, lengH); column(out, begpH); column(out, endpH); column(out, score);
+        column(out, ovlen); column(out, mapQV, '\n');
+    });
 }
 
 //=======================================================================
-// 
+//
 // DALIGNER (translated in BELLA format) to PAF
-// 
+//
 //=======================================================================
 
-void DALIGNER2PAF(ifstream& input, char* filename)
+void DALIGNER2PAF(const char* input, char* filename)
 {
-    int maxt = 1;
-#pragma omp parallel
-    {
-        maxt = omp_get_num_threads();
-    }
-
-    uint64_t numoverlap = std::count(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>(), '\n');
-    input.seekg(0, std::ios_base::beg);
-
-    vector<std::string> entries;
-    vector<std::stringstream> local(maxt);      
-
-    /* read input file */
-    if(input)
-        for (int i = 0; i < numoverlap; ++i)
-        {
-            std::string line;
-            std::getline(input, line);
-            entries.push_back(line);
-        }
-    input.close();
-
     /* transform DALIGNER output in PAF format */
-#pragma omp parallel for
-    for(uint64_t i = 0; i < numoverlap; i++) 
+    translate(input, filename, ' ', 9, [](const std::vector<field>& v, std::string& out)
     {
-        int ithread = omp_get_thread_num();
         /* DALIGNER format: cname, rname, rev, cstart, cend, clen, rstart, rend, rlen */
-        std::vector<std::string> v = split (entries[i], ' ');
         /* improve readability */
-        std::string& nameV = v[0];
-        std::string& nameH = v[1];
-        std::string& isRev = v[2];
-        std::string& begpV = v[3];
-        std::string& endpV = v[4];
-        std::string& lengV = v[5];
-        std::string& begpH = v[6];
-        std::string& endpH = v[7];
-        std::string& lengH = v[8];
-
-        /* change strand formatting */
-        if(isRev == "n") isRev = "+";         
-            else isRev = "-";
+        const field& nameV = v[0];
+        const field& nameH = v[1];
+        const field& isRev = v[2];
+        const field& begpV = v[3];
+        const field& endpV = v[4];
+        const field& lengV = v[5];
+        const field& begpH = v[6];
+        const field& endpH = v[7];
+        const field& lengH = v[8];
 
         /* compute overlap length if missing (begpV, endpV, lenV, begpH, endpH, lenH) */
-        int ovlen = estimate (stoi(begpV), stoi(endpV), stoi(lengV), stoi(begpH), stoi(endpH), stoi(lengH));
+        int ovlen = estimate (toInt(begpV), toInt(endpV), toInt(lengV), toInt(begpH), toInt(endpH), toInt(lengH));
 
         /* GGGG: If alignment is missing I estimate it as % of the overlap length and I determine that % using the error rate */
         // GGGG: Error rate is now hard-coded, need to be an input parameter
@@ -607,46 +457,10 @@ void DALIGNER2PAF(ifstream& input, char* filename)
         float identity = (1-error)*(1-error);
         int score = floor(identity*ovlen);
 
-        local[ithread] << nameV << "\t" << lengV << "\t" << begpV << "\t" << endpV << "\t" << isRev 
-            << "\t" << nameH << "\t" << lengH << "\t" << begpH << "\t" << endpH << "\t" << score 
-                << "\t" << ovlen << "\t255" << endl;
-    }
-
-    /* write to a new file */
-    int64_t * bytes = new int64_t[maxt];
-    for(int i = 0; i < maxt; ++i)
-    {
-        local[i].seekg(0, ios::end);
-        bytes[i] = local[i].tellg();
-        local[i].seekg(0, ios::beg);
-    }
-    int64_t bytestotal = std::accumulate(bytes, bytes + maxt, static_cast<int64_t>(0));
-
-    std::ofstream output(filename, std::ios::binary | std::ios::app);
-#ifdef PRINT
-    cout << "Creating or appending to output file with " << (double)bytestotal/(double)(1024 * 1024) << " MB" << endl;
-#endif
-    output.seekp(bytestotal - 1);
-    /* this will likely create a sparse file so the actual disks won't spin yet */
-    output.write("", 1); 
-    output.close();
-
-    #pragma omp parallel
-    {
-        int ithread = omp_get_thread_num(); 
-
-        FILE *ffinal;
-        /* then everyone fills it */
-        if ((ffinal = fopen(filename, "rb+")) == NULL) 
-        {
-            fprintf(stderr, "File %s failed to open at thread %d\n", filename, ithread);
-        }
-        int64_t bytesuntil = std::accumulate(bytes, bytes + ithread, static_cast<int64_t>(0));
-        fseek (ffinal , bytesuntil , SEEK_SET);
-        std::string text = local[ithread].str();
-        fwrite(text.c_str(),1, bytes[ithread], ffinal);
-        fflush(ffinal);
-        fclose(ffinal);
-    }
-    delete [] bytes;
+        column(out, nameV); column(out, lengV); column(out, begpV); column(out, endpV);
+        /* change strand formatting */
+        column(out, (isRev == "n") ? "+" : "-");
+        column(out, nameH); column(out, lengH); column(out, begpH); column(out, endpH); column(out, score);
+        column(out, ovlen); column(out, "255", '\n');
+    });
 }
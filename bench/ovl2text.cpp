@@ -0,0 +1,143 @@
+//=======================================================================
+// Title:  C++ program to convert BELLA's binary overlaps (-B) in PAF or BELLA format
+// Date:   19 Oct 2026
+//=======================================================================
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "../optlist/optlist.h" /* command line parser */
+#ifdef __cplusplus
+}
+#endif
+
+#include "../mtspgemm2017/overlapformat.h"
+#include <omp.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <string.h>
+
+using namespace std;
+
+#define RECORDSPERCHUNK (1 << 16)
+
+int main (int argc, char* argv[]) {
+
+    /* program description, messages go to stderr as the output may be stdout */
+    cerr << "\nProgram to convert BELLA's binary overlaps in PAF or BELLA format" << endl;
+    /* input files setup */
+    option_t *optList, *thisOpt;
+    /* list of command line options and their arguments */
+    optList = NULL;
+    optList = GetOptList(argc, argv, (char*)"i:f:ph");
+
+    char *input = NULL;     // binary overlaps
+    char *filename = NULL;  // filename translated output
+    bool paf = false;
+
+    if(optList == NULL)
+    {
+        cerr << "Program execution terminated: not enough parameters or invalid option" << endl;
+        cerr << "Run with -h to print out the command line options" << endl;
+        return 0;
+    }
+
+    while (optList!=NULL)
+    {
+        thisOpt = optList;
+        optList = optList->next;
+        switch (thisOpt->option)
+        {
+            case 'i': {
+                input = strdup(thisOpt->argument);
+                break;
+            }
+            case 'f': {
+                filename = strdup(thisOpt->argument);
+                break;
+            }
+            case 'p': {
+                paf = true;
+                break;
+            }
+            case 'h': {
+                cerr << "\nUsage:\n" << endl;
+                cerr << " -i : BELLA binary output (-B)" << endl;
+                cerr << " -f : filename [stdout]" << endl;
+                cerr << " -p : PAF format [BELLA format]" << endl;
+                cerr << " -h : usage\n" << endl;
+                /* done with this list, free it */
+                FreeOptList(thisOpt);
+                return 0;
+            }
+        }
+    }
+
+    free(optList);
+    free(thisOpt);
+
+    if(input == NULL)
+    {
+        cerr << "Binary input file is missing" << endl;
+        return 0;
+    }
+
+    OverlapReader reader;
+    if(!reader.open(input))
+        return 1;
+
+    FILE *output = (filename != NULL) ? fopen(filename, "wb") : stdout;
+    if(output == NULL)
+    {
+        fprintf(stderr, "File %s failed to open\n", filename);
+        return 1;
+    }
+
+    int maxt = 1;
+#pragma omp parallel
+    {
+        maxt = omp_get_num_threads();
+    }
+
+    /* stream the records: each chunk is formatted in parallel and written in order */
+    vector<ovlRecord_> records(RECORDSPERCHUNK);
+    vector<std::string> local(maxt);
+    uint64_t numoverlap = 0;
+    size_t numrecords;
+
+    while((numrecords = reader.next(records.data(), RECORDSPERCHUNK)) > 0)
+    {
+    #pragma omp parallel
+        {
+            int ithread = omp_get_thread_num();
+            size_t beg = numrecords * ithread / maxt;
+            size_t end = numrecords * (ithread + 1) / maxt;
+
+            local[ithread].clear();
+            for(size_t i = beg; i < end; ++i)
+            {
+                if(paf) formatPAF(records[i], reader, local[ithread]);
+                else formatBELLA(records[i], reader, local[ithread]);
+            }
+        }
+
+        for(int t = 0; t < maxt; ++t)
+        {
+            if(fwrite(local[t].data(), 1, local[t].size(), output) != local[t].size())
+            {
+                fprintf(stderr, "Writing the output failed\n");
+                return 1;
+            }
+        }
+        numoverlap += numrecords;
+    }
+
+    if(output != stdout)
+        fclose(output);
+    cerr << "Converted " << numoverlap << " overlaps between " << reader.numreads() << " reads" << endl;
+
+    return 0;
+}
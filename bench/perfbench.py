@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+"""
+Performance benchmark of BELLA on simulated reads, offline and reproducible.
+
+For every scale (reference length) the reads are simulated once with ./simulate (fixed seed) and cached in the work
+directory; BELLA then runs with each thread count and writes its JSON report (-j). The evaluator (./result) scores the
+overlaps against the simulated ground truth. One record per (scale, threads) goes to the results file:
+
+    kmers_per_s   k-mers parsed per second of "k-mer counting"
+    flops_per_s   SpGEMM flops per second of the "spgemm" phases
+    pairs_per_s   pairs aligned per second of the "alignment" phases
+    gcups         giga DP cells per second of the alignment
+    peak_rss_mb   high-water mark of the run
+    recall, precision (%) from the evaluator
+
+With --baseline, records with the same scale and threads are compared to an earlier results file: throughputs lower
+than (1 - tolerance) times the baseline, a peak RSS or total time above (1 + tolerance) times it, or recall/precision
+more than --accuracy points below it are regressions, and the exit status is 1.
+
+    cd bench && make simulate result && python3 perfbench.py --scales 20000,80000 --threads 1,4 --out new.json
+    python3 perfbench.py --scales 20000,80000 --threads 1,4 --out new.json --baseline old.json
+"""
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+import time
+
+HIGHER_IS_BETTER = ["kmers_per_s", "flops_per_s", "pairs_per_s", "gcups"]
+LOWER_IS_BETTER = ["peak_rss_mb", "total_s"]
+ACCURACY = ["recall", "precision"]
+
+
+def run(cmd, log, env=None):
+    with open(log, "w") as out:
+        status = subprocess.call(cmd, stdout=out, stderr=subprocess.STDOUT, env=env)
+    if status != 0:
+        sys.exit("Command failed with status %d, see %s: %s" % (status, log, " ".join(cmd)))
+
+
+def simulate(args, scale):
+    prefix = os.path.join(args.workdir, "sim_%d_%gx_e%g_l%d_sd%d_s%d" % (scale, args.coverage, args.error, args.length,
+                                                                          args.sd, args.seed))
+    if args.repeat:
+        prefix += "_r%s" % args.repeat.replace(",", "x")
+    fastq, truth = prefix + ".fastq", prefix + ".truth.txt"
+    if not (os.path.exists(fastq) and os.path.exists(truth)):
+        cmd = [args.simulate, "-o", prefix, "-g", str(scale), "-x", str(args.coverage), "-e", str(args.error),
+               "-l", str(args.length), "-s", str(args.sd), "-S", str(args.seed)]
+        if args.repeat:
+            replen, copies = args.repeat.split(",")
+            cmd += ["-R", replen, "-c", copies]
+        run(cmd, prefix + ".log")
+    listing = prefix + ".in.txt"
+    with open(listing, "w") as f:
+        f.write(os.path.abspath(fastq) + "\n")
+    return listing, truth
+
+
+def kmer_length(extra):
+    for i, a in enumerate(extra):
+        if a == "-k" and i + 1 < len(extra):
+            return int(extra[i + 1])
+    return 17
+
+
+def summarize(report, k):
+    metrics = report["metrics"]
+    phases = report["phases"]
+
+    def wall(name):
+        return sum(p["wall_s"] for p in phases if p["name"] == name)
+
+    kmers = metrics.get("bases", 0) - metrics.get("reads", 0) * (k - 1)
+    pairs = sum(s.get("pairs_aligned", 0) for s in report["stages"])
+    counting, spgemm, alignment = wall("k-mer counting"), wall("spgemm"), wall("alignment")
+    return {
+        "reads": metrics.get("reads"),
+        "bases": metrics.get("bases"),
+        "total_s": metrics.get("total_s"),
+        "kmers_per_s": kmers / counting if counting > 0 else None,
+        "flops_per_s": metrics.get("flops", 0) / spgemm if spgemm > 0 else None,
+        "pairs_per_s": pairs / alignment if alignment > 0 else None,
+        "gcups": metrics.get("gcups"),
+        "peak_rss_mb": max([p["peak_rss_mb"] for p in phases] or [0]),
+        "phases": {p["name"]: p["wall_s"] for p in phases if p["depth"] == 0},
+    }
+
+
+def evaluate(args, truth, overlaps, log):
+    run([args.result, "-G", truth, "-B", overlaps], log)
+    text = open(log).read()
+    recall = re.search(r"Recall\s+([0-9.]+)%", text)
+    precision = re.search(r"Precision\s+([0-9.]+)%", text)
+    return (float(recall.group(1)) if recall else None, float(precision.group(1)) if precision else None)
+
+
+def compare(records, baseline, tolerance, accuracy):
+    old = {(r["scale"], r["coverage"], r["threads"]): r for r in baseline}
+    regressions = []
+    for r in records:
+        b = old.get((r["scale"], r["coverage"], r["threads"]))
+        if b is None:
+            continue
+        where = "scale %d, %d threads" % (r["scale"], r["threads"])
+        for m in HIGHER_IS_BETTER:
+            if r.get(m) is not None and b.get(m) and r[m] < (1 - tolerance) * b[m]:
+                regressions.append("%s: %s %.4g < %.4g" % (where, m, r[m], b[m]))
+        for m in LOWER_IS_BETTER:
+            if r.get(m) is not None and b.get(m) and r[m] > (1 + tolerance) * b[m]:
+                regressions.append("%s: %s %.4g > %.4g" % (where, m, r[m], b[m]))
+        for m in ACCURACY:
+            if r.get(m) is not None and b.get(m) is not None and r[m] < b[m] - accuracy:
+                regressions.append("%s: %s %.2f%% < %.2f%%" % (where, m, r[m], b[m]))
+    return regressions
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description="BELLA performance benchmark on simulated reads")
+    parser.add_argument("--bella", default=os.path.join(here, "..", "bella"))
+    parser.add_argument("--simulate", default=os.path.join(here, "simulate"))
+    parser.add_argument("--result", default=os.path.join(here, "result"))
+    parser.add_argument("--scales", default="20000,80000", help="comma-separated reference lengths [20000,80000]")
+    parser.add_argument("--threads", default="1", help="comma-separated thread counts [1]")
+    parser.add_argument("--coverage", type=float, default=10)
+    parser.add_argument("--error", type=float, default=0.15)
+    parser.add_argument("--length", type=int, default=5000, help="mean read length [5000]")
+    parser.add_argument("--sd", type=int, default=2000, help="read length standard deviation [2000]")
+    parser.add_argument("--repeat", default="", help="repeat unit length and copies, e.g. 5000,10 [none]")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--runs", type=int, default=1, help="runs per configuration, the fastest is kept [1]")
+    parser.add_argument("--bella-args", default="", help="extra BELLA options, e.g. \"-k 15 -b 32,0\"")
+    parser.add_argument("--workdir", default="perfbench_work")
+    parser.add_argument("--out", default="perfbench.json")
+    parser.add_argument("--baseline", default=None, help="earlier results file to compare with")
+    parser.add_argument("--tolerance", type=float, default=0.10, help="relative slowdown accepted [0.10]")
+    parser.add_argument("--accuracy", type=float, default=1.0, help="recall/precision points accepted [1.0]")
+    args = parser.parse_args()
+
+    for tool in (args.bella, args.simulate, args.result):
+        if not os.path.exists(tool):
+            sys.exit("%s not found, build it first (make bella; cd bench && make simulate result)" % tool)
+    os.makedirs(args.workdir, exist_ok=True)
+    extra = args.bella_args.split()
+    k = kmer_length(extra)
+
+    records = []
+    for scale in [int(s) for s in args.scales.split(",")]:
+        listing, truth = simulate(args, scale)
+        for threads in [int(t) for t in args.threads.split(",")]:
+            name = os.path.join(args.workdir, "bella_%d_%dt" % (scale, threads))
+            env = dict(os.environ, OMP_NUM_THREADS=str(threads))
+            best = None
+            for _ in range(args.runs):
+                start = time.time()
+                run([args.bella, "-i", listing, "-o", name, "-d", "%g" % args.coverage, "-j", name + ".json"] + extra,
+                    name + ".log", env)
+                elapsed = time.time() - start
+                if best is None or elapsed < best[0]:
+                    best = (elapsed, json.load(open(name + ".json")))
+            record = {"scale": scale, "coverage": args.coverage, "threads": threads, "wall_s": best[0]}
+            record.update(summarize(best[1], k))
+            record["recall"], record["precision"] = evaluate(args, truth, name + ".out", name + ".eval.log")
+            records.append(record)
+
+            print("scale %9d  threads %3d  total %8.2fs  k-mers/s %.3g  flops/s %.3g  pairs/s %.3g  GCUPS %.3g  "
+                  "RSS %.0fMB  recall %s%%  precision %s%%" % (scale, threads, record["total_s"] or 0,
+                  record["kmers_per_s"] or 0, record["flops_per_s"] or 0, record["pairs_per_s"] or 0,
+                  record["gcups"] or 0, record["peak_rss_mb"], record["recall"], record["precision"]))
+            sys.stdout.flush()
+
+    with open(args.out, "w") as f:
+        json.dump({"bella": os.path.abspath(args.bella), "bella_args": args.bella_args, "records": records}, f, indent=2)
+    print("Results written to %s" % args.out)
+
+    if args.baseline:
+        regressions = compare(records, json.load(open(args.baseline))["records"], args.tolerance, args.accuracy)
+        for r in regressions:
+            print("REGRESSION " + r)
+        if regressions:
+            sys.exit(1)
+        print("No regression against %s" % args.baseline)
+
+
+if __name__ == "__main__":
+    main()
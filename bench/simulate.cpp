@@ -0,0 +1,326 @@
+//=======================================================================
+// Title:  C++ program to simulate noisy long reads and their ground truth
+// Date:   19 Oct 2026
+//=======================================================================
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "../optlist/optlist.h" /* command line parser */
+#ifdef __cplusplus
+}
+#endif
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <stdint.h>
+#include <string.h>
+
+using namespace std;
+
+/* the same seed gives the same reference, reads and ground truth, so runs of different builds can be compared */
+typedef std::mt19937_64 generator_t;
+
+static const char bases[] = "ACGT";
+
+struct contig {
+    string name;
+    string seq;
+};
+
+/* random reference, with copies of a repeat unit diverging by <divergence> substitutions per base */
+contig randomReference(uint64_t length, uint64_t replen, int copies, double divergence, generator_t& gen)
+{
+    std::uniform_int_distribution<int> base(0, 3);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    contig ref;
+    ref.name = "ref0";
+    ref.seq.resize(length);
+    for(uint64_t i = 0; i < length; ++i)
+        ref.seq[i] = bases[base(gen)];
+
+    if(replen > 0 && replen < length)
+    {
+        string repeat(replen, 'A');
+        for(uint64_t i = 0; i < replen; ++i)
+            repeat[i] = bases[base(gen)];
+
+        std::uniform_int_distribution<uint64_t> where(0, length - replen);
+        for(int c = 0; c < copies; ++c)
+        {
+            uint64_t at = where(gen);
+            for(uint64_t i = 0; i < replen; ++i)
+            {
+                char b = repeat[i];
+                if(unit(gen) < divergence)
+                    b = bases[(strchr(bases, b) - bases + 1 + base(gen) % 3) % 4];
+                ref.seq[at + i] = b;
+            }
+        }
+    }
+    return ref;
+}
+
+/* contigs of a fasta file, named by the first word of their header; other characters than ACGT become random bases */
+vector<contig> readReference(const char* filename, generator_t& gen)
+{
+    std::uniform_int_distribution<int> base(0, 3);
+    vector<contig> refs;
+    ifstream fasta(filename);
+    if(!fasta.is_open())
+    {
+        cerr << "Reference " << filename << " failed to open" << endl;
+        exit(1);
+    }
+
+    string line;
+    while(getline(fasta, line))
+    {
+        if(line.empty()) continue;
+        if(line[0] == '>')
+        {
+            contig c;
+            c.name = line.substr(1, line.find_first_of(" \t") - 1);
+            refs.push_back(c);
+        }
+        else if(!refs.empty())
+        {
+            for(char b : line)
+            {
+                b = toupper(b);
+                if(b != 'A' && b != 'C' && b != 'G' && b != 'T') b = bases[base(gen)];
+                refs.back().seq.push_back(b);
+            }
+        }
+    }
+    return refs;
+}
+
+string reverseComplement(const string& seq)
+{
+    string rc(seq.rbegin(), seq.rend());
+    for(char& b : rc)
+    {
+        switch(b)
+        {
+            case 'A': b = 'T'; break;
+            case 'C': b = 'G'; break;
+            case 'G': b = 'C'; break;
+            case 'T': b = 'A'; break;
+        }
+    }
+    return rc;
+}
+
+int main (int argc, char* argv[]) {
+
+    cout << "\nProgram to simulate noisy long reads and their ground truth" << endl;
+    option_t *optList, *thisOpt;
+    optList = NULL;
+    optList = GetOptList(argc, argv, (char*)"o:f:g:R:c:v:x:l:s:m:e:p:S:h");
+
+    char *prefix = NULL;        // output prefix
+    char *fasta = NULL;         // reference, random if missing
+    uint64_t length = 1000000;  // random reference length
+    uint64_t replen = 0;        // repeat unit length, 0 for no repeats
+    int copies = 10;
+    double divergence = 0.01;
+    double coverage = 30;
+    double meanlen = 10000;
+    double sdlen = 5000;
+    uint64_t minlen = 1000;
+    double error = 0.15;
+    double profile[3] = {0.2, 0.5, 0.3};    // substitutions, insertions, deletions
+    uint64_t seed = 1;
+
+    if(optList == NULL)
+    {
+        cout << "Program execution terminated: not enough parameters or invalid option" << endl;
+        cout << "Run with -h to print out the command line options" << endl;
+        return 0;
+    }
+
+    while (optList!=NULL)
+    {
+        thisOpt = optList;
+        optList = optList->next;
+        switch (thisOpt->option)
+        {
+            case 'o': {
+                prefix = strdup(thisOpt->argument);
+                break;
+            }
+            case 'f': {
+                fasta = strdup(thisOpt->argument);
+                break;
+            }
+            case 'g': {
+                length = strtoull(thisOpt->argument, NULL, 10);
+                break;
+            }
+            case 'R': {
+                replen = strtoull(thisOpt->argument, NULL, 10);
+                break;
+            }
+            case 'c': {
+                copies = atoi(thisOpt->argument);
+                break;
+            }
+            case 'v': {
+                divergence = atof(thisOpt->argument);
+                break;
+            }
+            case 'x': {
+                coverage = atof(thisOpt->argument);
+                break;
+            }
+            case 'l': {
+                meanlen = atof(thisOpt->argument);
+                break;
+            }
+            case 's': {
+                sdlen = atof(thisOpt->argument);
+                break;
+            }
+            case 'm': {
+                minlen = strtoull(thisOpt->argument, NULL, 10);
+                break;
+            }
+            case 'e': {
+                error = atof(thisOpt->argument);
+                break;
+            }
+            case 'p': {
+                if(sscanf(thisOpt->argument, "%lf,%lf,%lf", &profile[0], &profile[1], &profile[2]) != 3)
+                {
+                    cout << "-p requires three comma-separated fractions: substitutions,insertions,deletions" << endl;
+                    return 0;
+                }
+                break;
+            }
+            case 'S': {
+                seed = strtoull(thisOpt->argument, NULL, 10);
+                break;
+            }
+            case 'h': {
+                cout << "\nUsage:\n" << endl;
+                cout << " -o : output prefix, writes <prefix>.fastq and <prefix>.truth.txt (required)" << endl;
+                cout << " -f : reference fasta [random reference]" << endl;
+                cout << " -g : random reference length [1000000]" << endl;
+                cout << " -R : repeat unit length, 0 for no repeats [0]" << endl;
+                cout << " -c : repeat copies [10]" << endl;
+                cout << " -v : repeat divergence, substitutions per base [0.01]" << endl;
+                cout << " -x : coverage [30]" << endl;
+                cout << " -l : mean read length [10000]" << endl;
+                cout << " -s : read length standard deviation, log-normal lengths [5000]" << endl;
+                cout << " -m : minimum read length [1000]" << endl;
+                cout << " -e : error rate per base [0.15]" << endl;
+                cout << " -p : error profile, substitutions,insertions,deletions [0.2,0.5,0.3]" << endl;
+                cout << " -S : random seed [1]" << endl;
+                cout << " -h : usage\n" << endl;
+                FreeOptList(thisOpt);
+                return 0;
+            }
+        }
+    }
+
+    free(optList);
+    free(thisOpt);
+
+    if(prefix == NULL)
+    {
+        cout << "Output prefix is missing, add it with -o" << endl;
+        return 0;
+    }
+
+    generator_t gen(seed);
+    vector<contig> refs;
+    if(fasta != NULL) refs = readReference(fasta, gen);
+    else refs.push_back(randomReference(length, replen, copies, divergence, gen));
+
+    uint64_t total = 0;
+    vector<double> weights;
+    for(const contig& c : refs)
+    {
+        total += c.seq.size();
+        weights.push_back(c.seq.size());
+    }
+    if(total == 0)
+    {
+        cout << "The reference is empty" << endl;
+        return 0;
+    }
+
+    /* log-normal read lengths with the requested mean and standard deviation */
+    double sigma2 = log(1.0 + (sdlen * sdlen) / (meanlen * meanlen));
+    std::lognormal_distribution<double> readlength(log(meanlen) - sigma2 / 2, sqrt(sigma2));
+    std::discrete_distribution<int> pickcontig(weights.begin(), weights.end());
+    std::discrete_distribution<int> pickerror(profile, profile + 3);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::uniform_int_distribution<int> base(0, 3);
+
+    /* every base has the same quality, so BELLA estimates the simulated error rate */
+    int phred = (error > 0) ? (int)std::round(-10 * log10(error)) : 40;
+    phred = std::min(std::max(phred, 0), 93);
+
+    string fastqname = string(prefix) + ".fastq";
+    string truthname = string(prefix) + ".truth.txt";
+    ofstream fastq(fastqname.c_str());
+    ofstream truth(truthname.c_str());
+    if(!fastq.is_open() || !truth.is_open())
+    {
+        cout << "Output files " << prefix << ".* failed to open" << endl;
+        return 0;
+    }
+
+    uint64_t bases_out = 0, nreads = 0;
+    uint64_t target = (uint64_t)(coverage * total);
+    string read, qual;
+
+    while(bases_out < target)
+    {
+        const contig& ref = refs[pickcontig(gen)];
+        uint64_t len = std::max(minlen, (uint64_t)readlength(gen));
+        len = std::min(len, (uint64_t)ref.seq.size());
+
+        std::uniform_int_distribution<uint64_t> where(0, ref.seq.size() - len);
+        uint64_t start = where(gen);
+        string source = ref.seq.substr(start, len);
+        if(unit(gen) < 0.5) source = reverseComplement(source);
+
+        read.clear();
+        for(char b : source)
+        {
+            if(unit(gen) >= error)
+            {
+                read.push_back(b);
+                continue;
+            }
+            switch(pickerror(gen))
+            {
+                case 0: read.push_back(bases[(strchr(bases, b) - bases + 1 + base(gen) % 3) % 4]); break;
+                case 1: read.push_back(bases[base(gen)]); read.push_back(b); break;
+                case 2: break;
+            }
+        }
+        if(read.empty()) continue;
+        qual.assign(read.size(), (char)(33 + phred));
+
+        /* ground truth as produced by SAMparser.py: reference, read, start, end on the forward strand */
+        fastq << "@sim_" << nreads << "\n" << read << "\n+\n" << qual << "\n";
+        truth << ref.name << " sim_" << nreads << " " << start << " " << start + len << "\n";
+        bases_out += read.size();
+        ++nreads;
+    }
+
+    cout << nreads << " reads, " << bases_out << " bases (" << (double)bases_out / total << "x) from " << total << " reference bases" << endl;
+    cout << "Reads written to " << fastqname << ", ground truth to " << truthname << endl;
+    return 0;
+}
@@ -0,0 +1,186 @@
+#ifndef BELLA_DISTKMERCOUNT_H_
+#define BELLA_DISTKMERCOUNT_H_
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <tuple>
+#include <math.h>
+#include <stdint.h>
+#include <mpi.h>
+#include <omp.h>
+
+#include "kmercount.h"
+
+// include after mtspgemm2017/distributed.h
+
+/* k-mer occurrence sent to the owner of its k-mer */
+struct kmerOccurrence_ {
+    Kmer::MERARR kmer;  // canonical k-mer (rep)
+    uint64_t read;      // global read id
+    int32_t pos;        // k-mer position on the read
+    int32_t pad;
+};
+
+/* nonzero of A or A^T, global ids */
+struct matrixTriple_ {
+    uint64_t row;
+    uint64_t col;
+    uint64_t pos;
+};
+
+/**
+ * @brief DistributedParse reads this process's share of every fastq (a byte range, as the threads of DeNovoCount do)
+ * and numbers the reads in file order, so every read keeps the id it has in a single-process run
+ * @param errorsum sum of the mean base error of the parsed reads (phred qualities), unless the error rate is given
+ */
+void DistributedParse(vector<filedata> & allfiles, readVector_ & reads, double & errorsum, size_t upperlimit, const BELLApars & b_parameters,
+    const procGrid_ & grid)
+{
+    ScopedPhase phase("fastq parsing");
+    vector<string> seqs;
+    vector<string> quals;
+    vector<string> nametags;
+    uint64_t filesofar = 0;     // reads of the previous files
+    errorsum = 0;
+
+    for(auto itr=allfiles.begin(); itr!=allfiles.end(); itr++)
+    {
+        ParallelFASTQ *pfq = new ParallelFASTQ();
+        pfq->openPart(itr->filename, grid.rank, grid.nprocs);
+        size_t first = reads.size();
+
+        size_t fillstatus = 1;
+        while(fillstatus)
+        {
+            fillstatus = pfq->fill_block(nametags, seqs, quals, upperlimit);
+            for(size_t i = 0; i < seqs.size(); ++i)
+            {
+                readType_ temp;
+                temp.nametag = nametags[i].substr(1);  // removing "@"
+                temp.seq = seqs[i];
+                reads.push_back(temp);
+
+                if(!b_parameters.skipEstimate)
+                {
+                    double rerror = 0.0;
+                    for(size_t j = 0; j < quals[i].length(); ++j)
+                        rerror += pow(10, -(double)((int)quals[i][j] - ASCIIBASE)/10);
+                    errorsum += rerror / quals[i].length();
+                }
+            }
+        }
+        delete pfq;
+
+        // the byte ranges follow the rank order, and so do the read ids
+        uint64_t mine = reads.size() - first, before = 0, infile = 0;
+        MPI_Exscan(&mine, &before, 1, MPIType<uint64_t>(), MPI_SUM, MPI_COMM_WORLD);
+        MPI_Allreduce(&mine, &infile, 1, MPIType<uint64_t>(), MPI_SUM, MPI_COMM_WORLD);
+        if(grid.rank == 0) before = 0;  // MPI_Exscan leaves it undefined
+        for(size_t i = first; i < reads.size(); ++i)
+            reads[i].readid = filesofar + before + (i - first);
+        filesofar += infile;
+    }
+}
+
+/**
+ * @brief DistributedCount counts the k-mers with a distributed hash table: every occurrence goes to the process owning
+ * its k-mer (hash modulo the number of processes), which counts its k-mers, numbers the reliable ones and turns their
+ * occurrences into the nonzeros of A and A^T, sent to the owners of their blocks
+ * @param occurrences nonzeros of block (myrow, mycol) of A, local ids: <read, k-mer, position>
+ * @param transtuples nonzeros of block (myrow, mycol) of A^T, local ids: <k-mer, read, position>
+ * @param kmerbounds set to the k-mer ranges of the grid
+ * @return the number of reliable k-mers
+ */
+uint64_t DistributedCount(const readVector_ & reads, int kmer_len, int lower, int upper, const procGrid_ & grid,
+    const vector<uint64_t> & readbounds, vector<uint64_t> & kmerbounds,
+    vector<tuple<size_t,size_t,size_t>> & occurrences, vector<tuple<size_t,size_t,size_t>> & transtuples)
+{
+    ScopedPhase phase("k-mer counting");
+    double counting = omp_get_wtime();
+
+    vector< vector< vector<kmerOccurrence_> > > threadbufs(MAXTHREADS, vector< vector<kmerOccurrence_> >(grid.nprocs));
+#pragma omp parallel for schedule(dynamic)
+    for(size_t i = 0; i < reads.size(); ++i)
+    {
+        int len = reads[i].seq.length();
+        for(int j = 0; j <= len-kmer_len; ++j)
+        {
+            Kmer mykmer(reads[i].seq.substr(j, kmer_len).c_str());
+            Kmer lexsmall = mykmer.rep();
+            kmerOccurrence_ occ;
+            occ.kmer = lexsmall.getArray();
+            occ.read = reads[i].readid;
+            occ.pos = j;
+            occ.pad = 0;
+            threadbufs[MYTHREAD][lexsmall.hash() % grid.nprocs].push_back(occ);
+        }
+    }
+    vector< vector<kmerOccurrence_> > sendbufs(grid.nprocs);
+    for(int p = 0; p < grid.nprocs; ++p)
+    {
+        for(int t = 0; t < MAXTHREADS; ++t)
+        {
+            sendbufs[p].insert(sendbufs[p].end(), threadbufs[t][p].begin(), threadbufs[t][p].end());
+            vector<kmerOccurrence_>().swap(threadbufs[t][p]);
+        }
+    }
+    vector<kmerOccurrence_> mykmers = exchange(sendbufs, MPI_COMM_WORLD);
+
+    // the occurrences of a k-mer are adjacent once sorted, their number is its count
+    std::sort(mykmers.begin(), mykmers.end(), [](const kmerOccurrence_ & a, const kmerOccurrence_ & b)
+    {
+        if(a.kmer != b.kmer) return a.kmer < b.kmer;
+        return (a.read != b.read) ? (a.read < b.read) : (a.pos < b.pos);
+    });
+    vector<size_t> runs;    // first occurrence of every reliable k-mer, then the end of the last one
+    for(size_t i = 0, j; i < mykmers.size(); i = j)
+    {
+        for(j = i+1; j < mykmers.size() && mykmers[j].kmer == mykmers[i].kmer; ++j);
+        if(j-i >= (size_t)lower && j-i <= (size_t)upper)
+        {
+            runs.push_back(i);
+            runs.push_back(j);
+        }
+    }
+
+    uint64_t myreliable = runs.size()/2, firstid = 0, nkmers = 0;
+    MPI_Exscan(&myreliable, &firstid, 1, MPIType<uint64_t>(), MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(&myreliable, &nkmers, 1, MPIType<uint64_t>(), MPI_SUM, MPI_COMM_WORLD);
+    if(grid.rank == 0) firstid = 0;
+    kmerbounds = blockBounds(nkmers, grid.dim);
+
+    vector< vector<matrixTriple_> > tosendA(grid.nprocs), tosendAT(grid.nprocs);
+    for(uint64_t r = 0; r < myreliable; ++r)
+    {
+        uint64_t kmerid = firstid + r;
+        int kblock = blockOf(kmerbounds, kmerid);
+        for(size_t i = runs[2*r]; i < runs[2*r+1]; ++i)
+        {
+            int rblock = blockOf(readbounds, mykmers[i].read);
+            tosendA[grid.owner(rblock, kblock)].push_back({ mykmers[i].read, kmerid, (uint64_t)mykmers[i].pos });
+            tosendAT[grid.owner(kblock, rblock)].push_back({ kmerid, mykmers[i].read, (uint64_t)mykmers[i].pos });
+        }
+    }
+    vector<kmerOccurrence_>().swap(mykmers);
+
+    vector<matrixTriple_> myA = exchange(tosendA, MPI_COMM_WORLD);
+    occurrences.resize(myA.size());
+    for(size_t i = 0; i < myA.size(); ++i)
+        occurrences[i] = make_tuple(myA[i].row - readbounds[grid.myrow], myA[i].col - kmerbounds[grid.mycol], myA[i].pos);
+    vector<matrixTriple_>().swap(myA);
+
+    vector<matrixTriple_> myAT = exchange(tosendAT, MPI_COMM_WORLD);
+    transtuples.resize(myAT.size());
+    for(size_t i = 0; i < myAT.size(); ++i)
+        transtuples[i] = make_tuple(myAT[i].row - kmerbounds[grid.myrow], myAT[i].col - readbounds[grid.mycol], myAT[i].pos);
+
+    if(grid.rank == 0)
+        cout << "Distributed k-mer counting and matrix distribution took: " << omp_get_wtime() - counting << "s" << endl;
+    return nkmers;
+}
+
+#endif
@@ -0,0 +1,561 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <istream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <algorithm>
+#include <utility>
+#include <array>
+#include <tuple>
+#include <queue>
+#include <memory>
+#include <stack>
+#include <functional>
+#include <cstring>
+#include <string.h>
+#include <math.h>
+#include <cassert>
+#include <ios>
+#include <random>
+#include <limits>
+#include <numeric>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/sysctl.h>
+#include <map>
+#include <unordered_map>
+#include <omp.h>
+
+#include "libcuckoo/cuckoohash_map.hh"
+#include "kmercount.h"
+
+#include "kmercode/hash_funcs.h"
+#include "kmercode/Kmer.hpp"
+#include "kmercode/Buffer.h"
+#include "kmercode/common.h"
+#include "kmercode/fq_reader.h"
+#include "kmercode/ParallelFASTQ.h"
+#include "kmercode/bound.hpp"
+
+#include "mtspgemm2017/utility.h"
+#include "mtspgemm2017/CSC.h"
+#include "mtspgemm2017/CSR.h"
+#include "mtspgemm2017/common.h"
+#include "mtspgemm2017/IO.h"
+#include "mtspgemm2017/overlapping.h"
+#include "mtspgemm2017/align.h"
+#include "mtspgemm2017/synthetic.h"
+
+using namespace std;
+
+//
+// bella-kernels: microbenchmarks of the inner kernels of BELLA on synthetic inputs
+// Every kernel runs once to warm up, then back to back until it takes at least -m seconds; the fastest of -r such
+// repetitions is kept. bytes/op counts what a kernel reads and writes from its inputs and outputs, not cache traffic
+//
+
+struct kernelResult_ {
+    string kernel;
+    int threads;
+    double ops;         // operations of one call
+    double seconds;     // one call, best repetition
+    double bytes;       // bytes read and written by one call
+};
+
+struct benchPars_ {
+    double mintime = 0.5;   // seconds per repetition (m)
+    int reps = 3;           // repetitions, the fastest is kept (r)
+};
+
+typedef std::mt19937_64 generator_t;
+
+template <typename Kernel>
+double timeKernel(Kernel kernel, const benchPars_ & pars)
+{
+    kernel();   // warm-up: page faults, lazy allocations and table growth are not measured
+    double best = std::numeric_limits<double>::max();
+    for(int r = 0; r < pars.reps; ++r)
+    {
+        int calls = 0;
+        double start = omp_get_wtime();
+        double elapsed;
+        do
+        {
+            kernel();
+            ++calls;
+            elapsed = omp_get_wtime() - start;
+        } while(elapsed < pars.mintime);
+        best = std::min(best, elapsed / calls);
+    }
+    return best;
+}
+
+string randomSequence(size_t length, generator_t & gen)
+{
+    static const char bases[] = "ACGT";
+    std::uniform_int_distribution<int> base(0, 3);
+    string seq(length, 'A');
+    for(size_t i = 0; i < length; ++i)
+        seq[i] = bases[base(gen)];
+    return seq;
+}
+
+// substitutions, insertions and deletions in equal parts, <rate> errors per base
+string mutate(const string & seq, double rate, generator_t & gen)
+{
+    static const char bases[] = "ACGT";
+    std::uniform_int_distribution<int> base(0, 3);
+    std::uniform_int_distribution<int> kind(0, 2);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    string out;
+    out.reserve(seq.size() + seq.size() / 8);
+    for(char b : seq)
+    {
+        if(unit(gen) >= rate) { out.push_back(b); continue; }
+        switch(kind(gen))
+        {
+            case 0: out.push_back(bases[(strchr(bases, b) - bases + 1 + base(gen) % 3) % 4]); break;
+            case 1: out.push_back(bases[base(gen)]); out.push_back(b); break;
+            case 2: break;
+        }
+    }
+    return out;
+}
+
+string reverseStrand(const string & seq)
+{
+    string rc(seq.rbegin(), seq.rend());
+    for(char & b : rc)
+        b = complementBase(b);
+    return rc;
+}
+
+int main (int argc, char *argv[]) {
+
+    cout << "\nBELLA - Microbenchmarks of the k-mer, dictionary, Bloom filter, SpGEMM and alignment kernels\n" << endl;
+
+    option_t *optList, *thisOpt;
+    optList = NULL;
+    optList = GetOptList(argc, argv, (char*)"k:n:g:c:l:e:p:t:m:r:b:o:S:T:h");
+
+    int kmer_len = 17;          // k-mer length (k)
+    size_t nkmers = 4000000;    // k-mers encoded, looked up and inserted per call (n)
+    size_t genome = 2000000;    // k-mer ids of the SpGEMM genome (g)
+    double coverage = 30;       // SpGEMM read coverage (c)
+    size_t readlen = 2000;      // read length of the SpGEMM and of the alignment pairs (l)
+    double erate = 0.15;        // error rate of the reads (e)
+    size_t npairs = 64;         // read pairs aligned per call (p)
+    vector<int> threads;        // thread counts (t)
+    benchPars_ pars;
+    char *filter = NULL;        // kernels whose name contains this (b)
+    char *out_file = NULL;      // tab-separated results (o)
+    uint64_t seed = 1;          // (S)
+    spacedSeed_ spaced;         // kmer-spaced extracts the k-mers of this mask, of the same weight as kmer-encode (T)
+
+    while (optList!=NULL) {
+        thisOpt = optList;
+        optList = optList->next;
+        switch (thisOpt->option) {
+            case 'k': {
+                kmer_len = atoi(thisOpt->argument);
+                break;
+            }
+            case 'n': {
+                nkmers = strtoull(thisOpt->argument, NULL, 10);
+                break;
+            }
+            case 'g': {
+                genome = strtoull(thisOpt->argument, NULL, 10);
+                break;
+            }
+            case 'c': {
+                coverage = atof(thisOpt->argument);
+                break;
+            }
+            case 'l': {
+                readlen = strtoull(thisOpt->argument, NULL, 10);
+                break;
+            }
+            case 'e': {
+                erate = atof(thisOpt->argument);
+                break;
+            }
+            case 'p': {
+                npairs = strtoull(thisOpt->argument, NULL, 10);
+                break;
+            }
+            case 't': {
+                if(thisOpt->argument == NULL)
+                {
+                    cout << "BELLA execution terminated: -t requires a comma-separated list of thread counts" << endl;
+                    cout << "Run with -h to print out the command line options\n" << endl;
+                    return 0;
+                }
+                char* list = strdup(thisOpt->argument);
+                for(char* t = strtok(list, ","); t != NULL; t = strtok(NULL, ","))
+                    threads.push_back(std::max(1, atoi(t)));
+                free(list);
+                break;
+            }
+            case 'm': {
+                pars.mintime = atof(thisOpt->argument);
+                break;
+            }
+            case 'r': {
+                pars.reps = std::max(1, atoi(thisOpt->argument));
+                break;
+            }
+            case 'b': {
+                filter = strdup(thisOpt->argument);
+                break;
+            }
+            case 'o': {
+                out_file = strdup(thisOpt->argument);
+                break;
+            }
+            case 'S': {
+                seed = strtoull(thisOpt->argument, NULL, 10);
+                break;
+            }
+            case 'T': {
+                if(!spaced.parse(thisOpt->argument))
+                {
+                    cout << "-T requires a palindromic mask of 0s and 1s of at most 32 bases, starting with 1" << endl;
+                    return 0;
+                }
+                break;
+            }
+            case 'h': {
+                cout << "Usage:\n" << endl;
+                cout << " -k : k-mer length [17]" << endl;
+                cout << " -n : k-mers per call of kmer-encode, kmer-rep, dictionary-find and bloom-check-add [4000000]" << endl;
+                cout << " -g : genome length in k-mers of the SpGEMM input [2000000]" << endl;
+                cout << " -c : read coverage of the SpGEMM input [30]" << endl;
+                cout << " -l : read length of the SpGEMM input and of the aligned pairs [2000]" << endl;
+                cout << " -e : error rate of the reads [0.15]" << endl;
+                cout << " -p : read pairs per call of align [64]" << endl;
+                cout << " -t : comma-separated thread counts [1,2,4,... up to OMP_NUM_THREADS]" << endl;
+                cout << " -m : minimum seconds per repetition [0.5]" << endl;
+                cout << " -r : repetitions, the fastest is kept [3]" << endl;
+                cout << " -b : only run the kernels whose name contains this string [all]" << endl;
+                cout << " -o : write the results as tab-separated values to this file" << endl;
+                cout << " -S : random seed [1]" << endl;
+                cout << " -T : spaced seed mask of kmer-spaced, k becomes its weight [kmer-spaced not run]" << endl;
+                cout << " -h : usage\n" << endl;
+                cout << "Kernels: kmer-encode, kmer-spaced, kmer-rep, dictionary-find, bloom-check-add, spgemm-symbolic, spgemm-numeric, align\n" << endl;
+                FreeOptList(thisOpt); // done with this list, free it
+                return 0;
+            }
+        }
+    }
+
+    free(optList);
+    free(thisOpt);
+
+    if(spaced.spaced())
+        kmer_len = spaced.weight;
+    if(kmer_len < 1 || kmer_len > MAX_KMER_SIZE - 1 || readlen < 4 * (size_t)kmer_len || genome < readlen)
+    {
+        cout << "BELLA execution terminated: invalid k-mer length, read length or genome length" << endl;
+        return 0;
+    }
+
+    int maxthreads = MAXTHREADS;
+    if(threads.empty())
+    {
+        for(int t = 1; t < maxthreads; t *= 2)
+            threads.push_back(t);
+        threads.push_back(maxthreads);
+    }
+
+    auto selected = [&filter] (const char* kernel) { return filter == NULL || strstr(kernel, filter) != NULL; };
+    Kmer::set_k(kmer_len);
+    generator_t gen(seed);
+    vector<kernelResult_> results;
+
+    auto run = [&] (const char* name, double ops, double bytes, std::function<void()> kernel)
+    {
+        for(int t : threads)
+        {
+            omp_set_num_threads(t);
+            kernelResult_ r = {name, t, ops, timeKernel(kernel, pars), bytes};
+            results.push_back(r);
+            cout << name << "\t" << t << " threads\t" << r.seconds * 1e9 / ops << " ns/op\t"
+                 << r.bytes / ops << " bytes/op\t" << ops / r.seconds << " ops/s" << endl;
+        }
+        omp_set_num_threads(maxthreads);
+    };
+
+    //
+    // K-mer kernels: all the k-mers of a random sequence, half of them are in the dictionary
+    //
+
+    string sequence = randomSequence(nkmers + kmer_len - 1, gen);
+    vector<Kmer> kmers(nkmers);
+    vector<Kmer> reps(nkmers);
+
+    if(selected("kmer-encode") || selected("kmer-rep") || selected("dictionary-find") || selected("bloom-check-add"))
+    {
+#pragma omp parallel for
+        for(size_t i = 0; i < nkmers; ++i)
+        {
+            kmers[i].set_kmer(sequence.c_str() + i);
+            reps[i] = kmers[i].rep();
+        }
+    }
+
+    if(selected("kmer-encode"))
+        run("kmer-encode", nkmers, (double)nkmers * (kmer_len + sizeof(Kmer)), [&] ()
+        {
+#pragma omp parallel for
+            for(size_t i = 0; i < nkmers; ++i)
+                kmers[i].set_kmer(sequence.c_str() + i);
+        });
+
+    // the same number of k-mers of the same weight, gathered from windows of the mask as BELLA does with -T
+    if(spaced.spaced() && selected("kmer-spaced"))
+    {
+        const size_t chunk = 1 << 16;
+        string spacedsequence = randomSequence(nkmers + spaced.span() - 1, gen);
+        vector<Kmer> spacedkmers(nkmers);
+        run("kmer-spaced", nkmers, (double)nkmers * (1 + sizeof(Kmer)), [&] ()
+        {
+#pragma omp parallel
+            {
+                vector<uint64_t> codes;
+#pragma omp for
+                for(size_t c = 0; c < nkmers; c += chunk)
+                {
+                    size_t n = std::min(chunk, nkmers - c);
+                    spacedCodes(spacedsequence.substr(c, n + spaced.span() - 1), spaced, codes);
+                    for(size_t i = 0; i < n; ++i)
+                        spacedkmers[c + i].set_word(codes[i]);
+                }
+            }
+        });
+    }
+
+    if(selected("kmer-rep"))
+        run("kmer-rep", nkmers, (double)nkmers * 2 * sizeof(Kmer), [&] ()
+        {
+#pragma omp parallel for
+            for(size_t i = 0; i < nkmers; ++i)
+                reps[i] = kmers[i].rep();
+        });
+
+    if(selected("dictionary-find"))
+    {
+        dictionary_t dictionary;
+        dictionary.reserve(nkmers / 2);
+        for(size_t i = 0; i < nkmers; i += 2)
+            dictionary.insert(reps[i], (int)i);
+
+        size_t found = 0;
+        run("dictionary-find", nkmers, (double)nkmers * (sizeof(Kmer) + sizeof(int)), [&] ()
+        {
+            size_t hits = 0;
+#pragma omp parallel for reduction(+:hits)
+            for(size_t i = 0; i < nkmers; ++i)
+            {
+                int count;
+                if(dictionary.find(reps[i], count)) ++hits;
+            }
+            found = hits;
+        });
+        cout << "dictionary-find: " << 100.0 * found / nkmers << "% hits" << endl;
+    }
+
+    if(selected("bloom-check-add"))
+    {
+        // sized as in kmercount.h; after the warm-up call every k-mer is in the filter and the calls only check
+        struct bloom * bm = (struct bloom*) malloc(sizeof(struct bloom));
+        bloom_init64(bm, nkmers * 1.1, 0.05);
+        run("bloom-check-add", nkmers, (double)nkmers * (sizeof(Kmer) + bm->hashes), [&] ()
+        {
+#pragma omp parallel for
+            for(size_t i = 0; i < nkmers; ++i)
+                bloom_check_add(bm, reps[i].getBytes(), reps[i].getNumBytes(), 1);
+        });
+        bloom_free(bm);
+        free(bm);
+    }
+
+    vector<Kmer>().swap(kmers);
+    vector<Kmer>().swap(reps);
+    string().swap(sequence);
+
+    //
+    // SpGEMM kernels: lower triangle of A * A^T on a reads x reliable k-mers matrix, the multiply and add operations
+    // of main.cpp; a k-mer is reliable when it is error-free, with probability (1-e)^k
+    //
+
+    if(selected("spgemm-symbolic") || selected("spgemm-numeric"))
+    {
+        incidencePars_ incidence;
+        incidence.genome = genome;
+        incidence.coverage = coverage;
+        incidence.readlen = readlen;
+        incidence.kmer_len = kmer_len;
+        incidence.keep = pow(1 - erate, kmer_len);
+        CSC<size_t,size_t> A, B;
+        incidenceMatrices(incidence, A, B, gen);
+
+        size_t* flopC = estimateFLOP(A, B, true);
+        size_t* colnnzC = estimateNNZ_Hash(A, B, flopC, true);
+        size_t* flopptr = prefixsum<size_t>(flopC, B.cols, maxthreads);
+        size_t* colptrC = prefixsum<size_t>(colnnzC, B.cols, maxthreads);
+        size_t flops = flopptr[B.cols];
+        size_t nnzc = colptrC[B.cols];
+        delete [] flopC;
+        delete [] colnnzC;
+        delete [] flopptr;
+
+        cout << "\nA: " << A.rows << " reads x " << A.cols << " k-mers, nnz " << A.nnz << " | flops " << flops
+             << " | nnz(C) " << nnzc << " | compression ratio " << (double)flops / std::max<size_t>(nnzc, 1) << endl;
+
+        double inputbytes = (double)(A.nnz + B.nnz) * 2 * sizeof(size_t);
+        if(selected("spgemm-symbolic"))
+            run("spgemm-symbolic", flops, inputbytes + B.cols * 2 * sizeof(size_t), [&] ()
+            {
+                size_t* f = estimateFLOP(A, B, true);
+                size_t* n = estimateNNZ_Hash(A, B, f, true);
+                delete [] f;
+                delete [] n;
+            });
+
+        if(selected("spgemm-numeric"))
+        {
+            BELLApars b_parameters;
+            size_t start = 0, end = B.cols;
+            run("spgemm-numeric", flops, inputbytes + nnzc * (sizeof(size_t) + sizeof(spmatPtr_) + sizeof(spmatType_)), [&] ()
+            {
+                vector<size_t> * RowIdsofC = new vector<size_t>[B.cols];
+                vector<spmatPtr_> * ValuesofC = new vector<spmatPtr_>[B.cols];
+                LocalSpGEMM(start, end, A, B,
+                    [] (size_t & pi, size_t & pj)
+                    {   spmatPtr_ value(make_shared<spmatType_>());
+                        value->count = 1;
+                        value->pos.push_back(make_pair(pi, pj));
+                        return value;
+                    },
+                    [&kmer_len,&b_parameters] (spmatPtr_ & m1, spmatPtr_ & m2)
+                    {
+                        for(size_t i = 0; i < m1->pos.size(); ++i)
+                        {
+                            int left  = m2->pos[i].first - kmer_len - b_parameters.kmerRift;
+                            int right = m2->pos[i].first + kmer_len + b_parameters.kmerRift;
+                            int newseed  = m1->pos[i].first;
+
+                            if(!isinrift(newseed, left, right))
+                            {
+                                left  = m2->pos[i].second - kmer_len - b_parameters.kmerRift;
+                                right = m2->pos[i].second + kmer_len + b_parameters.kmerRift;
+                                newseed  = m1->pos[i].second;
+
+                                if(!isinrift(newseed, left, right))
+                                {
+                                    m2->count = m2->count+m1->count;
+                                    m2->pos.clear();
+
+                                    m2->pos.push_back(make_pair(m2->pos[i].first, m2->pos[i].second));
+                                    m2->pos.push_back(make_pair(m1->pos[i].first, m1->pos[i].second));
+
+                                    break;
+                                }
+                            }
+                        }
+                        return m2;
+                    }, RowIdsofC, ValuesofC, colptrC, true);
+                delete [] RowIdsofC;
+                delete [] ValuesofC;
+            });
+        }
+        delete [] colptrC;
+    }
+
+    //
+    // Alignment kernel: pairs of reads overlapping by half their length with a shared error-free k-mer, half of them
+    // on opposite strands, aligned in score-only mode with per-thread contexts as in HashSpGEMM
+    //
+
+    if(selected("align"))
+    {
+        vector<readType_> rows(npairs), cols(npairs);
+        vector<int> rowpos(npairs), colpos(npairs);
+        size_t half = readlen / 2, cells = 0;
+        for(size_t p = 0; p < npairs; ++p)
+        {
+            string segment = randomSequence(readlen + half, gen);
+            size_t seedat = half + half / 2;    // middle of the overlap
+            string rowprefix = mutate(segment.substr(0, seedat), erate, gen);
+            string colprefix = mutate(segment.substr(half, seedat - half), erate, gen);
+            string kmer = segment.substr(seedat, kmer_len);
+            rows[p].seq = rowprefix + kmer + mutate(segment.substr(seedat + kmer_len, readlen - seedat - kmer_len), erate, gen);
+            cols[p].seq = colprefix + kmer + mutate(segment.substr(seedat + kmer_len), erate, gen);
+            rowpos[p] = rowprefix.size();
+            colpos[p] = colprefix.size();
+            if(p % 2 == 1)
+            {
+                rows[p].seq = reverseStrand(rows[p].seq);
+                rowpos[p] = rows[p].seq.size() - rowpos[p] - kmer_len;
+            }
+            rows[p].readid = 2 * p;
+            cols[p].readid = 2 * p + 1;
+            encodeRead(rows[p]);
+            encodeRead(cols[p]);
+            cells += rows[p].seq.size() * cols[p].seq.size();
+        }
+
+        vector<alignContext_> contexts(maxthreads);
+        size_t bytes = 0;
+        for(size_t p = 0; p < npairs; ++p)
+            bytes += rows[p].seq.size() + cols[p].seq.size();
+        vector<int> scores(npairs);
+        run("align", npairs, bytes, [&] ()
+        {
+#pragma omp parallel for schedule(dynamic)
+            for(size_t p = 0; p < npairs; ++p)
+                scores[p] = alignSeqAn(rows[p], cols[p], rowpos[p], colpos[p], kmer_len, contexts[MYTHREAD]).score;
+        });
+        cout << "align: " << (double)cells / npairs << " DP cells per pair at most, mean score "
+             << std::accumulate(scores.begin(), scores.end(), 0.0) / npairs << endl;
+    }
+
+    //
+    // Summary, speedup over the first thread count of each kernel
+    //
+
+    ofstream out;
+    if(out_file != NULL)
+    {
+        out.open(out_file);
+        if(!out.is_open())
+            cout << "Output file " << out_file << " failed to open" << endl;
+        else
+            out << "kernel\tthreads\tops\tns_per_op\tbytes_per_op\tgb_per_s\tspeedup" << endl;
+    }
+
+    cout << "\nKernel            Threads       ns/op    bytes/op      GB/s   Speedup" << endl;
+    double first = 0;
+    for(size_t i = 0; i < results.size(); ++i)
+    {
+        const kernelResult_ & r = results[i];
+        if(i == 0 || results[i-1].kernel != r.kernel)
+            first = r.seconds;
+        double nsperop = r.seconds * 1e9 / r.ops;
+        double bytesperop = r.bytes / r.ops;
+        double gbs = r.bytes / r.seconds / 1e9;
+        double speedup = first / r.seconds;
+        printf("%-16s %8d %11.3f %11.2f %9.3f %9.2f\n", r.kernel.c_str(), r.threads, nsperop, bytesperop, gbs, speedup);
+        if(out.is_open())
+            out << r.kernel << "\t" << r.threads << "\t" << r.ops << "\t" << nsperop << "\t" << bytesperop << "\t"
+                << gbs << "\t" << speedup << endl;
+    }
+    if(out.is_open())
+        cout << "\nResults written to " << out_file << endl;
+    return 0;
+}
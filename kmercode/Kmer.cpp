@@ -221,6 +221,15 @@ void Kmer::set_kmer(const char *s)  {
   }
 }
 
+// use:  km.set_word(w);
+// pre:  k <= 32, the 2k low bits of w are the bases of the k-mer (A=0, C=1, G=2, T=3), the first one most significant
+// post: the DNA string in km is the one packed in w
+void Kmer::set_word(uint64_t word)  {
+  assert(k <= 32);
+  memset(bytes.data(),0,N_BYTES);
+  longs[0] = word << (2*(32-k));
+}
+
 // This returns a vector of kmers from a long sequence
 // This does not check for Ns or choose the lesser representation
 std::vector<Kmer> Kmer::getKmers(std::string seq) {
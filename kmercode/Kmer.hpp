@@ -54,6 +54,7 @@ class Kmer {
   }
 
   void set_kmer(const char *s);
+  void set_word(uint64_t word);	// k <= 32 bases packed 2 bits each in the low bits of word, the first base most significant
   uint64_t hash() const;
   
 
@@ -51,6 +51,13 @@ public:
         open_fq(fqr, filename, cached_io);
     }
 
+    // only the records of one of nparts byte ranges of the file (e.g. one per MPI rank)
+    void openPart(const char *filename, int part, int nparts)
+    {
+        if(fqr->f) close_fq(fqr);
+        open_fq_part(fqr, filename, false, part, nparts);
+    }
+
     int get_max_read_len() {
         return fqr->max_read_len;
     }
@@ -99,6 +99,193 @@ int computeLower(int d, double e, int k)
         return (m-1);
 }
 
+/**
+ * @brief logPoisson is the log of the probability of count c when the mean count is lambda
+ */
+static double logPoisson(int c, double lambda)
+{
+    return c * log(lambda) - lambda - lgamma(c + 1.0);
+}
+
+/**
+ * @brief spectrumValley returns the count with the fewest k-mers between the error peak and the coverage peak,
+ * 2 if the coverage peak does not stand out (high error rates and low depths)
+ */
+static int spectrumValley(const std::vector<uint64_t> & spectrum)
+{
+    size_t peak = 2;
+    for(size_t c = 2; c < spectrum.size(); ++c)
+        if(spectrum[c] > spectrum[peak])
+            peak = c;
+    size_t valley = 2;
+    for(size_t c = 2; c <= peak; ++c)
+        if(spectrum[c] < spectrum[valley])
+            valley = c;
+    return (int)valley;
+}
+
+/**
+ * @brief fitRange returns the counts of the fit: [cmin, cmax] starts after the valley (counts of 1, and the ones
+ * before the valley, are mostly errors) and holds 99% of the k-mers, the rest are mostly repeats that the model
+ * does not describe
+ */
+static void fitRange(const std::vector<uint64_t> & spectrum, int & cmin, int & cmax)
+{
+    cmin = spectrumValley(spectrum);
+    double total = 0;
+    for(size_t c = cmin; c < spectrum.size(); ++c)
+        total += spectrum[c];
+
+    double cumsum = 0;
+    size_t last = cmin;
+    for(; last < spectrum.size(); ++last)
+    {
+        cumsum += spectrum[last];
+        if(cumsum >= 0.99 * total)
+            break;
+    }
+    cmax = (int)std::min(std::max(last, (size_t)cmin + 1), spectrum.size() - 1);
+}
 
+/**
+ * @brief truncatedPoisson returns the probability of a count in [cmin, cmax] and the mean count within it
+ */
+static double truncatedPoisson(double lambda, int cmin, int cmax, double & mean)
+{
+    double mass = 0, sum = 0;
+    for(int c = cmin; c <= cmax; ++c)
+    {
+        double pc = exp(logPoisson(c, lambda));
+        mass += pc;
+        sum += c * pc;
+    }
+    mean = (mass > 0) ? sum / mass : 0;
+    return mass;
+}
 
+/**
+ * @brief estimateDepth: a k-mer of the genome is covered by Poisson(d) reads and each copy is error-free with
+ * probability (1-e)^k, so its count is Poisson(d*(1-e)^k), the mean count of the binomial model of the bounds.
+ * The maximum likelihood mean of the counts in [cmin, cmax] (see fitRange) is the one whose truncated mean equals
+ * the observed one
+ * @param spectrum number of distinct k-mers seen c times
+ * @param e is the error rate
+ * @param k is the k-mer length
+ * @return depth, 0 if fewer than SPECTRUM_MIN_KMERS k-mers are in the range of the fit
+ */
+int estimateDepth(const std::vector<uint64_t> & spectrum, double e, int k)
+{
+    if(spectrum.size() < 4)
+        return 0;
+    int cmin, cmax;
+    fitRange(spectrum, cmin, cmax);
+    double kmers = 0, sum = 0;
+    for(int c = cmin; c <= cmax; ++c)
+    {
+        kmers += spectrum[c];
+        sum += (double)c * spectrum[c];
+    }
+    if(kmers < SPECTRUM_MIN_KMERS)
+        return 0;
+    double observed = sum / kmers;
 
+    // the truncated mean grows with lambda, bisection
+    double lo = 1e-6, hi = 2.0 * cmax + 10, mean;
+    for(int i = 0; i < 100; ++i)
+    {
+        double mid = 0.5 * (lo + hi);
+        truncatedPoisson(mid, cmin, cmax, mean);
+        if(mean < observed) lo = mid;
+        else hi = mid;
+    }
+    double p = pow(1 - e, k);
+    return std::max(2, (int)std::round(0.5 * (lo + hi) / p));
+}
+
+/**
+ * @brief spectrumModel
+ * @return expected number of distinct k-mers seen c times at depth d, for every c of the spectrum, scaled to the
+ * k-mers of the fit
+ */
+std::vector<double> spectrumModel(const std::vector<uint64_t> & spectrum, int d, double e, int k)
+{
+    std::vector<double> model(spectrum.size(), 0.0);
+    if(spectrum.size() < 4 || d < 2)
+        return model;
+    int cmin, cmax;
+    fitRange(spectrum, cmin, cmax);
+    double lambda = d * pow(1 - e, k), mean;
+
+    double fitted = 0;
+    for(int c = cmin; c <= cmax; ++c)
+        fitted += spectrum[c];
+    double mass = truncatedPoisson(lambda, cmin, cmax, mean);
+    if(mass <= 0)
+        return model;
+    double kmers = fitted / mass;   // k-mers of the genome, including those seen less than twice
+    for(size_t c = 0; c < model.size(); ++c)
+        model[c] = kmers * exp(logPoisson((int)c, lambda));
+    return model;
+}
+
+/**
+ * @brief spectrumBounds
+ * @param spectrum number of distinct k-mers seen c times
+ * @param lower is the valley between the error and the coverage peaks, 2 if the coverage peak does not stand out
+ * @param upper leaves out the k-mers above it, fewer than MIN_PROB of those in the range
+ */
+void spectrumBounds(const std::vector<uint64_t> & spectrum, int & lower, int & upper)
+{
+    lower = upper = 2;
+    if(spectrum.size() < 3)
+        return;
+
+    size_t valley = spectrumValley(spectrum);
+    lower = (int)valley;
+
+    double total = 0;
+    for(size_t c = valley; c < spectrum.size(); ++c)
+        total += spectrum[c];
+    double above = total;
+    size_t c = valley;
+    for(; c < spectrum.size(); ++c)
+    {
+        above -= spectrum[c];
+        if(above < MIN_PROB * total)
+            break;
+    }
+    upper = (int)std::min(c, spectrum.size() - 1);
+}
+
+/**
+ * @brief spectrumFlops: a reliable k-mer seen in c reads is a column of A with c nonzeros, it contributes c(c-1)/2
+ * flops to the lower triangle of A * A^T (estimateFLOP with lowtriout); k-mers seen twice in a read make it an
+ * upper bound
+ * @param spectrum number of distinct k-mers seen c times
+ * @return flops of the k-mers with counts in [lower, upper]
+ */
+double spectrumFlops(const std::vector<uint64_t> & spectrum, int lower, int upper)
+{
+    double flops = 0;
+    for(int c = std::max(lower, 2); c <= upper && c < (int)spectrum.size(); ++c)
+        flops += spectrum[c] * 0.5 * c * (c - 1.0);
+    return flops;
+}
+
+/**
+ * @brief budgetUpper
+ * @param budget flops of the lower triangle of A * A^T
+ * @return the highest upper bound in [lower, upper] whose predicted flops fit the budget, lower if none does
+ */
+int budgetUpper(const std::vector<uint64_t> & spectrum, int lower, int upper, double budget)
+{
+    double flops = 0;
+    int c = std::max(lower, 2);
+    for(; c <= upper && c < (int)spectrum.size(); ++c)
+    {
+        flops += spectrum[c] * 0.5 * c * (c - 1.0);
+        if(flops > budget)
+            break;
+    }
+    return std::max(lower, c - 1);
+}
@@ -1,6 +1,9 @@
 #ifndef BELLA_KMERCODE_BOUND_H_
 #define BELLA_KMERCODE_BOUND_H_
 
+#include <vector>
+#include <stdint.h>
+
 #define MIN_PROB 0.002 // 0.2% cumulative sum
 
 /**
@@ -21,4 +24,39 @@ int bincoef(int n, int k);
 int computeUpper(int depth, double erate, int klen);
 int computeLower(int depth, double erate, int klen);
 
+#define SPECTRUM_MAX 10000      // k-mer counts above this go to the last bin of the spectrum
+#define SPECTRUM_MIN_KMERS 100  // fewer k-mers in the range of the fit are not enough to estimate the depth
+
+/**
+ * @brief estimateDepth fits the mean count of the model of the bounds to the k-mer spectrum
+ * @param spectrum number of distinct k-mers seen c times, for every count c
+ * @param erate
+ * @param klen
+ * @return maximum likelihood depth, 0 if the spectrum is too small
+ */
+int estimateDepth(const std::vector<uint64_t> & spectrum, double erate, int klen);
+
+/**
+ * @brief spectrumModel is the number of distinct k-mers expected c times at the given depth (Poisson counts),
+ * scaled to the k-mers of the spectrum that the fit uses
+ */
+std::vector<double> spectrumModel(const std::vector<uint64_t> & spectrum, int depth, double erate, int klen);
+
+/**
+ * @brief spectrumBounds selects the reliable range from the spectrum instead of the model:
+ * the lower bound is the valley between the error and coverage peaks (2 if there is none),
+ * the upper bound leaves out the MIN_PROB most frequent k-mers
+ */
+void spectrumBounds(const std::vector<uint64_t> & spectrum, int & lower, int & upper);
+
+/**
+ * @brief spectrumFlops predicts the SpGEMM flops of the reliable range [lower, upper]
+ */
+double spectrumFlops(const std::vector<uint64_t> & spectrum, int lower, int upper);
+
+/**
+ * @brief budgetUpper lowers the reliable upper bound until the predicted SpGEMM flops fit the budget
+ */
+int budgetUpper(const std::vector<uint64_t> & spectrum, int lower, int upper, double budget);
+
 #endif
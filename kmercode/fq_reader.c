@@ -312,6 +312,11 @@ static int64_t get_fptr_for_next_record(fq_reader_t fqr, int64_t offset)
 }
 
 void open_fq(fq_reader_t fqr, const char *fname, int cached_io) {
+    open_fq_part(fqr, fname, cached_io, MYTHREAD, THREADS);
+}
+
+// the records of one of nparts byte ranges of the file, e.g. one per thread or one per MPI rank
+void open_fq_part(fq_reader_t fqr, const char *fname, int cached_io, int part, int nparts) {
     fqr->line = 0;
     fqr->max_read_len = 0;
     // we have a single file for all threads
@@ -320,12 +325,12 @@ void open_fq(fq_reader_t fqr, const char *fname, int cached_io) {
  
 
     fqr->f = fopen_chk(fqr->name, "r");
-    int64_t read_block = INT_CEIL(fqr->size, THREADS);
-    fqr->start_read = read_block * MYTHREAD;
-    fqr->end_read = read_block * (MYTHREAD + 1);
-    if (MYTHREAD > 0) 
+    int64_t read_block = INT_CEIL(fqr->size, nparts);
+    fqr->start_read = read_block * part;
+    fqr->end_read = read_block * (part + 1);
+    if (part > 0) 
 	    fqr->start_read = get_fptr_for_next_record(fqr, fqr->start_read);
-    if (MYTHREAD == THREADS - 1)
+    if (part == nparts - 1)
             fqr->end_read = fqr->size;
     else 
             fqr->end_read = get_fptr_for_next_record(fqr, fqr->end_read);
@@ -344,7 +349,7 @@ void open_fq(fq_reader_t fqr, const char *fname, int cached_io) {
     }
     fqr->fpos = fqr->start_read;
     assert(fqr->fpos == ftell(fqr->f));
-    if(MYTHREAD==0)
+    if(part==0)
     	fprintf(stdout, "Reading FASTQ file %s\n", fname);
 #ifndef __APPLE__
     if (fqr->f) {
@@ -42,6 +42,7 @@ typedef struct fq_reader *fq_reader_t;
 fq_reader_t create_fq_reader(void);
 void destroy_fq_reader(fq_reader_t fqr);
 void open_fq(fq_reader_t fqr, const char *fname, int cached_io);
+void open_fq_part(fq_reader_t fqr, const char *fname, int cached_io, int part, int nparts);
 void close_fq(fq_reader_t fqr);
 //int get_next_fq_record_ptr(fq_reader_t fqr, char **id, char **nts, char **quals);
 void hexifyId(char *name, int64_t *id1, int64_t *id2, int64_t step);
@@ -0,0 +1,335 @@
+#ifndef BELLA_KMERCODE_SEEDS_H_
+#define BELLA_KMERCODE_SEEDS_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <cstdlib>
+#include <ctype.h>
+#include <stdint.h>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+/* Seed sampling: which k-mers of a read are counted and become nonzeros of A
+ *
+ *  - minimizer:w  the k-mer of smallest hash in every window of w consecutive k-mers, density ~2/(w+1)
+ *  - open:s       open syncmers, the smallest s-mer of the k-mer is in its middle (offset (k-s)/2), density ~1/(k-s+1);
+ *                 when k-s is odd there are two middle offsets, both are kept and the density is ~2/(k-s+1)
+ *  - closed:s     closed syncmers, the smallest s-mer of the k-mer is its first or its last one, density ~2/(k-s+1)
+ *  - fraction:f   the k-mers whose hash is in the lowest fraction f of the hash range, density f
+ *
+ * Hashes are taken on the canonical k-mers and s-mers, and the accepted offsets of a syncmer are symmetric (offset o on
+ * one strand is k-s-o on the other), so a k-mer is sampled the same way on both strands, up to ties of s-mers. Syncmers
+ * and the hash fraction depend on the k-mer only: a sampled k-mer is sampled in every read that contains it and its
+ * count is its count without sampling. A minimizer also depends on the k-mers around it, errors there can unselect it.
+ */
+
+struct seedSampling_
+{
+	char scheme;		// 0 (every k-mer), 'm', 'o', 'c' or 'h'
+	int param;			// window (m) or s-mer length (o, c)
+	double fraction;	// h
+
+	seedSampling_(): scheme(0), param(0), fraction(1.0) {};
+
+	/**
+	 * @brief parse reads <scheme>:<value>, the scheme can be given by its first letter
+	 * @return false if the scheme or the value is invalid (s-mer length below k is checked by valid)
+	 */
+	bool parse(const std::string & spec)
+	{
+		size_t colon = spec.find(':');
+		if(colon == std::string::npos || colon == 0 || colon + 1 == spec.size())
+			return false;
+		std::string name = spec.substr(0, colon);
+		std::string value = spec.substr(colon + 1);
+		char c = name[0];
+		if(c == 'f') c = 'h';
+		if(name != std::string(1, name[0]) && name != "minimizer" && name != "open" && name != "closed" && name != "fraction")
+			return false;
+		if(c == 'h')
+		{
+			fraction = atof(value.c_str());
+			if(fraction <= 0.0 || fraction > 1.0) return false;
+		}
+		else if(c == 'm' || c == 'o' || c == 'c')
+		{
+			param = atoi(value.c_str());
+			if(param < 1) return false;
+		}
+		else return false;
+		scheme = c;
+		return true;
+	}
+
+	bool valid(int kmer_len) const
+	{
+		if(scheme == 'o' || scheme == 'c')
+			return param < kmer_len && param <= 31;
+		return true;
+	}
+
+	/**
+	 * @brief density is the expected fraction of the k-mers of a read that are sampled
+	 */
+	double density(int kmer_len) const
+	{
+		switch(scheme)
+		{
+			case 'm': return 2.0 / (param + 1);
+			case 'o': return ((kmer_len - param) % 2 ? 2.0 : 1.0) / (kmer_len - param + 1);
+			case 'c': return 2.0 / (kmer_len - param + 1);
+			case 'h': return fraction;
+			default:  return 1.0;
+		}
+	}
+
+	std::string str() const
+	{
+		switch(scheme)
+		{
+			case 'm': return "minimizer:" + std::to_string(param);
+			case 'o': return "open:" + std::to_string(param);
+			case 'c': return "closed:" + std::to_string(param);
+			case 'h': return "fraction:" + std::to_string(fraction);
+			default:  return "none";
+		}
+	}
+};
+
+/* Spaced seeds (-T): a mask of 0s and 1s over a window of <span> bases, the k-mer is made of the <weight> bases under
+ * the 1s. The mask is a palindrome, so the k-mer of the reverse complement of a window is the reverse complement of its
+ * k-mer and rep() stays strand-consistent. The window is packed 2 bits per base in a 64-bit word (span <= 32), the first
+ * base in the most significant bits, and the kept bases are gathered with PEXT on BMI2 CPUs (-march=native), otherwise
+ * with one shift and mask per block of consecutive 1s.
+ */
+
+struct spacedSeed_
+{
+	std::string mask;	// empty for contiguous k-mers
+	int weight;			// 1s in the mask
+	uint64_t gather;	// 2 bits per base under a 1, the last base of the window in the least significant bits
+	std::vector<std::pair<int,uint64_t>> blocks;	// portable gather: shift and mask of every block of 1s
+
+	spacedSeed_(): weight(0), gather(0) {};
+
+	/**
+	 * @return false unless the mask is a palindrome of 0s and 1s of at most 32 bases that starts and ends with 1
+	 */
+	bool parse(const std::string & spec)
+	{
+		int span = spec.length();
+		if(span < 2 || span > 32 || spec[0] != '1' || std::string(spec.rbegin(), spec.rend()) != spec)
+			return false;
+		if(spec.find_first_not_of("01") != std::string::npos)
+			return false;
+		mask = spec;
+		weight = 0;
+		gather = 0;
+		blocks.clear();
+		for(int p = 0; p < span; ++p)
+		{
+			if(mask[p] != '1') continue;
+			++weight;
+			gather |= 3ULL << (2*(span-1-p));
+		}
+		// a block of 1s ending at window position p lands after the 1s that follow it
+		int after = 0;
+		for(int p = span-1; p >= 0; --p)
+		{
+			if(mask[p] != '1') continue;
+			int len = 1;
+			while(p-len >= 0 && mask[p-len] == '1') ++len;
+			uint64_t bits = (len == 32) ? ~0ULL : ((1ULL << (2*len)) - 1);
+			blocks.push_back(std::make_pair(2*(span-1-p) - 2*after, bits << (2*after)));
+			after += len;
+			p -= len - 1;
+		}
+		return true;
+	}
+
+	bool spaced() const { return !mask.empty(); }
+	int span() const { return mask.length(); }
+};
+
+/**
+ * @brief gatherBits packs the bits of word selected by the gather mask into the low bits (PEXT)
+ */
+inline uint64_t gatherBits(uint64_t word, const spacedSeed_ & seed)
+{
+#ifdef __BMI2__
+	return _pext_u64(word, seed.gather);
+#else
+	uint64_t code = 0;
+	for(const auto & b : seed.blocks)
+		code |= (word >> b.first) & b.second;
+	return code;
+#endif
+}
+
+/**
+ * @brief spacedCodes sets codes[j] to the 2-bit code of the spaced k-mer of the window at j (other bases are read as A)
+ * The code of w bases is made of its 2w low bits, the first base in the most significant ones (see Kmer::set_word).
+ */
+inline void spacedCodes(const std::string & seq, const spacedSeed_ & seed, std::vector<uint64_t> & codes)
+{
+	int len = seq.length();
+	int span = seed.span();
+	codes.clear();
+	uint64_t window = 0;
+	for(int i = 0; i < len; ++i)
+	{
+		uint64_t c;
+		switch(seq[i])
+		{
+			case 'C': case 'c': c = 1; break;
+			case 'G': case 'g': c = 2; break;
+			case 'T': case 't': c = 3; break;
+			default: c = 0;
+		}
+		window = (window << 2) | c;	// bases older than the window are dropped by the gather mask
+		if(i >= span - 1)
+			codes.push_back(gatherBits(window, seed));
+	}
+}
+
+/**
+ * @brief seedHash mixes a hash (fmix64 of MurmurHash3): the k-mer hash modulo the counting passes is not reused
+ */
+inline uint64_t seedHash(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+/**
+ * @brief windowMinima sets argmin[i] to the position of the smallest hash in [i, i+w), the leftmost one on ties
+ */
+inline void windowMinima(const std::vector<uint64_t> & hashes, int w, std::vector<int> & argmin)
+{
+	int n = hashes.size();
+	argmin.clear();
+	std::deque<int> window;	// positions of increasing hashes
+	for(int i = 0; i < n; ++i)
+	{
+		while(!window.empty() && hashes[window.back()] > hashes[i])
+			window.pop_back();
+		window.push_back(i);
+		if(window.front() <= i - w)
+			window.pop_front();
+		if(i >= w - 1)
+			argmin.push_back(window.front());
+	}
+}
+
+/**
+ * @brief smerHashes hashes the canonical s-mers of seq (2-bit codes, other bases are read as A)
+ */
+inline void smerHashes(const std::string & seq, int s, std::vector<uint64_t> & hashes)
+{
+	int len = seq.length();
+	hashes.clear();
+	uint64_t mask = (s < 32) ? ((1ULL << (2*s)) - 1) : ~0ULL;
+	uint64_t fwd = 0, rev = 0;
+	for(int i = 0; i < len; ++i)
+	{
+		uint64_t c;
+		switch(seq[i])
+		{
+			case 'C': case 'c': c = 1; break;
+			case 'G': case 'g': c = 2; break;
+			case 'T': case 't': c = 3; break;
+			default: c = 0;
+		}
+		fwd = ((fwd << 2) | c) & mask;
+		rev = (rev >> 2) | ((3 - c) << (2*(s-1)));
+		if(i >= s - 1)
+			hashes.push_back(seedHash(std::min(fwd, rev)));
+	}
+}
+
+/**
+ * @brief compressHomopolymers collapses every run of a base to one base (-P), runstart[r] is where run r starts in seq
+ */
+inline void compressHomopolymers(const std::string & seq, std::string & hpc, std::vector<int> & runstart)
+{
+	int len = seq.length();
+	hpc.clear();
+	runstart.clear();
+	for(int i = 0; i < len; ++i)
+	{
+		char c = toupper(seq[i]);
+		if(hpc.empty() || hpc.back() != c)
+		{
+			hpc.push_back(c);
+			runstart.push_back(i);
+		}
+	}
+}
+
+/**
+ * @brief selectSeeds lists the positions of the sampled k-mers of seq, in increasing order
+ * @param kmerhash kmerhash(j) is the hash of the canonical k-mer at j, only called by the minimizer and fraction schemes
+ */
+template <typename KmerHash>
+void selectSeeds(const std::string & seq, int kmer_len, const seedSampling_ & sampling, KmerHash kmerhash,
+	std::vector<int> & positions)
+{
+	int nkmers = (int)seq.length() - kmer_len + 1;
+	positions.clear();
+	if(nkmers <= 0)
+		return;
+
+	std::vector<uint64_t> hashes;
+	std::vector<int> argmin;
+	switch(sampling.scheme)
+	{
+		case 'm':
+		{
+			hashes.resize(nkmers);
+			for(int j = 0; j < nkmers; ++j)
+				hashes[j] = seedHash(kmerhash(j));
+			windowMinima(hashes, std::min(sampling.param, nkmers), argmin);
+			for(int p : argmin)
+				if(positions.empty() || positions.back() != p)	// consecutive windows share their minimizer
+					positions.push_back(p);
+			break;
+		}
+		case 'o':
+		case 'c':
+		{
+			int span = kmer_len - sampling.param + 1;	// s-mers in a k-mer
+			smerHashes(seq, sampling.param, hashes);
+			windowMinima(hashes, span, argmin);
+			for(int j = 0; j < nkmers; ++j)
+			{
+				int offset = argmin[j] - j;
+				if(sampling.scheme == 'o' ? (offset == (span - 1) / 2 || offset == span / 2) : (offset == 0 || offset == span - 1))
+					positions.push_back(j);
+			}
+			break;
+		}
+		case 'h':
+		{
+			uint64_t threshold = (sampling.fraction >= 1.0) ? ~0ULL : (uint64_t)(sampling.fraction * 18446744073709551615.0);
+			for(int j = 0; j < nkmers; ++j)
+				if(seedHash(kmerhash(j)) <= threshold)
+					positions.push_back(j);
+			break;
+		}
+		default:
+		{
+			positions.resize(nkmers);
+			for(int j = 0; j < nkmers; ++j)
+				positions[j] = j;
+		}
+	}
+}
+
+#endif
@@ -42,6 +42,8 @@
 #include "kmercode/bound.hpp"
 #include "kmercode/hyperloglog.hpp"
 #include "mtspgemm2017/common.h"
+#include "mtspgemm2017/memplan.h"
+#include "mtspgemm2017/telemetry.h"
 
 using namespace std;
 #define ASCIIBASE 33 // Pacbio quality score ASCII BASE
@@ -98,6 +100,7 @@ vector<filedata>  GetFiles(char *filename) {
  */
 void JellyFishCount(char *kmer_file, dictionary_t & countsreliable_jelly, int lower, int upper) 
 {
+    ScopedPhase phase("k-mer counting");
     ifstream filein(kmer_file);
     string line;
     int elem;
@@ -146,6 +149,44 @@ void JellyFishCount(char *kmer_file, dictionary_t & countsreliable_jelly, int lo
     countsjelly.clear(); // free 
 }
 
+/**
+ * @brief readKmer is the k-mer at j of seq, with -T the spaced one whose code spacedCodes put in codes[j]
+ */
+inline Kmer readKmer(const std::string & seq, int j, int kmer_len, const spacedSeed_ & spaced, const vector<uint64_t> & codes)
+{
+    if(!spaced.spaced())
+        return Kmer(seq.substr(j, kmer_len).c_str());
+    Kmer mykmer;
+    mykmer.set_word(codes[j]);
+    return mykmer;
+}
+
+/**
+ * @brief writeSpectrum writes one line per k-mer count: distinct k-mers seen that many times, distinct k-mers the
+ * binomial model of the bounds expects at the depth, and whether the count is in the reliable range
+ * Counts of 1 only hold the k-mers that passed the Bloom filter by chance
+ */
+bool writeSpectrum(const string & filename, const vector<uint64_t> & spectrum, int depth, bool estimated, double erate,
+    int kmer_len, int lower, int upper)
+{
+    ofstream out(filename.c_str());
+    if(!out.is_open())
+        return false;
+
+    vector<double> model = spectrumModel(spectrum, depth, erate, kmer_len);
+    size_t last = spectrum.size();
+    while(last > 0 && spectrum[last-1] == 0)
+        --last;
+
+    out << "# k=" << kmer_len << " depth=" << depth << (estimated ? " (estimated)" : "") << " error_rate=" << erate
+        << " reliable=[" << lower << "," << upper << "]" << endl;
+    out << "count\tkmers\tmodel\treliable" << endl;
+    for(size_t c = 1; c < last; ++c)
+        out << c << (c == SPECTRUM_MAX ? "+" : "") << "\t" << spectrum[c] << "\t" << model[c] << "\t"
+            << ((int)c >= lower && (int)c <= upper) << "\n";
+    return out.good();
+}
+
 /**
  * @brief DeNovoCount
  * @param allfiles
@@ -154,16 +195,31 @@ void JellyFishCount(char *kmer_file, dictionary_t & countsreliable_jelly, int lo
  * @param upper
  * @param kmer_len
  * @param upperlimit
+ * @param plan: k-mers are counted in plan.countingPasses passes, each one keeping only the k-mers of one hash partition
+ * @param depth: 0 to estimate it from the k-mer spectrum of the first pass (a hash sample of the k-mers if passes > 1)
  */
-void DeNovoCount(vector<filedata> & allfiles, dictionary_t & countsreliable_denovo, int & lower, int & upper, int kmer_len, int depth, double & erate, size_t upperlimit /* memory limit */, BELLApars & b_parameters)
+void DeNovoCount(vector<filedata> & allfiles, dictionary_t & countsreliable_denovo, int & lower, int & upper, int kmer_len, int & depth, double & erate, size_t upperlimit /* memory limit */, BELLApars & b_parameters, memoryPlan_ & plan)
 {
+    ScopedPhase phase("k-mer counting");
     vector < vector<Kmer> > allkmers(MAXTHREADS);
     vector < vector<double> > allquals(MAXTHREADS);
-    vector < HyperLogLog > hlls(MAXTHREADS, HyperLogLog(12));   // std::vector fill constructor
 
-    double denovocount = omp_get_wtime();
     double cardinality;
     size_t totreads = 0;
+    int kmer_id_denovo = 0;
+    const int passes = plan.countingPasses;
+    plan.cardinality = 0;
+    // bases that must be error-free for a k-mer to be seen: the 1s of the mask of a spaced seed
+    int weight = b_parameters.spacedSeed.spaced() ? b_parameters.spacedSeed.weight : kmer_len;
+
+    bool estimated = (depth == 0);
+    vector<uint64_t> spectrum(SPECTRUM_MAX+1, 0);  // all passes, for the -s file and the SpGEMM flop prediction
+
+  for(int pass = 0; pass < passes; ++pass)
+  {
+    vector < HyperLogLog > hlls(MAXTHREADS, HyperLogLog(12));   // std::vector fill constructor
+    double denovocount = omp_get_wtime();
+    bool firstpass = (pass == 0);   // the error rate is estimated once
 
     for(auto itr=allfiles.begin(); itr!=allfiles.end(); itr++) 
     {
@@ -176,6 +232,10 @@ void DeNovoCount(vector<filedata> & allfiles, dictionary_t & countsreliable_deno
             vector<string> quals;
             vector<string> nametags;
             size_t tlreads = 0; // thread local reads
+            vector<int> positions;  // sampled k-mers of a read
+            string hpc;             // homopolymer-compressed read (-P)
+            vector<int> runstart;
+            vector<uint64_t> codes;  // spaced k-mers of a read (-T)
 
             size_t fillstatus = 1;
             while(fillstatus) 
@@ -189,27 +249,30 @@ void DeNovoCount(vector<filedata> & allfiles, dictionary_t & countsreliable_deno
                     int len = seqs[i].length();
                     double rerror = 0.0;
 
-                    for(int j=0; j<=len-kmer_len; j++)  
+                    // with -P the k-mers are those of the homopolymer-compressed read
+                    if(b_parameters.homopolymer)
+                        compressHomopolymers(seqs[i], hpc, runstart);
+                    const std::string & kseq = b_parameters.homopolymer ? hpc : seqs[i];
+                    if(b_parameters.spacedSeed.spaced())
+                        spacedCodes(kseq, b_parameters.spacedSeed, codes);
+
+                    // only the sampled k-mers are counted, the same ones are looked up when A is built
+                    selectSeeds(kseq, kmer_len, b_parameters.sampling, [&](int j)
+                        { return readKmer(kseq, j, kmer_len, b_parameters.spacedSeed, codes).rep().hash(); }, positions);
+                    for(int j : positions)
                     {
-                        std::string kmerstrfromfastq = seqs[i].substr(j, kmer_len);
-                        Kmer mykmer(kmerstrfromfastq.c_str());
+                        Kmer mykmer = readKmer(kseq, j, kmer_len, b_parameters.spacedSeed, codes);
                         Kmer lexsmall = mykmer.rep();
-                        allkmers[MYTHREAD].push_back(lexsmall);
-                        hlls[MYTHREAD].add((const char*) lexsmall.getBytes(), lexsmall.getNumBytes());
-
-            		if(b_parameters.skipEstimate == false)
-            		{
-                        	// accuracy
-                       		int bqual = (int)quals[i][j] - ASCIIBASE;
-                        	double berror = pow(10,-(double)bqual/10);
-                        	rerror += berror;
-            		}
-
+                        if(passes == 1 || lexsmall.hash() % (uint64_t)passes == (uint64_t)pass)
+                        {
+                            allkmers[MYTHREAD].push_back(lexsmall);
+                            hlls[MYTHREAD].add((const char*) lexsmall.getBytes(), lexsmall.getNumBytes());
+                        }
                     }
-		    if(b_parameters.skipEstimate == false)
+		    if(b_parameters.skipEstimate == false && firstpass)
 		    {
-                    	// remaining k qual position accuracy
-                    	for(int j=len-kmer_len+1; j < len; j++)
+                    	// accuracy of every position, sampled or not
+                    	for(int j=0; j < len; j++)
                     	{
                         	int bqual = (int)quals[i][j] - ASCIIBASE;
                         	double berror = pow(10,-(double)bqual/10);
@@ -229,7 +292,7 @@ void DeNovoCount(vector<filedata> & allfiles, dictionary_t & countsreliable_deno
     }
 
     // Error estimation
-    if(b_parameters.skipEstimate == false)
+    if(b_parameters.skipEstimate == false && firstpass)
     {
         erate = 0.0; // reset to 0 here, otherwise it cointains default or user-defined values
         #pragma omp for reduction(+:erate)
@@ -247,8 +310,11 @@ void DeNovoCount(vector<filedata> & allfiles, dictionary_t & countsreliable_deno
         std::transform(hlls[0].M.begin(), hlls[0].M.end(), hlls[i].M.begin(), hlls[0].M.begin(), [](uint8_t c1, uint8_t c2) -> uint8_t{ return std::max(c1, c2); });
     }
     cardinality = hlls[0].estimate();
+    plan.cardinality += cardinality;
 
     double load2kmers = omp_get_wtime(); 
+    if(passes > 1)
+        cout << "K-mer counting pass " << pass+1 << " of " << passes << endl;
     cout << "Initial parsing, error estimation, and k-mer loading took: " << load2kmers - denovocount << "s\n" << endl;
 
     const double desired_probability_of_false_positive = 0.05;
@@ -272,10 +338,11 @@ void DeNovoCount(vector<filedata> & allfiles, dictionary_t & countsreliable_deno
     	}
     }
 
-    double firstpass = omp_get_wtime();
-    cout << "First pass of k-mer counting took: " << firstpass - load2kmers << "s" << endl;
+    double bloompass = omp_get_wtime();
+    cout << "First pass of k-mer counting took: " << bloompass - load2kmers << "s" << endl;
 
-    free(bm); // release bloom filter memory
+    bloom_free(bm); // release bloom filter memory
+    free(bm);
 
     // in this pass, only use entries that already are in the hash table
     auto updatecount = [](int &num) { ++num; };
@@ -287,15 +354,51 @@ void DeNovoCount(vector<filedata> & allfiles, dictionary_t & countsreliable_deno
         	countsdenovo.update_fn(v,updatecount);
     	}
     }
-    cout << "Second pass of k-mer counting took: " << omp_get_wtime() - firstpass << "s\n" << endl;
+    cout << "Second pass of k-mer counting took: " << omp_get_wtime() - bloompass << "s\n" << endl;
+    for(int t = 0; t < MAXTHREADS; ++t)
+        vector<Kmer>().swap(allkmers[t]);   // free the k-mers of this pass
     //cout << "countsdenovo.size() " << countsdenovo.size() << endl;
-    // Reliable bounds computation using estimated error rate from phred quality score
-    lower = computeLower(depth, erate, kmer_len);
-    upper = computeUpper(depth, erate, kmer_len);
-
-    // Reliable k-mer filter on countsdenovo
-    int kmer_id_denovo = 0;
     auto lt = countsdenovo.lock_table(); // our counting
+
+    // K-mer spectrum of this pass, only k-mers seen twice are in the table (the others did not pass the Bloom filter)
+    vector<uint64_t> passspectrum(SPECTRUM_MAX+1, 0);
+    for (const auto &it : lt)
+        ++passspectrum[std::min(it.second, SPECTRUM_MAX)];
+    std::transform(spectrum.begin(), spectrum.end(), passspectrum.begin(), spectrum.begin(), std::plus<uint64_t>());
+
+    // Reliable bounds computation using estimated error rate from phred quality score, the same for every pass
+    if(firstpass)
+    {
+        if(estimated)
+        {
+            depth = estimateDepth(passspectrum, erate, weight);
+            if(depth == 0)
+            {
+                cout << "BELLA terminated: too few k-mers seen twice to estimate the depth (set it with -d)\n" << endl;
+                exit(0);
+            }
+            cout << "Depth estimate from the k-mer spectrum is " << depth << "X" << endl;
+        }
+        if(b_parameters.spectrumRange)
+            spectrumBounds(passspectrum, lower, upper);
+        else
+        {
+            lower = computeLower(depth, erate, weight);
+            upper = computeUpper(depth, erate, weight);
+        }
+        // The first pass holds 1/passes of the k-mers: its spectrum predicts 1/passes of the flops
+        if(b_parameters.flopBudget > 0)
+        {
+            int capped = budgetUpper(passspectrum, lower, upper, b_parameters.flopBudget / passes);
+            if(capped < upper)
+                cout << "Reliable upper bound lowered from " << upper << " to " << capped << " to fit the SpGEMM flop budget" << endl;
+            upper = capped;
+            if(spectrumFlops(passspectrum, lower, upper) * passes > b_parameters.flopBudget)
+                cout << "Warning: the SpGEMM flops exceed the budget even with upper bound = lower bound = " << lower << endl;
+        }
+    }
+
+    // Reliable k-mer filter on countsdenovo (k-mer ids keep growing across passes)
     for (const auto &it : lt) 
         if (it.second >= lower && it.second <= upper)
         {
@@ -303,6 +406,18 @@ void DeNovoCount(vector<filedata> & allfiles, dictionary_t & countsreliable_deno
             ++kmer_id_denovo;
         }
     lt.unlock(); // unlock the table
+    countsdenovo.clear(); // free
+  } // for(int pass = 0; pass < passes; ++pass)
+
+    plan.spectrumFlops = spectrumFlops(spectrum, lower, upper);
+    cout << "Predicted SpGEMM flops from the k-mer spectrum: " << plan.spectrumFlops << endl;
+
+    if(!b_parameters.spectrumFile.empty())
+    {
+        if(writeSpectrum(b_parameters.spectrumFile, spectrum, depth, estimated, erate, weight, lower, upper))
+            cout << "K-mer spectrum written to " << b_parameters.spectrumFile << endl;
+        else cout << "K-mer spectrum file " << b_parameters.spectrumFile << " failed to open" << endl;
+    }
 
     // Print some information about the table
     if (countsreliable_denovo.size() == 0)
@@ -316,7 +431,6 @@ void DeNovoCount(vector<filedata> & allfiles, dictionary_t & countsreliable_deno
     }
     //cout << "Bucket count: " << countsdenovo.bucket_count() << std::endl;
     //cout << "Load factor: " << countsdenovo.load_factor() << std::endl;
-    countsdenovo.clear(); // free
 
 }
 #endif
@@ -3,6 +3,7 @@
 #include <cstdlib>
 #include <fstream>
 #include <istream>
+#include <sstream>
 #include <vector>
 #include <string>
 #include <stdlib.h>
@@ -43,6 +44,7 @@
 #include "mtspgemm2017/common.h"
 #include "mtspgemm2017/IO.h"
 #include "mtspgemm2017/overlapping.h"
+#include "mtspgemm2017/checkpoint.h"
 #include "mtspgemm2017/align.h"
 
 #define LSIZE 16000
@@ -68,16 +70,17 @@ int main (int argc, char *argv[]) {
     // Follow an option with a colon to indicate that it requires an argument.
 
     optList = NULL;
-    optList = GetOptList(argc, argv, (char*)"f:i:o:d:hk:Ka:ze:x:w:nc:m:r:p");
+    optList = GetOptList(argc, argv, (char*)"f:i:o:d:hk:Ka:ze:w:nc:m:r:pDCBb:y:j:S:RM:s:HF:q:PT:");
    
 
     char *kmer_file = NULL;                 // Reliable k-mer file from Jellyfish
     char *all_inputs_fofn = NULL;           // List of fastqs (i)
     char *out_file = NULL;                  // output filename (o)
+    char *json_file = NULL;                 // performance report (j)
+    checkpoint_ checkpoint;                 // checkpoint directory (S) and resume (R)
     int kmer_len = 17;                      // default k-mer length (k)
-    int xdrop = 7;                          // default alignment x-drop factor (x)
     double erate = 0.15;                    // default error rate (e) 
-    int depth = 0;                          // depth/coverage required (d)
+    int depth = 0;                          // depth/coverage, 0 = estimated from the k-mer spectrum (d)
 
     BELLApars b_parameters;
 
@@ -115,6 +118,8 @@ int main (int argc, char *argv[]) {
                 break;
             }
             case 'p': b_parameters.outputPaf = true; break; // PAF format
+            case 'C': b_parameters.outputCigar = true; break; // CIGAR in PAF format
+            case 'B': b_parameters.outputBinary = true; break; // binary overlap records
             case 'o': {
                 if(thisOpt->argument == NULL)
                 {
@@ -136,10 +141,6 @@ int main (int argc, char *argv[]) {
 
                 delete line1;
                 delete line2;
-
-                // delete file to avoid errors in output
-                remove(out_file);
-
                 break;
             }
             case 'd': {
@@ -172,10 +173,6 @@ int main (int argc, char *argv[]) {
                 b_parameters.adapThr = false;
                 break;
             }
-            case 'x': {
-                xdrop = atoi(thisOpt->argument);
-                break;
-            } 
             case 'w': {
                 b_parameters.relaxMargin = atoi(thisOpt->argument);
                 break;
@@ -184,6 +181,107 @@ int main (int argc, char *argv[]) {
                 b_parameters.allKmer = true;
                 break;
             }
+            case 'b': {
+                if(thisOpt->argument == NULL)
+                {
+                    cout << "BELLA execution terminated: -b requires a comma-separated list of bands" << endl;
+                    cout << "Run with -h to print out the command line options\n" << endl;
+                    return 0;
+                }
+                char* bands = strdup(thisOpt->argument);
+                for(char* band = strtok(bands, ","); band != NULL; band = strtok(NULL, ","))
+                    b_parameters.cascadeBands.push_back(atoi(band));
+                free(bands);
+                if(b_parameters.cascadeBands.size() > MAX_CASCADE_LEVELS)
+                {
+                    cout << "BELLA execution terminated: -b supports at most " << MAX_CASCADE_LEVELS << " levels" << endl;
+                    cout << "Run with -h to print out the command line options\n" << endl;
+                    return 0;
+                }
+                break;
+            }
+            case 'y': {
+                b_parameters.cascadeCutoff = stod(thisOpt->argument);
+                break;
+            }
+            case 'D': {
+                b_parameters.diagFilter = true;
+                break;
+            }
+            case 'j': {
+                if(thisOpt->argument == NULL)
+                {
+                    cout << "BELLA execution terminated: -j requires an argument" << endl;
+                    cout << "Run with -h to print out the command line options\n" << endl;
+                    return 0;
+                }
+                json_file = strdup(thisOpt->argument);
+                break;
+            }
+            case 'S': {
+                if(thisOpt->argument == NULL)
+                {
+                    cout << "BELLA execution terminated: -S requires an argument" << endl;
+                    cout << "Run with -h to print out the command line options\n" << endl;
+                    return 0;
+                }
+                checkpoint.dir = thisOpt->argument;
+                break;
+            }
+            case 'R': {
+                checkpoint.resume = true;
+                break;
+            }
+            case 'M': {
+                if(thisOpt->argument == NULL)
+                {
+                    cout << "BELLA execution terminated: -M requires an argument" << endl;
+                    cout << "Run with -h to print out the command line options\n" << endl;
+                    return 0;
+                }
+                b_parameters.candidateFile = thisOpt->argument;
+                break;
+            }
+            case 's': {
+                if(thisOpt->argument == NULL)
+                {
+                    cout << "BELLA execution terminated: -s requires an argument" << endl;
+                    cout << "Run with -h to print out the command line options\n" << endl;
+                    return 0;
+                }
+                b_parameters.spectrumFile = thisOpt->argument;
+                break;
+            }
+            case 'H': b_parameters.spectrumRange = true; break;
+            case 'P': b_parameters.homopolymer = true; break;
+            case 'T': {
+                if(thisOpt->argument == NULL || !b_parameters.spacedSeed.parse(thisOpt->argument))
+                {
+                    cout << "BELLA execution terminated: -T requires a palindromic mask of 0s and 1s of at most 32 bases, starting with 1" << endl;
+                    cout << "Run with -h to print out the command line options\n" << endl;
+                    return 0;
+                }
+                break;
+            }
+            case 'q': {
+                if(thisOpt->argument == NULL || !b_parameters.sampling.parse(thisOpt->argument))
+                {
+                    cout << "BELLA execution terminated: -q requires minimizer:<w>, open:<s>, closed:<s> or fraction:<f>" << endl;
+                    cout << "Run with -h to print out the command line options\n" << endl;
+                    return 0;
+                }
+                break;
+            }
+            case 'F': {
+                if(thisOpt->argument == NULL || stod(thisOpt->argument) < 0.0)
+                {
+                    cout << "BELLA execution terminated: -F requires a non-negative number of flops" << endl;
+                    cout << "Run with -h to print out the command line options\n" << endl;
+                    return 0;
+                }
+                b_parameters.flopBudget = stod(thisOpt->argument);
+                break;
+            }
             case 'm': {
                 b_parameters.totalMemory = stod(thisOpt->argument);
                 b_parameters.userDefMem = true;
@@ -205,10 +303,9 @@ int main (int argc, char *argv[]) {
                 cout << " -f : k-mer list from Jellyfish (required if Jellyfish k-mer counting is used)" << endl; // Reliable k-mers are selected by BELLA
                 cout << " -i : list of fastq(s) (required)" << endl;
                 cout << " -o : output filename (required)" << endl;
-                cout << " -d : depth/coverage (required)" << endl; // TO DO: add depth estimation
+                cout << " -d : depth/coverage [estimated from the k-mer spectrum]" << endl;
                 cout << " -k : k-mer length [17]" << endl;
                 cout << " -a : use fixed alignment threshold [50]" << endl;
-                cout << " -x : alignment x-drop factor [7]" << endl;
                 cout << " -e : error rate [auto estimated from fastq]" << endl;
                 cout << " -m : total RAM of the system in MB [auto estimated if possible or 8,000 if not]" << endl;
                 cout << " -z : skip the pairwise alignment [false]" << endl;
@@ -216,7 +313,22 @@ int main (int argc, char *argv[]) {
                 cout << " -c : alignment score deviation from the mean [0.1]" << endl;
                 cout << " -n : filter out alignment on edge [false]" << endl;
                 cout << " -r : kmerRift: bases separating two k-mers used as seeds for a read [1,000]" << endl;
-                cout << " -p : output in PAF format [false]\n" << endl;
+                cout << " -b : alignment cascade, comma-separated bands in diagonals (0 = full matrix), e.g. 32,256,0 [no cascade]" << endl;
+                cout << " -y : cascade cut-off: failed pairs scoring at least this fraction of the threshold go to the next level [0.5]" << endl;
+                cout << " -j : write a JSON performance report (phases, stages, hardware counters) to this file [none]" << endl;
+                cout << " -S : write checkpoints (reliable k-mers, matrices, completed stages) to this directory [none]" << endl;
+                cout << " -R : resume from the checkpoints in the -S directory, skipping the completed work [false]" << endl;
+                cout << " -s : write the k-mer spectrum (count histogram and fitted model) to this file [none]" << endl;
+                cout << " -H : select the reliable range from the k-mer spectrum instead of the binomial model [false]" << endl;
+                cout << " -F : lower the reliable upper bound until the SpGEMM flops predicted from the k-mer spectrum fit this budget, e.g. 1e10 [0, no budget]" << endl;
+                cout << " -q : seed sampling, k-mers counted and put in A: minimizer:<window>, open:<s-mer length>, closed:<s-mer length> (syncmers) or fraction:<f> [all k-mers]" << endl;
+                cout << " -P : k-mers of the homopolymer-compressed reads, for long reads with homopolymer indels [false]" << endl;
+                cout << " -T : spaced seed, palindromic mask of the bases of a window that make the k-mer, e.g. 1101101011011 (sets -k to its length) [contiguous]" << endl;
+                cout << " -M : write the candidate overlap matrix to this file and stop before the alignment, align it with bella-align [none]" << endl;
+                cout << " -D : skip pairs whose shared k-mers disagree on strand and diagonal [false]" << endl;
+                cout << " -p : output in PAF format [false]" << endl;
+                cout << " -C : output the CIGAR of accepted alignments as cg:Z: tag, requires -p [false]" << endl;
+                cout << " -B : output binary overlap records, convert with bench/ovl2text [false]\n" << endl;
 
                 FreeOptList(thisOpt); // Done with this list, free it
                 return 0;
@@ -231,8 +343,18 @@ int main (int argc, char *argv[]) {
         cout << "Run with -h to print out the command line options\n" << endl;
         return 0;
     }
+    if(b_parameters.homopolymer)
+    {
+        cout << "Jellyfish counts the k-mers of the uncompressed reads: -P ignored" << endl;
+        b_parameters.homopolymer = false;
+    }
+    if(b_parameters.spacedSeed.spaced())
+    {
+        cout << "Jellyfish counts contiguous k-mers: -T ignored" << endl;
+        b_parameters.spacedSeed = spacedSeed_();
+    }
 #else
-    if(all_inputs_fofn == NULL || out_file == NULL || depth == 0)
+    if(all_inputs_fofn == NULL || out_file == NULL)
     {
         cout << "BELLA execution terminated: missing arguments" << endl;
         cout << "Run with -h to print out the command line options\n" << endl;
@@ -240,16 +362,94 @@ int main (int argc, char *argv[]) {
     }
 #endif
 
+    if(b_parameters.outputBinary && b_parameters.skipAlignment)
+    {
+        cout << "Binary output requires the pairwise alignment: -B ignored" << endl;
+        b_parameters.outputBinary = false;
+    }
+    if(b_parameters.outputBinary && (b_parameters.outputPaf || b_parameters.outputCigar))
+    {
+        cout << "Binary output is converted to PAF by bench/ovl2text: -p and -C ignored" << endl;
+        b_parameters.outputPaf = false;
+        b_parameters.outputCigar = false;
+    }
+    if(b_parameters.outputCigar && (!b_parameters.outputPaf || b_parameters.skipAlignment))
+    {
+        cout << "CIGAR output requires -p and the pairwise alignment: -C ignored" << endl;
+        b_parameters.outputCigar = false;
+    }
+
+    // a spaced seed is a k-mer of <weight> bases spread over a window of kmer_len bases
+    int weight = kmer_len;
+    if(b_parameters.spacedSeed.spaced())
+    {
+        kmer_len = b_parameters.spacedSeed.span();
+        weight = b_parameters.spacedSeed.weight;
+    }
+
+    if(!b_parameters.sampling.valid(kmer_len))
+    {
+        cout << "BELLA execution terminated: the syncmer s-mer length must be shorter than k and at most 31" << endl;
+        cout << "Run with -h to print out the command line options\n" << endl;
+        return 0;
+    }
+
+    seedShape().homopolymer = b_parameters.homopolymer;    // the alignment finds the strand of a seed from its bases
+    seedShape().mask = b_parameters.spacedSeed.mask;
+
+    if(checkpoint.resume && !checkpoint.enabled())
+    {
+        cout << "Resuming requires the checkpoint directory (-S): -R ignored" << endl;
+        checkpoint.resume = false;
+    }
+
     free(optList);
     free(thisOpt);
+
+#if defined (__linux__)
+    // match the CPU quota and affinity of the job unless the user chose the threads
+    int cputhreads = cgroupThreads();
+    if(getenv("OMP_NUM_THREADS") == NULL && cputhreads > 0 && cputhreads < omp_get_max_threads())
+    {
+        omp_set_num_threads(cputhreads);
+        cout << "Threads limited to " << cputhreads << " by the CPU affinity/quota" << endl;
+    }
+#endif
+    if(json_file != NULL)
+    {
+        string command;
+        for(int i = 0; i < argc; ++i)
+            command += (i ? " " : "") + string(argv[i]);
+        telemetry.start(json_file, MAXTHREADS, command);
+    }
     //
     // Declarations 
     //
     vector<filedata> allfiles = GetFiles(all_inputs_fofn);
+    if(checkpoint.enabled())
+    {
+        // what the k-mers and the matrices depend on, and in addition what the overlap and alignment stages depend on
+        ostringstream input, stages;
+        for(auto itr=allfiles.begin(); itr!=allfiles.end(); itr++)
+            input << itr->filename << ":" << itr->filesize << ";";
+        input << "k=" << kmer_len << ";d=" << (depth ? to_string(depth) : "auto") << ";e=" << (b_parameters.skipEstimate ? to_string(erate) : "auto")
+            << ";H=" << b_parameters.spectrumRange << ";F=" << b_parameters.flopBudget << ";q=" << b_parameters.sampling.str() << ";P=" << b_parameters.homopolymer << ";T=" << b_parameters.spacedSeed.mask;
+        if(kmer_file != NULL) input << ";f=" << kmer_file;
+        stages << "z=" << b_parameters.skipAlignment << ";K=" << b_parameters.allKmer << ";r=" << b_parameters.kmerRift
+            << ";a=" << (b_parameters.adapThr ? -1 : b_parameters.defaultThr) << ";c=" << b_parameters.deltaChernoff << ";n=" << b_parameters.alignEnd
+            << ";w=" << b_parameters.relaxMargin << ";D=" << b_parameters.diagFilter << ";y=" << b_parameters.cascadeCutoff << ";b=";
+        for(int band : b_parameters.cascadeBands)
+            stages << band << ",";
+        stages << ";p=" << b_parameters.outputPaf << ";C=" << b_parameters.outputCigar << ";B=" << b_parameters.outputBinary;
+        checkpoint.inputsig = ckptSignature(input.str());
+        checkpoint.alignsig = ckptSignature(stages.str(), checkpoint.inputsig);
+        if(!makeCheckpointDir(checkpoint))
+            return 1;
+    }
     int lower, upper; // reliable range lower and upper bound
     double ratioPhi;
-    Kmer::set_k(kmer_len);
-    size_t upperlimit = 10000000; // in bytes
+    Kmer::set_k(weight);
+    size_t upperlimit = 10000000; // in bytes, set by the memory plan
     Kmers kmervect;
     vector<string> seqs;
     vector<string> quals;
@@ -267,181 +467,330 @@ int main (int argc, char *argv[]) {
     cout << "Input k-mer file: " << kmer_file << endl;
 #endif
     cout << "K-mer counting: BELLA" << endl;
-    cout << "Output filename: " << out_file << endl;
+    if(!b_parameters.candidateFile.empty())
+        cout << "Candidate matrix: " << b_parameters.candidateFile << " (no alignment, see bella-align)" << endl;
+    else cout << "Output filename: " << out_file << endl;
     cout << "K-mer length: " << kmer_len << endl;
-    cout << "X-drop: " << xdrop << endl;
-    cout << "Depth: " << depth << "X" << endl;
+    if(b_parameters.spacedSeed.spaced())
+        cout << "Spaced seed: " << b_parameters.spacedSeed.mask << " (weight " << weight << ")" << endl;
+    if(depth > 0)
+        cout << "Depth: " << depth << "X" << endl;
+    else cout << "Depth: estimated from the k-mer spectrum" << endl;
     if(b_parameters.skipAlignment)
         cout << "Compute alignment: false" << endl;
     else cout << "Compute alignment: true" << endl;
+    if(b_parameters.homopolymer)
+        cout << "K-mers: homopolymer-compressed" << endl;
+    if(b_parameters.sampling.scheme)
+        cout << "Seed sampling: " << b_parameters.sampling.str() << " (expected density " << b_parameters.sampling.density(kmer_len) << ")" << endl;
     if(!b_parameters.allKmer)
         cout << "Seeding: two-kmer" << endl;
     else cout << "Seeding: all-kmer" << endl;
+    if(b_parameters.diagFilter)
+        cout << "Diagonal pre-filter: true" << endl;
+    if(!b_parameters.cascadeBands.empty())
+    {
+        cout << "Alignment cascade bands:";
+        for(int band : b_parameters.cascadeBands)
+            cout << " " << band;
+        cout << " | cut-off: " << b_parameters.cascadeCutoff << endl;
+    }
 #endif
 
     //
-    // Kmer file parsing, error estimation, reliable bounds computation, and k-mer dictionary creation
+    // Memory plan: counting passes, fastq blocks, output buffers and SpGEMM stages come from one budget
     //
+    memoryPlan_ plan;
+    size_t inputbytes = 0;
+    for(auto itr=allfiles.begin(); itr!=allfiles.end(); itr++)
+        inputbytes += itr->filesize;
+    planCounting(plan, estimateMemory(b_parameters), MAXTHREADS, inputbytes, !b_parameters.skipAlignment);
+    upperlimit = plan.fastqBlock;
+#ifdef PRINT
+    printPlan(plan, "startup");
+#endif
 
-    dictionary_t countsreliable;
-#ifdef JELLYFISH
-    // Reliable bounds computation for Jellyfish using default error rate
+    //
+    // Checkpoints (-S): a resumed run (-R) starts from the reads and matrices of a previous run with the same input
+    //
+
+    CSC<size_t,size_t> spmat;       // reads x reliable k-mers
+    CSC<size_t,size_t> transpmat;   // reliable k-mers x reads
     double all = omp_get_wtime();
-    lower = computeLower(depth,erate,kmer_len);
-    upper = computeUpper(depth,erate,kmer_len);
-    cout << "Error rate is " << erate << endl;
-    cout << "Reliable lower bound: " << lower << endl;
-    cout << "Reliable upper bound: " << upper << endl;
-    JellyFishCount(kmer_file, countsreliable, lower, upper);
+    bool resumed = checkpoint.resume && loadMatrices(checkpoint, reads, spmat, transpmat, lower, upper, erate);
+    if(resumed)
+    {
+        b_parameters.errorRate = erate;
+        cout << "\nReads and matrices restored from " << checkpoint.path(CKPT_MATRICES) << endl;
+#ifdef PRINT
+        cout << "Error rate estimate is " << erate << endl;
+        cout << "Reliable lower bound: " << lower << endl;
+        cout << "Reliable upper bound: " << upper << endl;
+        cout << "Total number of reads: " << reads.size() << "\n" << endl;
+#endif
+        if(!b_parameters.skipAlignment && b_parameters.candidateFile.empty())
+        {
+            #pragma omp parallel for
+            for(size_t i = 0; i < reads.size(); ++i)
+                encodeRead(reads[i]);
+        }
+        size_t bases = 0;
+        for(size_t i = 0; i < reads.size(); ++i)
+            bases += reads[i].seq.length();
+        planMatrices(plan, bases, reads.size(), spmat.cols, spmat.nnz, !b_parameters.skipAlignment);
+    }
+    else
+    {
+        //
+        // Kmer file parsing, error estimation, reliable bounds computation, and k-mer dictionary creation
+        //
+
+        dictionary_t countsreliable;
+#ifdef JELLYFISH
+        // Reliable bounds computation for Jellyfish using default error rate
+        lower = computeLower(depth,erate,weight);
+        upper = computeUpper(depth,erate,weight);
+        cout << "Error rate is " << erate << endl;
+        cout << "Reliable lower bound: " << lower << endl;
+        cout << "Reliable upper bound: " << upper << endl;
+        JellyFishCount(kmer_file, countsreliable, lower, upper);
+        b_parameters.errorRate = erate;
 
 #else
-    // Error estimation and reliabe bounds computation within denovo counting
-    cout << "\nRunning with up to " << MAXTHREADS << " threads" << endl;
-    double all = omp_get_wtime();
-    DeNovoCount(allfiles, countsreliable, lower, upper, kmer_len, depth, erate, upperlimit, b_parameters);
+        // Error estimation and reliabe bounds computation within denovo counting
+        if(checkpoint.resume && loadCounting(checkpoint, countsreliable, lower, upper, erate, plan))
+            cout << "\nReliable k-mers restored from " << checkpoint.path(CKPT_COUNTING) << endl;
+        else
+        {
+            cout << "\nRunning with up to " << MAXTHREADS << " threads" << endl;
+            telemetry.metric("depth_estimated", depth == 0);
+            DeNovoCount(allfiles, countsreliable, lower, upper, kmer_len, depth, erate, upperlimit, b_parameters, plan);
+            telemetry.metric("depth", depth);
+            if(checkpoint.enabled())
+                saveCounting(checkpoint, countsreliable, lower, upper, erate, plan);
+        }
+        b_parameters.errorRate = erate;
+
+        telemetry.metric("error_rate", erate);
+        telemetry.metric("reliable_lower", lower);
+        telemetry.metric("reliable_upper", upper);
+        telemetry.metric("kmer_cardinality", plan.cardinality);
+        telemetry.metric("counting_passes", plan.countingPasses);
+        telemetry.metric("flop_budget", b_parameters.flopBudget);
+        telemetry.metric("predicted_flops", plan.spectrumFlops);
 
 #ifdef PRINT
-    cout << "Error rate estimate is " << erate << endl;
-    cout << "Reliable lower bound: " << lower << endl;
-    cout << "Reliable upper bound: " << upper << endl;
-if(b_parameters.adapThr)
-{
-    ratioPhi = adaptiveSlope(erate);
-    cout << "Deviation from expected alignment score: " << b_parameters.deltaChernoff << endl;
-    cout << "Constant of adaptive threshold: " << ratioPhi*(1-b_parameters.deltaChernoff)<< endl;
-}
-else cout << "Default alignment score threshold: " << b_parameters.defaultThr << endl;
-if(b_parameters.alignEnd)
-{
-    cout << "Constraint: alignment on edge with a margin of " << b_parameters.relaxMargin << " bps" << endl;
-}
+        cout << "Error rate estimate is " << erate << endl;
+        cout << "Reliable lower bound: " << lower << endl;
+        cout << "Reliable upper bound: " << upper << endl;
 #endif // PRINT
 #endif // DENOVO COUNTING
 
-    //
-    // Fastq(s) parsing
-    //
+        //
+        // Fastq(s) parsing
+        //
 
-    double parsefastq = omp_get_wtime();
-    size_t read_id = 0; // read_id needs to be global (not just per file)
+        double parsefastq = omp_get_wtime();
+        telemetry.begin("fastq parsing");
+        size_t read_id = 0; // read_id needs to be global (not just per file)
 
 #ifdef PRINT
-    cout << "\nRunning with up to " << MAXTHREADS << " threads" << endl;
+        cout << "\nRunning with up to " << MAXTHREADS << " threads" << endl;
 #endif
 
-    vector < vector<tuple<int,int,int>> > alloccurrences(MAXTHREADS);   
-    vector < vector<tuple<int,int,int>> > alltranstuples(MAXTHREADS);   
-    vector < readVector_ > allreads(MAXTHREADS);
+        vector < vector<tuple<int,int,int>> > alloccurrences(MAXTHREADS);   
+        vector < vector<tuple<int,int,int>> > alltranstuples(MAXTHREADS);   
+        vector < readVector_ > allreads(MAXTHREADS);
 
-    for(auto itr=allfiles.begin(); itr!=allfiles.end(); itr++)
-    {
+        for(auto itr=allfiles.begin(); itr!=allfiles.end(); itr++)
+        {
 
-        ParallelFASTQ *pfq = new ParallelFASTQ();
-        pfq->open(itr->filename, false, itr->filesize);
+            ParallelFASTQ *pfq = new ParallelFASTQ();
+            pfq->open(itr->filename, false, itr->filesize);
 
-        size_t fillstatus = 1;
-        while(fillstatus)
-        { 
-            fillstatus = pfq->fill_block(nametags, seqs, quals, upperlimit);
-            size_t nreads = seqs.size();
+            size_t fillstatus = 1;
+            while(fillstatus)
+            { 
+                fillstatus = pfq->fill_block(nametags, seqs, quals, upperlimit);
+                size_t nreads = seqs.size();
 
-            #pragma omp parallel for
-            for(int i=0; i<nreads; i++) 
-            {
-                // remember that the last valid position is length()-1
-                int len = seqs[i].length();
-
-                readType_ temp;
-                nametags[i].erase(nametags[i].begin());     // removing "@"
-                temp.nametag = nametags[i];
-                temp.seq = seqs[i];     // save reads for seeded alignment
-                temp.readid = read_id+i;
-
-                allreads[MYTHREAD].push_back(temp);
-                        
-                for(int j=0; j<=len-kmer_len; j++)  
+                #pragma omp parallel for
+                for(int i=0; i<nreads; i++) 
                 {
-                    std::string kmerstrfromfastq = seqs[i].substr(j, kmer_len);
-                    Kmer mykmer(kmerstrfromfastq.c_str());
-                    // remember to use only ::rep() when building kmerdict as well
-                    Kmer lexsmall = mykmer.rep();
-
-                    int idx; // kmer_id
-                    auto found = countsreliable.find(lexsmall,idx);
-                    if(found)
+                    readType_ temp;
+                    nametags[i].erase(nametags[i].begin());     // removing "@"
+                    temp.nametag = nametags[i];
+                    temp.seq = seqs[i];     // save reads for seeded alignment
+                    temp.readid = read_id+i;
+
+                    allreads[MYTHREAD].push_back(temp);
+
+                    // with -P the k-mers come from the homopolymer-compressed read, runstart maps them back to the read
+                    string hpc;
+                    vector<int> runstart;
+                    if(b_parameters.homopolymer)
+                        compressHomopolymers(seqs[i], hpc, runstart);
+                    const string & kseq = b_parameters.homopolymer ? hpc : seqs[i];
+                    vector<uint64_t> codes; // spaced k-mers (-T)
+                    if(b_parameters.spacedSeed.spaced())
+                        spacedCodes(kseq, b_parameters.spacedSeed, codes);
+
+                    vector<int> positions;  // the k-mers sampled when counting
+                    selectSeeds(kseq, kmer_len, b_parameters.sampling, [&](int j)
+                        { return readKmer(kseq, j, kmer_len, b_parameters.spacedSeed, codes).rep().hash(); }, positions);
+                    for(int j : positions)
                     {
-                        alloccurrences[MYTHREAD].emplace_back(std::make_tuple(read_id+i,idx,j)); // vector<tuple<read_id,kmer_id,kmerpos>>
-                        alltranstuples[MYTHREAD].emplace_back(std::make_tuple(idx,read_id+i,j)); // transtuples.push_back(col_id,row_id,kmerpos)
+                        Kmer mykmer = readKmer(kseq, j, kmer_len, b_parameters.spacedSeed, codes);
+                        // remember to use only ::rep() when building kmerdict as well
+                        Kmer lexsmall = mykmer.rep();
+
+                        int idx; // kmer_id
+                        auto found = countsreliable.find(lexsmall,idx);
+                        if(found)
+                        {
+                            int pos = b_parameters.homopolymer ? runstart[j] : j;
+                            alloccurrences[MYTHREAD].emplace_back(std::make_tuple(read_id+i,idx,pos)); // vector<tuple<read_id,kmer_id,kmerpos>>
+                            alltranstuples[MYTHREAD].emplace_back(std::make_tuple(idx,read_id+i,pos)); // transtuples.push_back(col_id,row_id,kmerpos)
+                        }
                     }
-                }
-            } // for(int i=0; i<nreads; i++)
-            //cout << "total number of reads processed so far is " << read_id << endl;
-            read_id += nreads;
-        } //while(fillstatus) 
-        delete pfq;
-    } // for all files
-
-    size_t readcount = 0;
-    size_t tuplecount = 0;
-    for(int t=0; t<MAXTHREADS; ++t)
-    {
-        readcount += allreads[t].size();
-        tuplecount += alloccurrences[t].size();
-    }
-    reads.resize(readcount);
-    occurrences.resize(tuplecount);
-    transtuples.resize(tuplecount);
+                } // for(int i=0; i<nreads; i++)
+                //cout << "total number of reads processed so far is " << read_id << endl;
+                read_id += nreads;
+            } //while(fillstatus) 
+            delete pfq;
+        } // for all files
+
+        size_t readcount = 0;
+        size_t tuplecount = 0;
+        for(int t=0; t<MAXTHREADS; ++t)
+        {
+            readcount += allreads[t].size();
+            tuplecount += alloccurrences[t].size();
+        }
+        reads.resize(readcount);
+        occurrences.resize(tuplecount);
+        transtuples.resize(tuplecount);
+
+        size_t readssofar = 0;
+        size_t tuplesofar = 0;
+        for(int t=0; t<MAXTHREADS; ++t)
+        {
+            copy(allreads[t].begin(), allreads[t].end(), reads.begin()+readssofar);
+            readssofar += allreads[t].size();
+
+            copy(alloccurrences[t].begin(), alloccurrences[t].end(), occurrences.begin() + tuplesofar);
+            copy(alltranstuples[t].begin(), alltranstuples[t].end(), transtuples.begin() + tuplesofar);
+            tuplesofar += alloccurrences[t].size();
+            std::vector<tuple<int,int,int>>().swap(alloccurrences[t]);   // merged: free the per-thread copies
+            std::vector<tuple<int,int,int>>().swap(alltranstuples[t]);
+            readVector_().swap(allreads[t]);
+        }
 
-    size_t readssofar = 0;
-    size_t tuplesofar = 0;
-    for(int t=0; t<MAXTHREADS; ++t)
-    {
-        copy(allreads[t].begin(), allreads[t].end(), reads.begin()+readssofar);
-        readssofar += allreads[t].size();
+        std::sort(reads.begin(), reads.end());   // bool operator in global.h: sort by readid
 
-        copy(alloccurrences[t].begin(), alloccurrences[t].end(), occurrences.begin() + tuplesofar);
-        copy(alltranstuples[t].begin(), alltranstuples[t].end(), transtuples.begin() + tuplesofar);
-        tuplesofar += alloccurrences[t].size();
-    }
+        if(!b_parameters.skipAlignment && b_parameters.candidateFile.empty())
+        {
+            #pragma omp parallel for
+            for(size_t i = 0; i < reads.size(); ++i)
+                encodeRead(reads[i]);           // each read (and its reverse complement) is encoded only once for the alignment
+        }
+        size_t bases = 0;
+        for(size_t i = 0; i < reads.size(); ++i)
+            bases += reads[i].seq.length();
+        planMatrices(plan, bases, readcount, countsreliable.size(), tuplecount, !b_parameters.skipAlignment);
+#ifdef PRINT
+        printPlan(plan, "matrix construction");
+#endif
+        std::vector<string>().swap(seqs);        // free memory of seqs  
+        std::vector<string>().swap(quals);       // free memory of quals
 
-    std::sort(reads.begin(), reads.end());   // bool operator in global.h: sort by readid
-    std::vector<string>().swap(seqs);        // free memory of seqs  
-    std::vector<string>().swap(quals);       // free memory of quals
+        telemetry.end();
+        telemetry.metric("reads", readcount);
+        telemetry.metric("bases", bases);
+        telemetry.metric("reliable_kmers", countsreliable.size());
+        telemetry.metric("nnz_a", tuplecount);
+        telemetry.metric("seed_density", b_parameters.sampling.density(kmer_len));
 
 #ifdef PRINT
-    cout << "Fastq(s) parsing fastq took: " << omp_get_wtime()-parsefastq << "s" << endl;
-    cout << "Total number of reads: "<< read_id << "\n"<< endl;
+        cout << "Fastq(s) parsing fastq took: " << omp_get_wtime()-parsefastq << "s" << endl;
+        cout << "Total number of reads: "<< read_id << "\n"<< endl;
 #endif
 
-    //
-    // Sparse matrices construction
-    //
+        //
+        // Sparse matrices construction
+        //
+
+        double matcreat = omp_get_wtime();
+        telemetry.begin("matrix construction");
+
+        size_t nkmer = countsreliable.size();
+        spmat = CSC<size_t,size_t>(occurrences, read_id, nkmer, 
+                                [] (size_t & p1, size_t & p2) 
+                                {  
+                                    return p1;
+                                });
+        std::vector<tuple<size_t,size_t,size_t>>().swap(occurrences); // remove memory of occurences
+
+        transpmat = CSC<size_t,size_t>(transtuples, nkmer, read_id, 
+                                [] (size_t & p1, size_t & p2) 
+                                {  return p1;
+                                });
+        std::vector<tuple<size_t,size_t,size_t>>().swap(transtuples); // remove memory of transtuples
+        countsreliable.clear();     // k-mer ids are in the matrices now
+        telemetry.end();
 
-    double matcreat = omp_get_wtime();
+#ifdef PRINT
+        cout << "Sparse matrix construction took: " << omp_get_wtime()-matcreat << "s\n" << endl;
+#endif
+        if(checkpoint.enabled())
+            saveMatrices(checkpoint, reads, spmat, transpmat, lower, upper, erate);
+    }
 
-    size_t nkmer = countsreliable.size();
-    CSC<size_t,size_t> spmat(occurrences, read_id, nkmer, 
-                            [] (size_t & p1, size_t & p2) 
-                            {  
-                                return p1;
-                            });
-    std::vector<tuple<size_t,size_t,size_t>>().swap(occurrences); // remove memory of occurences
+#ifdef PRINT
+if(b_parameters.adapThr)
+{
+    ratioPhi = adaptiveSlope(erate);
+    cout << "Deviation from expected alignment score: " << b_parameters.deltaChernoff << endl;
+    cout << "Constant of adaptive threshold: " << ratioPhi*(1-b_parameters.deltaChernoff)<< endl;
+}
+else cout << "Default alignment score threshold: " << b_parameters.defaultThr << endl;
+if(b_parameters.alignEnd)
+{
+    cout << "Constraint: alignment on edge with a margin of " << b_parameters.relaxMargin << " bps" << endl;
+}
+#endif // PRINT
 
-    CSC<size_t,size_t> transpmat(transtuples, nkmer, read_id, 
-                            [] (size_t & p1, size_t & p2) 
-                            {  return p1;
-                            });
-    std::vector<tuple<size_t,size_t,size_t>>().swap(transtuples); // remove memory of transtuples
+    //
+    // Output: the stages kept by a resumed run stay in the output file, the next ones are appended
+    //
 
-#ifdef PRINT
-    cout << "Sparse matrix construction took: " << omp_get_wtime()-matcreat << "s\n" << endl;
-#endif
+    StageLog stagelog;
+    if(checkpoint.enabled() && b_parameters.candidateFile.empty())
+    {
+        struct stat st;
+        uint64_t outputsize = (stat(out_file, &st) == 0) ? st.st_size : 0;
+        if(!stagelog.open(checkpoint, outputsize))
+            cout << "Stage checkpoints disabled" << endl;
+    }
+    if(stagelog.done() > 0)
+    {
+        if(truncate(out_file, stagelog.outputBytes()) != 0)     // drop the output of the stage that was interrupted
+        {
+            fprintf(stderr, "File %s cannot be truncated\n", out_file);
+            return 1;
+        }
+    }
+    else if(b_parameters.candidateFile.empty())
+    {
+        remove(out_file);   // delete file to avoid errors in output
+        if(b_parameters.outputBinary && !writeOverlapHeader(out_file, reads))
+            return 1;
+    }
 
     //
     // Overlap detection (sparse matrix multiplication) and seed-and-extend alignment
     //
 
-    spmatPtr_ getvaluetype(make_shared<spmatType_>());
     HashSpGEMM(spmat, transpmat, 
             [] (size_t & pi, size_t & pj)                     // n-th k-mer positions on read i and on read j
             {   spmatPtr_ value(make_shared<spmatType_>());
@@ -482,8 +831,11 @@ if(b_parameters.alignEnd)
                     }
                 }
                 return m2;
-            }, reads, getvaluetype, kmer_len, xdrop, out_file, b_parameters, ratioPhi); 
+            }, reads, kmer_len, out_file, b_parameters, ratioPhi, plan, stagelog); 
 
     cout << "Total running time: " << omp_get_wtime()-all << "s\n" << endl;
+    telemetry.metric("total_s", omp_get_wtime()-all);
+    if(telemetry.enabled && telemetry.write())
+        cout << "Performance report written to " << json_file << endl;
     return 0;
 } 
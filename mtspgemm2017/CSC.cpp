@@ -28,19 +28,75 @@ CSC<IT,NT>::CSC (const CSC<IT,NT> & rhs): nnz(rhs.nnz), rows(rhs.rows), cols(rhs
 	}
 }
 
+// move constructor: takes the arrays of rhs, which is left empty
+template <class IT, class NT>
+CSC<IT,NT>::CSC (CSC<IT,NT> && rhs): nnz(rhs.nnz), rows(rhs.rows), cols(rhs.cols), colptr(rhs.colptr), rowids(rhs.rowids), values(rhs.values)
+{
+	std::swap(mapping, rhs.mapping);
+	std::swap(mappedbytes, rhs.mappedbytes);
+	rhs.nnz = 0;
+	rhs.cols = 0;
+}
+
+// move assignment: swaps the arrays, those of this object are released with rhs
+template <class IT, class NT>
+CSC<IT,NT> & CSC<IT,NT>::operator= (CSC<IT,NT> && rhs)
+{
+	std::swap(nnz, rhs.nnz);
+	std::swap(rows, rhs.rows);
+	std::swap(cols, rhs.cols);
+	std::swap(colptr, rhs.colptr);
+	std::swap(rowids, rhs.rowids);
+	std::swap(values, rhs.values);
+	std::swap(mapping, rhs.mapping);
+	std::swap(mappedbytes, rhs.mappedbytes);
+	return *this;
+}
+
+// zero-copy: the arrays point into the mapped file, shared with every process that maps it
+template <class IT, class NT>
+CSC<IT,NT>::CSC (const string & filename): rows(0), cols(0), nnz(0)
+{
+	matrixFileHeader_ header;
+	void * base = mapMatrixFile<IT,NT>(filename, MATRIX_CSC, header, mappedbytes);
+	if(base == NULL)
+		return;
+	mapping = base;
+	rows = header.rows;
+	cols = header.cols;
+	nnz = header.nnz;
+	colptr = reinterpret_cast<IT*>((char*)base + header.ptroffset);
+	rowids = reinterpret_cast<IT*>((char*)base + header.idxoffset);
+	values = reinterpret_cast<NT*>((char*)base + header.valoffset);
+}
+
+template <class IT, class NT>
+bool CSC<IT,NT>::WriteBinary(const string & filename) const
+{
+	return writeMatrixFile<IT,NT>(filename, MATRIX_CSC, rows, cols, nnz, colptr, rowids, values);
+}
+
 template <class IT, class NT>
 CSC<IT,NT> & CSC<IT,NT>::operator= (const CSC<IT,NT> & rhs) 
 {
 	if(this != &rhs)		
 	{
-		if(nnz > 0)	// if the existing object is not empty
+		if(mapping != nullptr)	// a mapped file is released, not deleted
 		{
-			delete [] rowids;   // empty it
-			delete [] values;
+			munmap(mapping, mappedbytes);
+			mapping = nullptr;
 		}
-		if(cols > 0)
+		else
 		{
-			delete [] colptr;
+			if(nnz > 0)	// if the existing object is not empty
+			{
+				delete [] rowids;   // empty it
+				delete [] values;
+			}
+			if(cols > 0)
+			{
+				delete [] colptr;
+			}
 		}
 
 		nnz	= rhs.nnz;
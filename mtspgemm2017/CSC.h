@@ -11,6 +11,7 @@
 #include "HeapEntry.h"
 
 #include "Triple.h"
+#include "matrixfile.h"
 extern "C" {
 #include "GTgraph/R-MAT/graph.h"
 }
@@ -21,7 +22,7 @@ template <class IT, class NT> // IT, NT li dichiaro runtime (polimorfismo parame
 class CSC
 {
 public:
-    CSC():nnz(0), rows(0), cols(0) {}
+    CSC():rows(0), cols(0), nnz(0) {}
     CSC(IT mynnz, IT m, IT n, int nt):nnz(mynnz),rows(m),cols(n) // costruttore di default 
     {
         // Constructing empty Csc objects (size = 0) are not allowed.
@@ -43,16 +44,25 @@ public:
     CSC (IT * ri, IT * ci, NT * val, IT mynnz, IT m, IT n);
     CSC (const CSC<IT,NT> & rhs);		// copy constructor
     CSC<IT,NT> & operator=(const CSC<IT,NT> & rhs);	// assignment operator
+    CSC (CSC<IT,NT> && rhs);		// move constructor
+    CSC<IT,NT> & operator=(CSC<IT,NT> && rhs);	// move assignment
+    CSC (const string & filename);	// maps a matrix file written by WriteBinary (read-only, empty on error)
+    bool WriteBinary(const string & filename) const;	// matrix file, see matrixfile.h
     bool operator==(const CSC<IT,NT> & rhs); // ridefinizione ==
     //template <typename FT> CSC<IT,FT> & operator=(const CSC<IT,FT> & rhs);	// assignment operator
     //template <typename FT> bool operator==(const CSC<IT,FT> & rhs); // ridefinizione ==
     
     ~CSC() // distruttore
     {
-        if( nnz > 0 )
-            DeleteAll(rowids, values);
-        if( cols > 0 )
-            delete [] colptr;
+        if( mapping != nullptr )
+            munmap(mapping, mappedbytes);
+        else
+        {
+            if( nnz > 0 )
+                DeleteAll(rowids, values);
+            if( cols > 0 )
+                delete [] colptr;
+        }
     }
 
     class ScalarReadSaveHandler
@@ -75,6 +85,10 @@ public:
     {
         return ( nnz == 0 );
     }
+    bool isMapped() const
+    {
+        return ( mapping != nullptr );
+    }
     void Sorted();
     CSC<IT,NT> SpRef (const vector<IT> & ri, const vector<IT> & ci);
     CSC<IT,NT> SpRef1 (const vector<IT> & ri, const vector<IT> & ci);
@@ -91,6 +105,9 @@ public:
     IT * colptr;
     IT * rowids;
     NT * values;
+
+    void * mapping = nullptr;   // matrix file the arrays point into, they must not be modified then
+    size_t mappedbytes = 0;
 };
 
 #include "CSC.cpp"
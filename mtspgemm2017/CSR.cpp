@@ -19,19 +19,50 @@ CSR<IT,NT>::CSR (const CSR<IT,NT> & rhs): nnz(rhs.nnz), rows(rhs.rows), cols(rhs
 	}
 }
 
+// zero-copy: the arrays point into the mapped file, shared with every process that maps it
+template <class IT, class NT>
+CSR<IT,NT>::CSR (const string & filename): rows(0), cols(0), nnz(0), zerobased(true)
+{
+	matrixFileHeader_ header;
+	void * base = mapMatrixFile<IT,NT>(filename, MATRIX_CSR, header, mappedbytes);
+	if(base == NULL)
+		return;
+	mapping = base;
+	rows = header.rows;
+	cols = header.cols;
+	nnz = header.nnz;
+	rowptr = reinterpret_cast<IT*>((char*)base + header.ptroffset);
+	colids = reinterpret_cast<IT*>((char*)base + header.idxoffset);
+	values = reinterpret_cast<NT*>((char*)base + header.valoffset);
+}
+
+template <class IT, class NT>
+bool CSR<IT,NT>::WriteBinary(const string & filename) const
+{
+	return writeMatrixFile<IT,NT>(filename, MATRIX_CSR, rows, cols, nnz, rowptr, colids, values);
+}
+
 template <class IT, class NT>
 CSR<IT,NT> & CSR<IT,NT>::operator= (const CSR<IT,NT> & rhs)
 {
 	if(this != &rhs)		
 	{
-		if(nnz > 0)	// if the existing object is not empty
+		if(mapping != nullptr)	// a mapped file is released, not deleted
 		{
-			delete [] colids;   // empty it
-			delete [] values;
+			munmap(mapping, mappedbytes);
+			mapping = nullptr;
 		}
-		if(rows > 0)
+		else
 		{
-			delete [] rowptr;
+			if(nnz > 0)	// if the existing object is not empty
+			{
+				delete [] colids;   // empty it
+				delete [] values;
+			}
+			if(rows > 0)
+			{
+				delete [] rowptr;
+			}
 		}
 
 		nnz	= rhs.nnz;
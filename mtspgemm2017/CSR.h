@@ -32,13 +32,20 @@ public:
     CSR (const CSC<IT,NT> & csc);   // CSC -> CSR conversion
     CSR (const CSR<IT,NT> & rhs);	// copy constructor
 	CSR<IT,NT> & operator=(const CSR<IT,NT> & rhs);	// assignment operator
+    CSR (const string & filename);	// maps a matrix file written by WriteBinary (read-only, empty on error)
+    bool WriteBinary(const string & filename) const;	// matrix file, see matrixfile.h
     
     ~CSR()
 	{
-        if( nnz > 0 )
-            DeleteAll(colids, values);
-        if( rows > 0 )
-            delete [] rowptr;
+        if( mapping != nullptr )
+            munmap(mapping, mappedbytes);
+        else
+        {
+            if( nnz > 0 )
+                DeleteAll(colids, values);
+            if( rows > 0 )
+                delete [] rowptr;
+        }
 	}
     bool ConvertOneBased()
     {
@@ -63,6 +70,9 @@ public:
     IT * colids;
     NT * values;
     bool zerobased;
+
+    void * mapping = nullptr;   // matrix file the arrays point into, they must not be modified then
+    size_t mappedbytes = 0;
 };
 
 #include "CSR.cpp"
@@ -23,33 +23,388 @@
 #include <math.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <climits>
 
 using namespace seqan;
 using namespace std;
 
-typedef Align<Dna5String, ArrayGaps> TAlign;     // align type
+/**
+ * @brief alignSpan_ is the region covered by an extension already computed for the current read pair
+ */
+struct alignSpan_ {
+    char strand;
+    int diag;                   // diagonal of the seed the extension started from
+    int begH, endH, begV, endV; // positions on the strand of the alignment
+};
+
+/**
+ * @brief alignContext_ holds the per-thread buffers reused across all the pairs aligned by a thread
+ */
+struct alignContext_ {
+    std::vector<int> score;     // one DP row
+    std::vector<int> begH;      // row position where the path ending in each cell begins
+    std::vector<int> begV;      // column position where the path ending in each cell begins
+    std::vector<alignSpan_> spans;  // memo of the extensions of the current pair (cleared for every new pair)
+    std::vector<std::pair<int,int>> seeds;  // seeds of the current pair in the order they are extended (diagonalFilter)
+};
 
-TSeed retrieveSeed(TAlign &align)
+/**
+ * @brief encodeRead converts the read to Dna5 once, along with its reverse complement
+ */
+void encodeRead(readType_ & read)
+{
+    read.dna5 = read.seq;
+    read.dna5rc = read.dna5;
+    reverseComplement(read.dna5rc);
+}
+
+/**
+ * @brief overlapScoreOnly computes the overlap alignment (free end gaps, match 1, mismatch/gap -1) in linear memory:
+ * instead of a traceback, each cell carries the position where its best path begins
+ * @param seqH
+ * @param seqV
+ * @param ctx per-thread buffers
+ * @param seed returns the begin/end positions of the best alignment
+ * @return alignment score
+ */
+int overlapScoreOnly(const Dna5String & seqH, const Dna5String & seqV, alignContext_ & ctx, TSeed & seed)
 {
-    unsigned int start[2] = {0};
-    unsigned int end[2] = {0};
-
-    for(int seq_id = 0; seq_id < 2; seq_id++) {
-        unsigned int pos = 0;
-        bool started = false;
-        for (auto gap: row(align, seq_id)) {
-            if(gap != '-') {
-                started = true;
-                end[seq_id] = pos;
+    int n = length(seqH);
+    int m = length(seqV);
+
+    if(ctx.score.size() < (size_t)m+1)
+    {
+        ctx.score.resize(m+1);
+        ctx.begH.resize(m+1);
+        ctx.begV.resize(m+1);
+    }
+    int * score = ctx.score.data();
+    int * begH = ctx.begH.data();
+    int * begV = ctx.begV.data();
+
+    for(int j = 0; j <= m; ++j)     // leading gaps are free
+    {
+        score[j] = 0;
+        begH[j] = 0;
+        begV[j] = j;
+    }
+
+    int best = 0, bestBegH = 0, bestBegV = m, bestEndH = 0, bestEndV = m;
+
+    for(int i = 1; i <= n; ++i)
+    {
+        int diagScore = score[0], diagBegH = begH[0], diagBegV = begV[0];
+        score[0] = 0;
+        begH[0] = i;
+        begV[0] = 0;
+
+        auto h = ordValue(seqH[i-1]);
+        for(int j = 1; j <= m; ++j)
+        {
+            int upScore = score[j], upBegH = begH[j], upBegV = begV[j];
+
+            int cell = diagScore + ((h == ordValue(seqV[j-1])) ? 1 : -1);
+            int cellBegH = diagBegH, cellBegV = diagBegV;
+            if(upScore-1 > cell)
+            {
+                cell = upScore-1;
+                cellBegH = upBegH;
+                cellBegV = upBegV;
+            }
+            if(score[j-1]-1 > cell)
+            {
+                cell = score[j-1]-1;
+                cellBegH = begH[j-1];
+                cellBegV = begV[j-1];
             }
-            if (!started) {
-                start[seq_id]++;
+
+            score[j] = cell;
+            begH[j] = cellBegH;
+            begV[j] = cellBegV;
+
+            diagScore = upScore;
+            diagBegH = upBegH;
+            diagBegV = upBegV;
+        }
+
+        if(score[m] > best)     // trailing gaps are free: last column
+        {
+            best = score[m];
+            bestBegH = begH[m]; bestBegV = begV[m];
+            bestEndH = i; bestEndV = m;
+        }
+    }
+    for(int j = 0; j <= m; ++j) // trailing gaps are free: last row
+    {
+        if(score[j] > best)
+        {
+            best = score[j];
+            bestBegH = begH[j]; bestBegV = begV[j];
+            bestEndH = n; bestEndV = j;
+        }
+    }
+
+    seed = TSeed(bestBegH, bestBegV, bestEndH, bestEndV);
+    return best;
+}
+
+/**
+ * @brief overlapScoreBanded is overlapScoreOnly restricted to the diagonals [diag-halfBand, diag+halfBand] (diagonal = V pos - H pos)
+ * It stops as soon as no cell can reach a score above minScore anymore: the bound of each cell is its score plus
+ * one match for every base left on the shorter remaining suffix
+ * @param seqH
+ * @param seqV
+ * @param diag diagonal of the seed on the strand of seqH
+ * @param halfBand
+ * @param minScore score the alignment must exceed to be useful
+ * @param ctx per-thread buffers
+ * @param seed returns the begin/end positions of the best alignment found
+ * @param earlyExit set to true if the extension stopped because minScore could not be exceeded
+ * @param cells number of DP cells computed
+ * @return alignment score
+ */
+int overlapScoreBanded(const Dna5String & seqH, const Dna5String & seqV, int diag, int halfBand, int minScore, alignContext_ & ctx,
+        TSeed & seed, bool & earlyExit, size_t & cells)
+{
+    const int NEG = INT_MIN/2;
+    int n = length(seqH);
+    int m = length(seqV);
+
+    if(ctx.score.size() < (size_t)m+1)
+    {
+        ctx.score.resize(m+1);
+        ctx.begH.resize(m+1);
+        ctx.begV.resize(m+1);
+    }
+    int * score = ctx.score.data();
+    int * begH = ctx.begH.data();
+    int * begV = ctx.begV.data();
+
+    auto inBand = [&](int i, int j) { return (j-i >= diag-halfBand) && (j-i <= diag+halfBand); };
+
+    earlyExit = false;
+    cells = 0;
+    int best = 0, bestBegH = 0, bestBegV = m, bestEndH = 0, bestEndV = m;
+    int prevlo = 1, prevhi = 0;     // columns computed in the previous row (none yet, row 0 is the free boundary)
+
+    for(int i = 1; i <= n; ++i)
+    {
+        int lo = max(1, i+diag-halfBand);
+        int hi = min(m, i+diag+halfBand);
+        if(lo > hi)
+        {
+            if(lo > m) break;       // the band left the matrix
+            continue;               // the band has not entered it yet
+        }
+
+        // value of the cell up-left of the first one
+        int diagScore = NEG, diagBegH = 0, diagBegV = 0;
+        if(i-1 == 0 || lo-1 == 0)
+        {
+            if(inBand(i-1, lo-1)) { diagScore = 0; diagBegH = i-1; diagBegV = lo-1; }
+        }
+        else if(lo-1 >= prevlo && lo-1 <= prevhi)
+        {
+            diagScore = score[lo-1]; diagBegH = begH[lo-1]; diagBegV = begV[lo-1];
+        }
+        // value of the cell left of the first one
+        int leftScore = NEG, leftBegH = 0, leftBegV = 0;
+        if(lo-1 == 0 && inBand(i, 0)) { leftScore = 0; leftBegH = i; leftBegV = 0; }
+
+        auto h = ordValue(seqH[i-1]);
+        int bound = NEG;
+        for(int j = lo; j <= hi; ++j)
+        {
+            int upScore = NEG, upBegH = 0, upBegV = 0;
+            if(i-1 == 0)
+            {
+                if(inBand(0, j)) { upScore = 0; upBegH = 0; upBegV = j; }
+            }
+            else if(j >= prevlo && j <= prevhi)
+            {
+                upScore = score[j]; upBegH = begH[j]; upBegV = begV[j];
+            }
+
+            int cell = diagScore + ((h == ordValue(seqV[j-1])) ? 1 : -1);
+            int cellBegH = diagBegH, cellBegV = diagBegV;
+            if(upScore-1 > cell)
+            {
+                cell = upScore-1;
+                cellBegH = upBegH;
+                cellBegV = upBegV;
+            }
+            if(leftScore-1 > cell)
+            {
+                cell = leftScore-1;
+                cellBegH = leftBegH;
+                cellBegV = leftBegV;
+            }
+
+            score[j] = cell;
+            begH[j] = cellBegH;
+            begV[j] = cellBegV;
+
+            diagScore = upScore; diagBegH = upBegH; diagBegV = upBegV;
+            leftScore = cell; leftBegH = cellBegH; leftBegV = cellBegV;
+
+            bound = max(bound, cell + min(n-i, m-j));
+            if(i == n && cell > best)   // trailing gaps are free: last row
+            {
+                best = cell;
+                bestBegH = cellBegH; bestBegV = cellBegV;
+                bestEndH = i; bestEndV = j;
+            }
+        }
+        cells += hi-lo+1;
+
+        if(hi == m && score[m] > best)  // trailing gaps are free: last column
+        {
+            best = score[m];
+            bestBegH = begH[m]; bestBegV = begV[m];
+            bestEndH = i; bestEndV = m;
+        }
+
+        prevlo = lo;
+        prevhi = hi;
+
+        // paths can still start on the first column while it is inside the band
+        if(inBand(i+1, 0))
+            bound = max(bound, min(n-i-1, m));
+        if(max(best, bound) <= minScore)
+        {
+            earlyExit = true;
+            break;
+        }
+    }
+
+    seed = TSeed(bestBegH, bestBegV, bestEndH, bestEndV);
+    return best;
+}
+
+/**
+ * @brief seedCovered tells whether a seed lies inside an extension already computed for the current pair
+ * on the same strand and within diagTolerance diagonals of it, in which case extending it would redo the same DP
+ * @param ctx per-thread context holding the memo
+ * @param strand
+ * @param diag seed diagonal
+ * @param iH seed position on the row read, on the strand of the alignment
+ * @param j seed position on the column read
+ * @param kmer_len
+ * @param diagTolerance
+ */
+bool seedCovered(const alignContext_ & ctx, char strand, int diag, int iH, int j, int kmer_len, int diagTolerance)
+{
+    for(const alignSpan_ & span : ctx.spans)
+    {
+        if(span.strand == strand && abs(span.diag - diag) <= diagTolerance &&
+                iH >= span.begH && iH+kmer_len <= span.endH && j >= span.begV && j+kmer_len <= span.endV)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief recordSpan adds the region of an extension to the memo of the current pair
+ */
+void recordSpan(alignContext_ & ctx, char strand, int diag, const TSeed & seed)
+{
+    alignSpan_ span = {strand, diag, (int)beginPositionH(seed), (int)endPositionH(seed), (int)beginPositionV(seed), (int)endPositionV(seed)};
+    ctx.spans.push_back(span);
+}
+
+/**
+ * @brief lazyCigar recomputes the traceback of an accepted overlap: global alignment (match 1, mismatch/gap -1) of the
+ * block found by the score-only pass, whose optimum is the overlap score. The DP is restricted to a band of diagonals
+ * that is doubled until no path leaving it can beat the banded optimum, so memory is one byte per cell of the band
+ * @param seqH row read on the strand used for the alignment (target)
+ * @param seqV column read (query)
+ * @param begH, endH, begV, endV block of the alignment
+ * @param reverse seqH is the reverse complement of the row read: the CIGAR is written for the forward row read against
+ * the reverse complement of seqV, which is the same alignment read backwards (PAF convention for '-' pairs)
+ * @param cigar returns the CIGAR of the block, seqV is the query
+ * @return score of the CIGAR
+ */
+int lazyCigar(const Dna5String & seqH, const Dna5String & seqV, int begH, int endH, int begV, int endV, bool reverse,
+        std::string & cigar)
+{
+    const int NEG = INT_MIN/2;
+    int n = endH - begH;
+    int m = endV - begV;
+
+    std::vector<int> prev, cur;
+    std::vector<unsigned char> trace;   // 0: diagonal, 1: base of seqH only, 2: base of seqV only
+    int lo, width, half = 32, best;
+    while(true)
+    {
+        // diagonals j-i in [lo, hi], both corners included
+        lo = min(0, m-n) - half;
+        int hi = max(0, m-n) + half;
+        width = hi-lo+1;
+        prev.assign(width+1, NEG);
+        cur.assign(width+1, NEG);
+        trace.assign((size_t)(n+1) * width, 0);
+
+        for(int i = 0; i <= n; ++i)
+        {
+            unsigned char * t = trace.data() + (size_t)i * width;
+            for(int k = 0; k < width; ++k)
+            {
+                int j = i+lo+k;
+                if(j < 0 || j > m)
+                {
+                    cur[k] = NEG;
+                    continue;
+                }
+                if(i == 0 || j == 0)
+                {
+                    cur[k] = -(i+j);
+                    t[k] = (i == 0) ? 2 : 1;
+                    continue;
+                }
+                int cell = prev[k] + ((ordValue(seqH[begH+i-1]) == ordValue(seqV[begV+j-1])) ? 1 : -1);
+                unsigned char move = 0;
+                if(prev[k+1]-1 > cell) { cell = prev[k+1]-1; move = 1; }    // prev[width] stays NEG
+                if(k > 0 && cur[k-1]-1 > cell) { cell = cur[k-1]-1; move = 2; }
+                cur[k] = cell;
+                t[k] = move;
             }
-            pos++;
+            prev.swap(cur);
         }
+        best = prev[m-n-lo];
+
+        if(lo <= -n && hi >= m)
+            break;
+        // a path reaching diagonal lo-1 or hi+1 has at least this many gaps, and at most one match per other base pair
+        int gaps = min((m-n) - 2*(lo-1), 2*(hi+1) - (m-n));
+        if(best >= (n+m-gaps)/2 - gaps)
+            break;
+        half *= 2;
+    }
+
+    // the traceback yields the operations from the end of the block, which is the order wanted on the reverse strand
+    std::string ops;
+    ops.reserve(n+m);
+    for(int i = n, j = m; i > 0 || j > 0; )
+    {
+        unsigned char move = trace[(size_t)i * width + (j-i-lo)];
+        if(move == 0) { ops.push_back('M'); --i; --j; }
+        else if(move == 1) { ops.push_back('D'); --i; }     // base only in the target
+        else { ops.push_back('I'); --j; }                   // base only in the query
     }
+    if(!reverse)
+        std::reverse(ops.begin(), ops.end());
 
-    return TSeed(start[0], end[0], start[1], end[1]);
+    std::stringstream out;
+    for(size_t p = 0; p < ops.length(); )
+    {
+        size_t q = p;
+        while(q < ops.length() && ops[q] == ops[p])
+            ++q;
+        out << (q-p) << ops[p];
+        p = q;
+    }
+    cigar = out.str();
+    return best;
 }
 
 double adaptiveSlope(double error)
@@ -78,73 +433,239 @@ bool toEnd(int colStart, int colEnd, int colLen, int rowStart, int rowEnd, int r
         return false;
 }
 
+char complementBase(char c)
+{
+    switch(toupper(c))
+    {
+        case 'A': return 'T';
+        case 'C': return 'G';
+        case 'G': return 'C';
+        case 'T': return 'A';
+        default:  return 'N';
+    }
+}
+
+/**
+ * @brief seedShape_ tells what a k-mer of the matrix covers in a read: with -P it is kmer_len runs of bases instead of
+ * kmer_len bases, and its position is the one of its first base in the read; with -T only the bases under the 1s of the
+ * mask are part of it
+ */
+struct seedShape_ {
+    bool homopolymer = false;
+    std::string mask;
+};
+
+inline seedShape_ & seedShape()
+{
+    static seedShape_ shape;
+    return shape;
+}
+
+/**
+ * @brief seedBases appends the kmer_len bases of the seed at i, one per run with -P
+ * @return the number of bases of the read covered by the seed
+ */
+int seedBases(const std::string & seq, int i, int kmer_len, std::string & bases)
+{
+    int end = i, len = seq.length();
+    for(int r = 0; r < kmer_len && end < len; ++r)
+    {
+        char b = toupper(seq[end]);
+        bases.push_back(b);
+        ++end;
+        if(seedShape().homopolymer)
+            while(end < len && toupper(seq[end]) == b)
+                ++end;
+    }
+    return end - i;
+}
+
+/**
+ * @brief seedSpan is the number of bases of the seed at i: kmer_len, or the bases of its kmer_len runs with -P
+ */
+int seedSpan(const std::string & seq, int i, int kmer_len)
+{
+    if(!seedShape().homopolymer)
+        return kmer_len;
+    std::string bases;
+    return seedBases(seq, i, kmer_len, bases);
+}
+
+/**
+ * @brief seedStrand tells on which strand the k-mer shared by two reads lies
+ * @param row
+ * @param col
+ * @param i is the starting position of the k-mer on the row read
+ * @param j is the starting position of the k-mer on the column read
+ * @param kmer_len
+ * @return 'c' if the row k-mer is the reverse complement of the column one, 'n' otherwise
+ */
+char seedStrand(const std::string & row, const std::string & col, int i, int j, int kmer_len)
+{
+    const seedShape_ & shape = seedShape();
+    if(shape.homopolymer || !shape.mask.empty())
+    {
+        std::string rowbases, colbases;
+        seedBases(row, i, kmer_len, rowbases);
+        seedBases(col, j, kmer_len, colbases);
+        int n = std::min(rowbases.length(), colbases.length());
+        for(int p = 0; p < n; ++p)
+        {
+            if(!shape.mask.empty() && shape.mask[p] != '1')    // the mask is a palindrome
+                continue;
+            if(complementBase(rowbases[n-1-p]) != colbases[p])
+                return 'n';
+        }
+        return 'c';
+    }
+    for(int p = 0; p < kmer_len; ++p)
+    {
+        if(complementBase(row[i+kmer_len-1-p]) != toupper(col[j+p]))
+            return 'n';
+    }
+    return 'c';
+}
+
+/**
+ * @brief seedDiagonal returns the diagonal of a seed, the row position is taken on the reverse complement for 'c' seeds
+ * @param span bases of the seed on the row read (seedSpan)
+ */
+int seedDiagonal(int i, int j, int rlen, int span, char strand)
+{
+    if(strand == 'c')
+        i = rlen-i-span;
+    return j-i;
+}
+
+/**
+ * @brief diagonalFilter checks whether the seeds shared by two reads lie on the same strand and on a consistent diagonal
+ * Two seeds agree if they are on the same strand and their diagonals differ by at most the drift that indels can
+ * accumulate between them at the given error rate (plus one k-mer length of slack)
+ * The seeds of the largest consistent group are copied to the front of seeds so that they are extended first, pos is
+ * left untouched (it is the value of the SpGEMM output, shared with the candidate writer)
+ * @param pos seed positions <row, col>
+ * @param row
+ * @param col
+ * @param kmer_len
+ * @param erate
+ * @param sameStrand is set to false if no two seeds are on the same strand
+ * @param seeds returns the seeds of pos in the order they should be extended
+ * @return false if no two seeds agree, true otherwise (pairs with a single seed always pass)
+ */
+bool diagonalFilter(const vector<pair<int,int>> & pos, const std::string & row, const std::string & col, int kmer_len, double erate,
+        bool & sameStrand, vector<pair<int,int>> & seeds)
+{
+    sameStrand = true;
+    int nseeds = pos.size();
+    seeds.assign(pos.begin(), pos.end());
+    if(nseeds < 2)
+        return true;
+
+    int rlen = row.length();
+    vector<char> strand(nseeds);
+    vector<int> diag(nseeds);
+
+    for(int s = 0; s < nseeds; ++s)
+    {
+        strand[s] = seedStrand(row, col, pos[s].first, pos[s].second, kmer_len);
+        diag[s] = seedDiagonal(pos[s].first, pos[s].second, rlen, seedSpan(row, pos[s].first, kmer_len), strand[s]);
+    }
+
+    auto agree = [&](int a, int b)
+    {
+        if(strand[a] != strand[b])
+            return false;
+        int tolerance = kmer_len + (int)ceil(erate * abs(pos[a].second - pos[b].second));
+        return abs(diag[a] - diag[b]) <= tolerance;
+    };
+
+    int best = 0, bestsupport = 0;
+    bool anysame = false;
+    for(int a = 0; a < nseeds; ++a)
+    {
+        int support = 0;
+        for(int b = 0; b < nseeds; ++b)
+        {
+            if(a != b && strand[a] == strand[b]) anysame = true;
+            if(agree(a, b)) ++support;  // a agrees with itself
+        }
+        if(support > bestsupport)
+        {
+            bestsupport = support;
+            best = a;
+        }
+    }
+
+    if(bestsupport < 2)
+    {
+        sameStrand = anysame;
+        return false;
+    }
+
+    // the seeds consistent with the best one go first, preserving their order
+    seeds.clear();
+    for(int s = 0; s < nseeds; ++s)
+        if(agree(best, s)) seeds.push_back(pos[s]);
+    for(int s = 0; s < nseeds; ++s)
+        if(!agree(best, s)) seeds.push_back(pos[s]);
+
+    return true;
+}
+
 /**
  * @brief alignSeqAn does the seed-and-extend alignment
  * @param row
  * @param col
- * @param rlen is the length of the row sequence
  * @param i is the starting position of the k-mer on the first read
  * @param j is the starting position of the k-mer on the second read
- * @param xdrop
- * @return alignment score and extended seed
+ * @param kmer_len
+ * @param ctx per-thread alignment buffers
+ * @return alignment score and extended seed (score and begin/end positions only, linear memory)
  */
-seqAnResult alignSeqAn(const std::string & row, const std::string & col, int rlen, int i, int j, int xdrop, int kmer_len) {
+seqAnResult alignSeqAn(const readType_ & row, const readType_ & col, int i, int j, int kmer_len, alignContext_ & ctx) {
 
-    Score<int, Simple> scoringScheme(1,-1,-1);
+    seqAnResult longestExtensionScore;
+    TSeed seed;
+
+    /* we are reversing the "row", "col" is always on the forward strand */
+    longestExtensionScore.strand = seedStrand(row.seq, col.seq, i, j, kmer_len);
+    const Dna5String & seqH = (longestExtensionScore.strand == "c") ? row.dna5rc : row.dna5;
+    const Dna5String & seqV = col.dna5;
+
+    longestExtensionScore.score = overlapScoreOnly(seqH, seqV, ctx, seed);
+    longestExtensionScore.seed = seed;
+    return longestExtensionScore;
+}
+
+/**
+ * @brief alignSeqAnBanded extends the seed within a band of diagonals around it (one level of the alignment cascade)
+ * @param row
+ * @param col
+ * @param i is the starting position of the k-mer on the first read
+ * @param j is the starting position of the k-mer on the second read
+ * @param kmer_len
+ * @param band number of diagonals around the seed, 0 for the full matrix
+ * @param minScore score the alignment must exceed, the extension stops early once it cannot (see overlapScoreBanded)
+ * @param ctx per-thread alignment buffers
+ * @param cells number of DP cells computed
+ * @return alignment score, extended seed and whether it stopped early
+ */
+seqAnResult alignSeqAnBanded(const readType_ & row, const readType_ & col, int i, int j, int kmer_len, int band, int minScore,
+        alignContext_ & ctx, size_t & cells) {
 
-    Dna5String seqH(row);
-    Dna5String seqV(col);
-    Dna5String seedH;
-    Dna5String seedV;
-    string strand;
-    int longestExtensionTemp;
     seqAnResult longestExtensionScore;
+    TSeed seed;
 
+    longestExtensionScore.strand = seedStrand(row.seq, col.seq, i, j, kmer_len);
+    const Dna5String & seqH = (longestExtensionScore.strand == "c") ? row.dna5rc : row.dna5;
+    const Dna5String & seqV = col.dna5;
 
-    TSeed seed(i, j, i+kmer_len, j+kmer_len);
-    seedH = infix(seqH, beginPositionH(seed), endPositionH(seed));
-    seedV = infix(seqV, beginPositionV(seed), endPositionV(seed));
+    int rlen = row.seq.length();
+    int halfBand = (band > 0) ? band/2 : (int)(length(seqH) + length(seqV));
+    int diag = seedDiagonal(i, j, rlen, seedSpan(row.seq, i, kmer_len), longestExtensionScore.strand[0]);
 
-    /* we are reversing the "row", "col" is always on the forward strand */
-    Dna5StringReverseComplement twin(seedH);
-
-    std::cout << row.length() << " " << col.length() << " " << row.length()*col.length() << std::endl;
-
-    if(twin == seedV)
-    {
-        strand = 'c';
-        Dna5StringReverseComplement twinRead(seqH);
-        i = rlen-i-kmer_len;
-        
-        setBeginPositionH(seed, i);
-        setBeginPositionV(seed, j);
-        setEndPositionH(seed, i+kmer_len);
-        setEndPositionV(seed, j+kmer_len);
-
-        /* Perform match extension */
-        //longestExtensionTemp = extendSeed(seed, twinRead, seqV, EXTEND_BOTH, scoringScheme, xdrop, kmer_len, GappedXDrop());
-        TAlign align;
-        resize(rows(align), 2);
-        assignSource(seqan::row(align, 0), twinRead);
-        assignSource(seqan::row(align, 1), seqV);
-        longestExtensionTemp = globalAlignment(align, scoringScheme, AlignConfig<true, true, true, true>(), LinearGaps());
-        seed = retrieveSeed(align);
-
-    } else
-    {
-        strand = 'n';
-        //longestExtensionTemp = extendSeed(seed, seqH, seqV, EXTEND_BOTH, scoringScheme, xdrop, kmer_len, GappedXDrop());
-        TAlign align;
-        resize(rows(align), 2);
-        assignSource(seqan::row(align, 0), seqH);
-        assignSource(seqan::row(align, 1), seqV);
-        longestExtensionTemp = globalAlignment(align, scoringScheme, AlignConfig<true, true, true, true>(), LinearGaps());
-        seed = retrieveSeed(align);
-    } 
-
-    longestExtensionScore.score = longestExtensionTemp;
+    longestExtensionScore.score = overlapScoreBanded(seqH, seqV, diag, halfBand, minScore, ctx, seed, longestExtensionScore.earlyExit, cells);
     longestExtensionScore.seed = seed;
-    longestExtensionScore.strand = strand;
     return longestExtensionScore;
 }
 
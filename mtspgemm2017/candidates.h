@@ -0,0 +1,281 @@
+#ifndef _CANDIDATES_H_
+#define _CANDIDATES_H_
+
+#include "common.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+/* Candidate overlap matrix (-M), aligned by bella-align
+ *
+ * header   candHeader_, section offsets are in bytes from the start of the file, every section is 8-byte aligned
+ * reads    nameptr[numreads+1], seqptr[numreads+1] (uint64_t), then the names and the sequences back to back
+ * C        colptr[numreads+1], rowids[nnz] (uint64_t), counts[nnz] (uint32_t), posptr[nnz+1] (uint64_t),
+ *          pos[npos] (int32_t pairs: k-mer position on the row read, on the column read)
+ *
+ * C is the lower triangle of AA^T as HashSpGEMM forms it, before any alignment: the seeds already went through the
+ * k-mer rift (-r) and the two-seed rule (-K), everything after that can be changed by bella-align. The header is
+ * written last, so a file without the magic number is one whose writer was interrupted.
+ */
+
+#define CAND_MAGIC "BELLACND"
+#define CAND_VERSION 3
+
+struct candHeader_ {
+	char magic[8];
+	uint32_t version;
+	int32_t kmerlen;
+	int32_t allkmer;		// -K when C was formed
+	int32_t kmerrift;		// -r when C was formed
+	int32_t homopolymer;	// -P when C was formed: the seeds are homopolymer-compressed k-mers
+	int32_t pad;
+	char seedmask[40];		// -T when C was formed, '\0'-terminated, empty for contiguous k-mers
+	double errorrate;		// estimated (or -e), drives the adaptive threshold and the diagonal pre-filter
+	uint64_t numreads;
+	uint64_t nnz;
+	uint64_t npos;
+	uint64_t nameptr, seqptr, names, seqs;			// read store
+	uint64_t colptr, rowids, counts, posptr, pos;	// matrix
+	uint64_t filesize;
+};
+
+inline uint64_t candAlign(uint64_t offset) { return (offset + 7) & ~(uint64_t)7; }
+
+/**
+ * @brief CandidateWriter writes C stage by stage while HashSpGEMM forms it
+ * The number of nonzeros per column is known before the multiplication (colptrC), so every stage goes straight to its
+ * place in the file; only the seed positions, whose number is not known in advance, are appended at the end.
+ */
+class CandidateWriter
+{
+public:
+	CandidateWriter(): fd(-1), failed(false), npos(0) {}
+	~CandidateWriter() { if(fd >= 0) close(fd); }
+
+	template <typename IT>
+	bool open(const char * file, const readVector_ & reads, const IT * colptrC, const BELLApars & b_pars, int kmer_len)
+	{
+		filename = file;
+		fd = ::open(file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(fd < 0)
+		{
+			fprintf(stderr, "File %s failed to open\n", file);
+			return false;
+		}
+
+		uint64_t numreads = reads.size();
+		std::vector<uint64_t> nameptr(numreads+1, 0), seqptr(numreads+1, 0);
+		for(uint64_t i = 0; i < numreads; ++i)
+		{
+			nameptr[i+1] = nameptr[i] + reads[i].nametag.length();
+			seqptr[i+1] = seqptr[i] + reads[i].seq.length();
+		}
+
+		memset(&header, 0, sizeof(header));
+		header.version = CAND_VERSION;
+		header.kmerlen = kmer_len;
+		header.allkmer = b_pars.allKmer;
+		header.kmerrift = b_pars.kmerRift;
+		header.homopolymer = b_pars.homopolymer;
+		strncpy(header.seedmask, b_pars.spacedSeed.mask.c_str(), sizeof(header.seedmask) - 1);
+		header.errorrate = b_pars.errorRate;
+		header.numreads = numreads;
+		header.nnz = colptrC[numreads];
+		header.nameptr = candAlign(sizeof(candHeader_));
+		header.seqptr = candAlign(header.nameptr + (numreads+1) * sizeof(uint64_t));
+		header.names = candAlign(header.seqptr + (numreads+1) * sizeof(uint64_t));
+		header.seqs = candAlign(header.names + nameptr[numreads]);
+		header.colptr = candAlign(header.seqs + seqptr[numreads]);
+		header.rowids = candAlign(header.colptr + (numreads+1) * sizeof(uint64_t));
+		header.counts = candAlign(header.rowids + header.nnz * sizeof(uint64_t));
+		header.posptr = candAlign(header.counts + header.nnz * sizeof(uint32_t));
+		header.pos = candAlign(header.posptr + (header.nnz+1) * sizeof(uint64_t));
+
+		std::vector<uint64_t> colptr(colptrC, colptrC + numreads+1);
+		put(nameptr.data(), nameptr.size() * sizeof(uint64_t), header.nameptr);
+		put(seqptr.data(), seqptr.size() * sizeof(uint64_t), header.seqptr);
+		put(colptr.data(), colptr.size() * sizeof(uint64_t), header.colptr);
+
+		std::string store;
+		for(uint64_t i = 0; i < numreads; ++i)
+			store += reads[i].nametag;
+		put(store.data(), store.size(), header.names);
+		store.clear();
+		for(uint64_t i = 0; i < numreads; ++i)
+			store += reads[i].seq;
+		put(store.data(), store.size(), header.seqs);
+		return !failed;
+	}
+
+	/* nonzeros [begnz, endnz) of C, stages must come in column order */
+	template <typename IT, typename FT>
+	bool writeStage(IT begnz, IT endnz, const IT * rowids, const FT * values)
+	{
+		IT n = endnz - begnz;
+		std::vector<uint64_t> rows(rowids, rowids + n);
+		std::vector<uint32_t> counts(n);
+		std::vector<uint64_t> posptr(n);
+		std::vector<int32_t> pos;
+		for(IT i = 0; i < n; ++i)
+		{
+			counts[i] = values[i]->count;
+			posptr[i] = npos + pos.size()/2;
+			for(auto it = values[i]->pos.begin(); it != values[i]->pos.end(); ++it)
+			{
+				pos.push_back(it->first);
+				pos.push_back(it->second);
+			}
+		}
+		put(rows.data(), n * sizeof(uint64_t), header.rowids + begnz * sizeof(uint64_t));
+		put(counts.data(), n * sizeof(uint32_t), header.counts + begnz * sizeof(uint32_t));
+		put(posptr.data(), n * sizeof(uint64_t), header.posptr + begnz * sizeof(uint64_t));
+		put(pos.data(), pos.size() * sizeof(int32_t), header.pos + npos * 2 * sizeof(int32_t));
+		npos += pos.size()/2;
+		return !failed;
+	}
+
+	/* close posptr, then write the header that makes the file valid */
+	bool finish()
+	{
+		header.npos = npos;
+		header.filesize = header.pos + npos * 2 * sizeof(int32_t);
+		put(&npos, sizeof(uint64_t), header.posptr + header.nnz * sizeof(uint64_t));
+		failed = failed || (fsync(fd) != 0);
+		memcpy(header.magic, CAND_MAGIC, sizeof(header.magic));
+		put(&header, sizeof(header), 0);
+		failed = (close(fd) != 0) || failed;
+		fd = -1;
+		if(failed) fprintf(stderr, "Writing the candidate matrix %s failed\n", filename.c_str());
+		return !failed;
+	}
+
+	uint64_t seeds() const { return npos; }
+
+private:
+	void put(const void * data, size_t bytes, uint64_t offset)
+	{
+		size_t written = 0;
+		while(!failed && written < bytes)
+		{
+			ssize_t w = pwrite(fd, (const char *)data + written, bytes - written, offset + written);
+			if(w < 0) failed = true;
+			else written += w;
+		}
+	}
+
+	std::string filename;
+	int fd;
+	bool failed;
+	uint64_t npos;
+	candHeader_ header;
+};
+
+/**
+ * @brief CandidateMatrix maps a candidate file written with -M: the matrix is used in place, the reads and the seed
+ * values of one stage at a time are materialized for RunPairWiseAlignments
+ */
+class CandidateMatrix
+{
+public:
+	CandidateMatrix(): base(NULL), length(0) {}
+	~CandidateMatrix() { if(base != NULL) munmap(base, length); }
+
+	bool open(const char * filename)
+	{
+		int fd = ::open(filename, O_RDONLY);
+		struct stat st;
+		if(fd < 0 || fstat(fd, &st) != 0)
+		{
+			fprintf(stderr, "File %s failed to open\n", filename);
+			if(fd >= 0) close(fd);
+			return false;
+		}
+		length = st.st_size;
+		if(length < sizeof(candHeader_))
+		{
+			fprintf(stderr, "%s is not a BELLA candidate matrix\n", filename);
+			close(fd);
+			return false;
+		}
+		base = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if(base == MAP_FAILED)
+		{
+			base = NULL;
+			fprintf(stderr, "File %s cannot be mapped\n", filename);
+			return false;
+		}
+
+		memcpy(&header, base, sizeof(header));
+		if(memcmp(header.magic, CAND_MAGIC, sizeof(header.magic)) != 0)
+		{
+			fprintf(stderr, "%s is not a BELLA candidate matrix, or its writer was interrupted\n", filename);
+			return false;
+		}
+		if(header.version != CAND_VERSION || header.filesize != length)
+		{
+			fprintf(stderr, "%s: unsupported version %u or truncated file\n", filename, header.version);
+			return false;
+		}
+		madvise(base, length, MADV_SEQUENTIAL);     // stages are read in column order
+		return true;
+	}
+
+	/* copy the read store in reads (read id = index) */
+	void loadReads(readVector_ & reads) const
+	{
+		const uint64_t * nameptr = section<uint64_t>(header.nameptr);
+		const uint64_t * seqptr = section<uint64_t>(header.seqptr);
+		const char * names = section<char>(header.names);
+		const char * seqs = section<char>(header.seqs);
+
+		reads.resize(header.numreads);
+	#pragma omp parallel for
+		for(uint64_t i = 0; i < header.numreads; ++i)
+		{
+			reads[i].nametag.assign(names + nameptr[i], nameptr[i+1] - nameptr[i]);
+			reads[i].seq.assign(seqs + seqptr[i], seqptr[i+1] - seqptr[i]);
+			reads[i].readid = i;
+		}
+	}
+
+	/* seed values of the nonzeros [begnz, endnz), in the form HashSpGEMM hands them to the alignment */
+	void values(uint64_t begnz, uint64_t endnz, spmatPtr_ * out) const
+	{
+		const uint32_t * counts = section<uint32_t>(header.counts);
+		const uint64_t * posptr = section<uint64_t>(header.posptr);
+		const int32_t * pos = section<int32_t>(header.pos);
+
+	#pragma omp parallel for
+		for(uint64_t i = begnz; i < endnz; ++i)
+		{
+			spmatPtr_ value(std::make_shared<spmatType_>());
+			value->count = counts[i];
+			for(uint64_t p = posptr[i]; p < posptr[i+1]; ++p)
+				value->pos.push_back(std::make_pair(pos[2*p], pos[2*p+1]));
+			out[i-begnz] = value;
+		}
+	}
+
+	const uint64_t * colptr() const { return section<uint64_t>(header.colptr); }
+	const uint64_t * rowids() const { return section<uint64_t>(header.rowids); }
+	const candHeader_ & info() const { return header; }
+
+private:
+	template <typename T>
+	const T * section(uint64_t offset) const { return reinterpret_cast<const T *>((const char *)base + offset); }
+
+	void * base;
+	size_t length;
+	candHeader_ header;
+};
+
+#endif
@@ -0,0 +1,352 @@
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include "CSC.h"
+#include "common.h"
+#include "memplan.h"
+#include "../kmercode/Kmer.hpp"
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+/* Checkpoints (-S <dir>, resumed with -R)
+ *
+ * counting.ckpt  reliable k-mers and their ids, reliable bounds, error rate
+ * matrices.ckpt  reads, reliable bounds, error rate, and the shape of A and A^T
+ * A.mtx, AT.mtx  A (reads x k-mers) and its transpose as matrix files (matrixfile.h), mapped when resuming
+ * stages.ckpt    one record per completed SpGEMM/alignment stage: its columns and the size of the output file after it
+ *
+ * Every file starts with ckptHeader_. The counting and matrix checkpoints are signed with the input files, the k-mer
+ * length, the depth and the error rate (-e), the stage log also with the parameters of the overlap detection and the
+ * alignment: changing -a, -c or -w reuses the k-mers and the matrices and recomputes the stages. The counting and
+ * matrix checkpoints are written to a temporary file and renamed, stage records are appended once the output of the
+ * stage is on disk, so an interrupted run leaves at worst an incomplete last record, which is ignored.
+ */
+
+#define CKPT_VERSION 2
+#define CKPT_COUNTING "counting.ckpt"
+#define CKPT_MATRICES "matrices.ckpt"
+#define CKPT_A "A.mtx"
+#define CKPT_AT "AT.mtx"
+#define CKPT_STAGES "stages.ckpt"
+
+struct ckptHeader_ {
+	char magic[8];
+	uint32_t version;
+	uint32_t pad;
+	uint64_t signature;
+};
+
+struct ckptStage_ {
+	uint64_t firstcol;
+	uint64_t lastcol;
+	uint64_t outputbytes;	// size of the output file once the stage is written
+};
+
+struct checkpoint_ {
+	std::string dir;		// empty = no checkpoints
+	bool resume = false;
+	uint64_t inputsig = 0;	// input files, k-mer length, depth, error rate
+	uint64_t alignsig = 0;	// inputsig and the parameters of the stages
+
+	bool enabled() const { return !dir.empty(); }
+	std::string path(const char * name) const { return dir + "/" + name; }
+};
+
+/* FNV-1a hash of a description of the parameters */
+inline uint64_t ckptSignature(const std::string & s, uint64_t h = 14695981039346656037ULL)
+{
+	for(unsigned char c : s)
+	{
+		h ^= c;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+/**
+ * @brief makeCheckpointDir creates the checkpoint directory if it does not exist
+ */
+inline bool makeCheckpointDir(const checkpoint_ & ckpt)
+{
+	struct stat st;
+	if(stat(ckpt.dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+		return true;
+	if(mkdir(ckpt.dir.c_str(), 0755) != 0)
+	{
+		fprintf(stderr, "Checkpoint directory %s cannot be created\n", ckpt.dir.c_str());
+		return false;
+	}
+	return true;
+}
+
+template <typename T>
+inline bool ckptWrite(FILE * f, const T * data, size_t n) { return n == 0 || fwrite(data, sizeof(T), n, f) == n; }
+
+template <typename T>
+inline bool ckptRead(FILE * f, T * data, size_t n) { return n == 0 || fread(data, sizeof(T), n, f) == n; }
+
+inline bool ckptWriteString(FILE * f, const std::string & s)
+{
+	uint32_t len = s.length();
+	return ckptWrite(f, &len, 1) && ckptWrite(f, s.data(), len);
+}
+
+inline bool ckptReadString(FILE * f, std::string & s)
+{
+	uint32_t len;
+	if(!ckptRead(f, &len, 1)) return false;
+	s.resize(len);
+	return ckptRead(f, &s[0], len);
+}
+
+/* create name.tmp in the checkpoint directory and write its header, NULL on failure */
+inline FILE * createCheckpoint(const checkpoint_ & ckpt, const char * name, const char * magic, uint64_t signature)
+{
+	std::string tmp = ckpt.path(name) + ".tmp";
+	FILE * f = fopen(tmp.c_str(), "wb");
+	if(f == NULL)
+	{
+		fprintf(stderr, "File %s failed to open\n", tmp.c_str());
+		return NULL;
+	}
+	ckptHeader_ header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, magic, sizeof(header.magic));
+	header.version = CKPT_VERSION;
+	header.signature = signature;
+	ckptWrite(f, &header, 1);
+	return f;
+}
+
+/* close name.tmp and, if everything was written, make it durable and replace the previous checkpoint */
+inline bool commitCheckpoint(const checkpoint_ & ckpt, const char * name, FILE * f, bool ok)
+{
+	std::string final = ckpt.path(name);
+	std::string tmp = final + ".tmp";
+	ok = ok && (fflush(f) == 0) && (fsync(fileno(f)) == 0);
+	ok = (fclose(f) == 0) && ok;
+	ok = ok && (rename(tmp.c_str(), final.c_str()) == 0);
+	if(!ok)
+	{
+		fprintf(stderr, "Writing the checkpoint %s failed\n", final.c_str());
+		remove(tmp.c_str());
+	}
+	return ok;
+}
+
+/* open a checkpoint for reading, NULL if it is missing or belongs to another input or version */
+inline FILE * openCheckpoint(const checkpoint_ & ckpt, const char * name, const char * magic, uint64_t signature)
+{
+	std::string file = ckpt.path(name);
+	FILE * f = fopen(file.c_str(), "rb");
+	if(f == NULL)
+		return NULL;
+	ckptHeader_ header;
+	if(!ckptRead(f, &header, 1) || memcmp(header.magic, magic, sizeof(header.magic)) != 0 || header.version != CKPT_VERSION)
+	{
+		fprintf(stderr, "%s is not a checkpoint of this BELLA version: ignored\n", file.c_str());
+		fclose(f);
+		return NULL;
+	}
+	if(header.signature != signature)
+	{
+		std::cout << file << " was written with other input or parameters: ignored" << std::endl;
+		fclose(f);
+		return NULL;
+	}
+	return f;
+}
+
+/**
+ * @brief saveCounting stores the reliable k-mers with their ids, the reliable bounds and the error rate
+ */
+template <typename TDict>
+bool saveCounting(const checkpoint_ & ckpt, TDict & countsreliable, int lower, int upper, double erate, const memoryPlan_ & plan)
+{
+	FILE * f = createCheckpoint(ckpt, CKPT_COUNTING, "BELLAKMC", ckpt.inputsig);
+	if(f == NULL) return false;
+
+	uint64_t count = countsreliable.size();
+	bool ok = ckptWrite(f, &lower, 1) && ckptWrite(f, &upper, 1) && ckptWrite(f, &erate, 1);
+	ok = ok && ckptWrite(f, &plan.cardinality, 1) && ckptWrite(f, &plan.countingPasses, 1) && ckptWrite(f, &count, 1);
+
+	auto lt = countsreliable.lock_table();
+	for(const auto & it : lt)
+	{
+		if(!ok) break;
+		int32_t id = it.second;
+		ok = ckptWrite(f, it.first.getBytes(), it.first.getNumBytes()) && ckptWrite(f, &id, 1);
+	}
+	lt.unlock();
+	return commitCheckpoint(ckpt, CKPT_COUNTING, f, ok);
+}
+
+/**
+ * @brief loadCounting restores what saveCounting stored, false if there is no usable checkpoint
+ */
+template <typename TDict>
+bool loadCounting(const checkpoint_ & ckpt, TDict & countsreliable, int & lower, int & upper, double & erate, memoryPlan_ & plan)
+{
+	FILE * f = openCheckpoint(ckpt, CKPT_COUNTING, "BELLAKMC", ckpt.inputsig);
+	if(f == NULL) return false;
+
+	uint64_t count;
+	bool ok = ckptRead(f, &lower, 1) && ckptRead(f, &upper, 1) && ckptRead(f, &erate, 1);
+	ok = ok && ckptRead(f, &plan.cardinality, 1) && ckptRead(f, &plan.countingPasses, 1) && ckptRead(f, &count, 1);
+
+	Kmer kmer;
+	std::vector<uint8_t> bytes(kmer.getNumBytes());
+	countsreliable.reserve(count);
+	for(uint64_t i = 0; ok && i < count; ++i)
+	{
+		int32_t id;
+		ok = ckptRead(f, bytes.data(), bytes.size()) && ckptRead(f, &id, 1);
+		kmer.copyDataFrom(bytes.data());
+		countsreliable.insert(kmer, id);
+	}
+	fclose(f);
+	if(!ok)
+	{
+		fprintf(stderr, "%s is truncated: ignored\n", ckpt.path(CKPT_COUNTING).c_str());
+		countsreliable.clear();
+	}
+	return ok;
+}
+
+/**
+ * @brief saveMatrices stores the reads (names and sequences, in read id order), A, its transpose, and the scalars
+ * the alignment needs, so that a resumed run starts directly from the overlap detection
+ * The previous matrices.ckpt is removed first: it never refers to matrix files of another run.
+ */
+template <class IT, class NT>
+bool saveMatrices(const checkpoint_ & ckpt, const readVector_ & reads, const CSC<IT,NT> & A, const CSC<IT,NT> & AT,
+	int lower, int upper, double erate)
+{
+	remove(ckpt.path(CKPT_MATRICES).c_str());
+	if(!A.WriteBinary(ckpt.path(CKPT_A)) || !AT.WriteBinary(ckpt.path(CKPT_AT)))
+		return false;
+
+	FILE * f = createCheckpoint(ckpt, CKPT_MATRICES, "BELLACSC", ckpt.inputsig);
+	if(f == NULL) return false;
+
+	uint64_t numreads = reads.size();
+	uint64_t shape[3] = { (uint64_t)A.rows, (uint64_t)A.cols, (uint64_t)A.nnz };
+	bool ok = ckptWrite(f, &lower, 1) && ckptWrite(f, &upper, 1) && ckptWrite(f, &erate, 1) && ckptWrite(f, shape, 3) && ckptWrite(f, &numreads, 1);
+	for(size_t i = 0; ok && i < reads.size(); ++i)
+		ok = ckptWriteString(f, reads[i].nametag) && ckptWriteString(f, reads[i].seq);
+	return commitCheckpoint(ckpt, CKPT_MATRICES, f, ok);
+}
+
+/**
+ * @brief loadMatrices restores what saveMatrices stored, false if there is no usable checkpoint
+ * A and A^T are mapped zero-copy from their matrix files.
+ */
+template <class IT, class NT>
+bool loadMatrices(const checkpoint_ & ckpt, readVector_ & reads, CSC<IT,NT> & A, CSC<IT,NT> & AT,
+	int & lower, int & upper, double & erate)
+{
+	FILE * f = openCheckpoint(ckpt, CKPT_MATRICES, "BELLACSC", ckpt.inputsig);
+	if(f == NULL) return false;
+
+	uint64_t numreads;
+	uint64_t shape[3];
+	bool ok = ckptRead(f, &lower, 1) && ckptRead(f, &upper, 1) && ckptRead(f, &erate, 1) && ckptRead(f, shape, 3) && ckptRead(f, &numreads, 1);
+	if(ok) reads.resize(numreads);
+	for(size_t i = 0; ok && i < reads.size(); ++i)
+	{
+		ok = ckptReadString(f, reads[i].nametag) && ckptReadString(f, reads[i].seq);
+		reads[i].readid = i;
+	}
+	fclose(f);
+	if(ok)
+	{
+		A = CSC<IT,NT>(ckpt.path(CKPT_A));
+		AT = CSC<IT,NT>(ckpt.path(CKPT_AT));
+		ok = A.isMapped() && AT.isMapped() && A.rows == shape[0] && A.cols == shape[1] && A.nnz == shape[2] &&
+			AT.rows == A.cols && AT.cols == A.rows && AT.nnz == A.nnz;
+	}
+	if(!ok)
+	{
+		fprintf(stderr, "%s is truncated or its matrices do not match: ignored\n", ckpt.path(CKPT_MATRICES).c_str());
+		readVector_().swap(reads);
+		A = CSC<IT,NT>();
+		AT = CSC<IT,NT>();
+	}
+	return ok;
+}
+
+/**
+ * @brief StageLog records the SpGEMM/alignment stages as they complete
+ * Resuming keeps the stages of a previous run with the same signature; they always cover the columns [0, done()) of
+ * the output, whatever the stage boundaries of that run were.
+ */
+class StageLog
+{
+public:
+	StageLog(): f(NULL), first(0), bytes(0) {}
+	~StageLog() { if(f != NULL) fclose(f); }
+
+	/* resume the log of a previous run if asked and compatible, otherwise start a new one; stages whose output
+	 * is not entirely in the output file (outputsize bytes) are dropped */
+	bool open(const checkpoint_ & ckpt, uint64_t outputsize)
+	{
+		std::string file = ckpt.path(CKPT_STAGES);
+		if(ckpt.resume)
+		{
+			FILE * prev = openCheckpoint(ckpt, CKPT_STAGES, "BELLASTG", ckpt.alignsig);
+			if(prev != NULL)
+			{
+				ckptStage_ stage;
+				while(ckptRead(prev, &stage, 1))	// a record cut by a crash is left out
+				{
+					if(stage.firstcol != first || stage.outputbytes > outputsize) break;
+					completed.push_back(stage);
+					first = stage.lastcol;
+					bytes = stage.outputbytes;
+				}
+				fclose(prev);
+			}
+		}
+
+		// rewrite the log with the stages kept, the next records are appended to it
+		f = createCheckpoint(ckpt, CKPT_STAGES, "BELLASTG", ckpt.alignsig);
+		if(f == NULL) return false;
+		bool ok = ckptWrite(f, completed.data(), completed.size()) && (fflush(f) == 0);
+		ok = (fclose(f) == 0) && ok;
+		ok = ok && (rename((file + ".tmp").c_str(), file.c_str()) == 0);
+		f = ok ? fopen(file.c_str(), "ab") : NULL;
+		if(f == NULL)
+			fprintf(stderr, "Writing the checkpoint %s failed\n", file.c_str());
+		return f != NULL;
+	}
+
+	/* record a stage whose output is already on disk */
+	bool append(uint64_t firstcol, uint64_t lastcol, uint64_t outputbytes)
+	{
+		if(f == NULL) return false;
+		ckptStage_ stage = { firstcol, lastcol, outputbytes };
+		completed.push_back(stage);
+		first = lastcol;
+		bytes = outputbytes;
+		return ckptWrite(f, &stage, 1) && (fflush(f) == 0) && (fsync(fileno(f)) == 0);
+	}
+
+	bool enabled() const { return f != NULL; }
+	uint64_t done() const { return first; }				// first column not computed yet
+	uint64_t outputBytes() const { return bytes; }		// output file size after the completed stages
+	size_t stages() const { return completed.size(); }
+
+private:
+	FILE * f;
+	uint64_t first;
+	uint64_t bytes;
+	std::vector<ckptStage_> completed;
+};
+
+#endif
@@ -19,6 +19,9 @@ extern "C" {
 #endif
 
 #include "../libcuckoo/cuckoohash_map.hh"
+#include "../kmercode/seeds.hpp"
+
+#define MAX_CASCADE_LEVELS 4
 
 struct BELLApars
 {
@@ -35,9 +38,22 @@ struct BELLApars
 	int relaxMargin;		// epsilon parameter for alignment on edges (w)
 	double deltaChernoff;	// delta computed via Chernoff bound (c)
     bool outputPaf;         // output in paf format (p)
+	bool outputCigar;		// recompute the traceback of accepted pairs to output cg:Z: in paf format (C)
+	bool outputBinary;		// fixed-width binary records with a read table header, see overlapformat.h (B)
+	bool diagFilter;		// Skip pairs whose shared k-mers do not agree on strand and diagonal before alignment (D)
+	double errorRate;		// error rate (estimated or e) used to size the diagonal tolerance of the pre-filter
+	std::vector<int> cascadeBands;	// band (number of diagonals) of each alignment cascade level, 0 = full matrix, empty = no cascade (b)
+	double cascadeCutoff;	// failed pairs scoring at least this fraction of the threshold are escalated to the next level (y)
+	std::string candidateFile;	// write the candidate overlap matrix for bella-align and stop before the alignment (M)
+	std::string spectrumFile;	// write the k-mer spectrum and its fitted model (s)
+	bool spectrumRange;		// reliable range from the k-mer spectrum instead of the binomial model (H)
+	double flopBudget;		// lower the reliable upper bound until the predicted SpGEMM flops fit, 0 = no budget (F)
+	seedSampling_ sampling;	// k-mers counted and put in A: all of them, minimizers, syncmers or a hash fraction (q)
+	bool homopolymer;		// k-mers of the homopolymer-compressed reads, positions in the original reads (P)
+	spacedSeed_ spacedSeed;	// mask of the bases of a window of kmer_len bases that make the k-mer, contiguous if empty (T)
 
 	BELLApars():totalMemory(8000.0), userDefMem(false), kmerRift(1000), skipEstimate(false), skipAlignment(false), allKmer(false), adapThr(true), defaultThr(50),
-			alignEnd(false), relaxMargin(300), deltaChernoff(0.2), outputPaf(false) {};
+			alignEnd(false), relaxMargin(300), deltaChernoff(0.2), outputPaf(false), outputCigar(false), outputBinary(false), diagFilter(false), errorRate(0.15), cascadeCutoff(0.5), spectrumRange(false), flopBudget(0), homopolymer(false) {};
 };
 
 template <typename T>
@@ -50,12 +66,15 @@ struct seqAnResult {
     int score;
     std::string strand;
     TSeed seed;
+    bool earlyExit = false;     // the extension stopped once the threshold became unreachable (cascade only)
 };
 
 struct readType_ {
 	std::string nametag;
 	std::string seq; 
 	int readid;
+	seqan::Dna5String dna5;     // seq encoded once for the alignment
+	seqan::Dna5String dna5rc;   // reverse complement of dna5
 
     bool operator < (readType_ & str)
     {
@@ -0,0 +1,333 @@
+#ifndef _DISTRIBUTED_H_
+#define _DISTRIBUTED_H_
+
+#include <mpi.h>
+#include <vector>
+#include <string>
+#include <utility>
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <math.h>
+#include <omp.h>
+#include "MPIType.h"
+#include "CSC.h"
+#include "common.h"
+
+/* Distributed BELLA (bella-mpi)
+ *
+ * The p = q*q processes form a square grid, process (i,j) has rank i*q+j and owns block (i,j) of A (reads x reliable
+ * k-mers), of A^T and of C = A A^T. Read ids and k-mer ids are split into q contiguous ranges: block (i,j) of A holds
+ * the reads of range i and the k-mers of range j, block (i,j) of C the pairs of a read of range i (row) and a read of
+ * range j (column). Row and column ids inside a block are local to the ranges of the block.
+ * The local kernels come from overlapping.h, which has to be included first.
+ */
+
+struct procGrid_ {
+    int rank;
+    int nprocs;
+    int dim;            // q, processes per grid row and per grid column
+    int myrow;
+    int mycol;
+    MPI_Comm rowcomm;   // the processes of my grid row, ranked by grid column
+    MPI_Comm colcomm;   // the processes of my grid column, ranked by grid row
+
+    int owner(int row, int col) const { return row * dim + col; }
+};
+
+/**
+ * @brief makeGrid arranges the processes of MPI_COMM_WORLD as a square grid
+ * @return false if the number of processes is not a square
+ */
+bool makeGrid(procGrid_ & grid)
+{
+    MPI_Comm_rank(MPI_COMM_WORLD, &grid.rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &grid.nprocs);
+    grid.dim = (int)(sqrt((double)grid.nprocs) + 0.5);
+    if(grid.dim * grid.dim != grid.nprocs)
+        return false;
+
+    grid.myrow = grid.rank / grid.dim;
+    grid.mycol = grid.rank % grid.dim;
+    MPI_Comm_split(MPI_COMM_WORLD, grid.myrow, grid.mycol, &grid.rowcomm);
+    MPI_Comm_split(MPI_COMM_WORLD, grid.mycol, grid.myrow, &grid.colcomm);
+    return true;
+}
+
+void freeGrid(procGrid_ & grid)
+{
+    MPI_Comm_free(&grid.rowcomm);
+    MPI_Comm_free(&grid.colcomm);
+}
+
+/**
+ * @brief blockBounds splits n ids into dim contiguous ranges, range b is [bounds[b], bounds[b+1])
+ */
+inline std::vector<uint64_t> blockBounds(uint64_t n, int dim)
+{
+    std::vector<uint64_t> bounds(dim+1);
+    for(int b = 0; b <= dim; ++b)
+        bounds[b] = n / dim * b + std::min((uint64_t)b, n % dim);  // the first n % dim ranges get one more id
+    return bounds;
+}
+
+inline int blockOf(const std::vector<uint64_t> & bounds, uint64_t id)
+{
+    return std::upper_bound(bounds.begin(), bounds.end(), id) - bounds.begin() - 1;
+}
+
+/**
+ * @brief exchange sends sendbufs[p] to process p of comm and returns what the other processes sent, ordered by source
+ * The send buffers are released. A single message holds at most INT_MAX elements.
+ */
+template <typename T>
+std::vector<T> exchange(std::vector<std::vector<T>> & sendbufs, MPI_Comm comm)
+{
+    int nprocs;
+    MPI_Comm_size(comm, &nprocs);
+
+    std::vector<uint64_t> sendcnt(nprocs), recvcnt(nprocs);
+    for(int p = 0; p < nprocs; ++p)
+        sendcnt[p] = sendbufs[p].size();
+    MPI_Alltoall(sendcnt.data(), 1, MPIType<uint64_t>(), recvcnt.data(), 1, MPIType<uint64_t>(), comm);
+
+    std::vector<uint64_t> rdispls(nprocs+1, 0);
+    for(int p = 0; p < nprocs; ++p)
+    {
+        if(sendcnt[p] > INT_MAX || recvcnt[p] > INT_MAX)
+        {
+            fprintf(stderr, "A message of the exchange exceeds %d elements: run with more processes\n", INT_MAX);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        rdispls[p+1] = rdispls[p] + recvcnt[p];
+    }
+
+    std::vector<T> recvbuf(rdispls[nprocs]);
+    std::vector<MPI_Request> requests;
+    for(int p = 0; p < nprocs; ++p)
+    {
+        if(recvcnt[p] == 0) continue;
+        requests.push_back(MPI_REQUEST_NULL);
+        MPI_Irecv(recvbuf.data() + rdispls[p], (int)recvcnt[p], MPIType<T>(), p, 0, comm, &requests.back());
+    }
+    for(int p = 0; p < nprocs; ++p)
+    {
+        if(sendcnt[p] == 0) continue;
+        requests.push_back(MPI_REQUEST_NULL);
+        MPI_Isend(sendbufs[p].data(), (int)sendcnt[p], MPIType<T>(), p, 0, comm, &requests.back());
+    }
+    MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+
+    for(int p = 0; p < nprocs; ++p)
+        std::vector<T>().swap(sendbufs[p]);
+    return recvbuf;
+}
+
+// MPI_Bcast in pieces of at most 2^30 elements
+template <typename T>
+void bcastArray(T * data, uint64_t count, int root, MPI_Comm comm)
+{
+    const uint64_t piece = (uint64_t)1 << 30;
+    for(uint64_t done = 0; done < count; done += piece)
+        MPI_Bcast(data + done, (int)std::min(piece, count - done), MPIType<T>(), root, comm);
+}
+
+/**
+ * @brief bcastBlock broadcasts the matrix block of process root of comm
+ * @return mine on the root, buffer (filled with the block of the root) on the other processes
+ */
+template <typename IT, typename NT>
+const CSC<IT,NT> & bcastBlock(const CSC<IT,NT> & mine, CSC<IT,NT> & buffer, int root, MPI_Comm comm)
+{
+    int myrank;
+    MPI_Comm_rank(comm, &myrank);
+
+    uint64_t shape[3] = { (uint64_t)mine.rows, (uint64_t)mine.cols, (uint64_t)mine.nnz };
+    MPI_Bcast(shape, 3, MPIType<uint64_t>(), root, comm);
+    if(myrank != root)
+    {
+        buffer.rows = shape[0];
+        buffer.cols = shape[1];
+        buffer.nnz = shape[2];
+        if(buffer.cols > 0)
+            buffer.colptr = new IT[buffer.cols+1];
+        if(buffer.nnz > 0)
+        {
+            buffer.rowids = new IT[buffer.nnz];
+            buffer.values = new NT[buffer.nnz];
+        }
+    }
+    const CSC<IT,NT> & block = (myrank == root) ? mine : buffer;
+    if(shape[1] > 0)
+        bcastArray(block.colptr, shape[1]+1, root, comm);
+    if(shape[2] > 0)
+    {
+        bcastArray(block.rowids, shape[2], root, comm);
+        bcastArray(block.values, shape[2], root, comm);
+    }
+    return block;
+}
+
+/**
+ * @brief SparseSUMMA forms block (myrow, mycol) of C = A B, A and B distributed by blocks on the grid
+ * At step k, block (myrow, k) of A is broadcast along the grid row and block (k, mycol) of B along the grid column;
+ * LocalSpGEMM multiplies them and mergeop(new, earlier) combines the values that the steps formed for the same entry.
+ * With lowtriout only the strictly lower triangle of C is formed: the blocks above the diagonal only take part in
+ * the broadcasts, the diagonal blocks keep their local lower triangle (rows and columns share the read range).
+ * @return the flops of this block
+ */
+template <typename IT, typename NT, typename FT, typename MultiplyOperation, typename AddOperation, typename MergeOperation>
+uint64_t SparseSUMMA(const procGrid_ & grid, const CSC<IT,NT> & A, const CSC<IT,NT> & B, MultiplyOperation multop, AddOperation addop,
+    MergeOperation mergeop, bool lowtriout, std::vector<IT> & colptrC, std::vector<IT> & rowidsC, std::vector<FT> & valuesC)
+{
+    int numThreads = 1;
+#pragma omp parallel
+    {
+        numThreads = omp_get_num_threads();
+    }
+
+    bool above = lowtriout && grid.myrow < grid.mycol;
+    bool diagonal = lowtriout && grid.myrow == grid.mycol;
+    IT ncols = B.cols;
+    std::vector<std::vector<std::pair<IT,FT>>> merged(ncols);  // per column, sorted by row
+    uint64_t flops = 0;
+
+    for(int k = 0; k < grid.dim; ++k)
+    {
+        CSC<IT,NT> Abuffer, Bbuffer;
+        const CSC<IT,NT> & Ak = bcastBlock(A, Abuffer, k, grid.rowcomm);
+        const CSC<IT,NT> & Bk = bcastBlock(B, Bbuffer, k, grid.colcomm);
+        if(above || Ak.isEmpty() || Bk.isEmpty())
+            continue;
+
+        IT* flopC = estimateFLOP(Ak, Bk, diagonal);
+        IT* colnnzC = estimateNNZ_Hash(Ak, Bk, flopC, diagonal);
+        IT* colptr = prefixsum<IT>(colnnzC, Bk.cols, numThreads);
+        for(IT i = 0; i < Bk.cols; ++i)
+            flops += flopC[i];
+        delete [] colnnzC;
+        delete [] flopC;
+
+        vector<IT> * RowIdsofC = new vector<IT>[ncols];
+        vector<FT> * ValuesofC = new vector<FT>[ncols];
+        IT start = 0, end = ncols;
+        LocalSpGEMM(start, end, Ak, Bk, multop, addop, RowIdsofC, ValuesofC, colptr, diagonal);
+        delete [] colptr;
+
+    #pragma omp parallel for schedule(dynamic)
+        for(IT i = 0; i < ncols; ++i)
+        {
+            std::vector<std::pair<IT,FT>> step(RowIdsofC[i].size());
+            for(size_t j = 0; j < step.size(); ++j)
+                step[j] = std::make_pair(RowIdsofC[i][j], ValuesofC[i][j]);
+            std::sort(step.begin(), step.end(), [](const std::pair<IT,FT> & a, const std::pair<IT,FT> & b) { return a.first < b.first; });
+            vector<IT>().swap(RowIdsofC[i]);
+            vector<FT>().swap(ValuesofC[i]);
+
+            std::vector<std::pair<IT,FT>> & earlier = merged[i];
+            if(earlier.empty())
+            {
+                earlier.swap(step);
+                continue;
+            }
+            std::vector<std::pair<IT,FT>> both;
+            both.reserve(earlier.size() + step.size());
+            size_t x = 0, y = 0;
+            while(x < step.size() && y < earlier.size())
+            {
+                if(step[x].first < earlier[y].first) both.push_back(step[x++]);
+                else if(earlier[y].first < step[x].first) both.push_back(earlier[y++]);
+                else
+                {
+                    both.push_back(std::make_pair(step[x].first, mergeop(step[x].second, earlier[y].second)));
+                    ++x;
+                    ++y;
+                }
+            }
+            both.insert(both.end(), step.begin() + x, step.end());
+            both.insert(both.end(), earlier.begin() + y, earlier.end());
+            earlier.swap(both);
+        }
+        delete [] RowIdsofC;
+        delete [] ValuesofC;
+    }
+
+    colptrC.assign(ncols+1, 0);
+    for(IT i = 0; i < ncols; ++i)
+        colptrC[i+1] = colptrC[i] + merged[i].size();
+    rowidsC.resize(colptrC[ncols]);
+    valuesC.resize(colptrC[ncols]);
+#pragma omp parallel for
+    for(IT i = 0; i < ncols; ++i)
+    {
+        for(size_t j = 0; j < merged[i].size(); ++j)
+        {
+            rowidsC[colptrC[i]+j] = merged[i][j].first;
+            valuesC[colptrC[i]+j] = merged[i][j].second;
+        }
+        std::vector<std::pair<IT,FT>>().swap(merged[i]);
+    }
+    return flops;
+}
+
+/**
+ * @brief ShipReads sends every read to the processes whose block of C involves it: a read of range x is a row of the
+ * blocks (x,*) and a column of the blocks (*,x)
+ * @param reads the reads parsed by this process (readid is the global id)
+ * @param rowreads the reads of range myrow, by id inside the range
+ * @param colreads the reads of range mycol, by id inside the range
+ */
+void ShipReads(const readVector_ & reads, const std::vector<uint64_t> & readbounds, const procGrid_ & grid,
+    readVector_ & rowreads, readVector_ & colreads)
+{
+    std::vector<std::vector<unsigned char>> sendbufs(grid.nprocs);
+    auto put = [](std::vector<unsigned char> & buf, const void * data, size_t bytes)
+    {
+        buf.insert(buf.end(), (const unsigned char *)data, (const unsigned char *)data + bytes);
+    };
+    for(size_t r = 0; r < reads.size(); ++r)
+    {
+        uint64_t id = reads[r].readid;
+        uint32_t lens[2] = { (uint32_t)reads[r].nametag.length(), (uint32_t)reads[r].seq.length() };
+        int x = blockOf(readbounds, id);
+        for(int d = 0; d < 2*grid.dim; ++d)
+        {
+            int dest = (d < grid.dim) ? grid.owner(x, d) : grid.owner(d-grid.dim, x);
+            if(d >= grid.dim && d-grid.dim == x)
+                continue;   // (x,x) is in both lists
+            put(sendbufs[dest], &id, sizeof(id));
+            put(sendbufs[dest], lens, sizeof(lens));
+            put(sendbufs[dest], reads[r].nametag.data(), lens[0]);
+            put(sendbufs[dest], reads[r].seq.data(), lens[1]);
+        }
+    }
+    std::vector<unsigned char> recvbuf = exchange(sendbufs, MPI_COMM_WORLD);
+
+    rowreads.resize(readbounds[grid.myrow+1] - readbounds[grid.myrow]);
+    colreads.resize(readbounds[grid.mycol+1] - readbounds[grid.mycol]);
+    size_t at = 0;
+    while(at < recvbuf.size())
+    {
+        uint64_t id;
+        uint32_t lens[2];
+        memcpy(&id, &recvbuf[at], sizeof(id));
+        memcpy(lens, &recvbuf[at+sizeof(id)], sizeof(lens));
+        at += sizeof(id) + sizeof(lens);
+
+        readType_ read;
+        read.readid = id;
+        read.nametag.assign((const char *)&recvbuf[at], lens[0]);
+        read.seq.assign((const char *)&recvbuf[at+lens[0]], lens[1]);
+        at += lens[0] + lens[1];
+
+        int x = blockOf(readbounds, id);
+        if(x == grid.myrow)
+            rowreads[id - readbounds[x]] = read;
+        if(x == grid.mycol)
+            colreads[id - readbounds[x]] = read;
+    }
+}
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef _MATRIX_FILE_H_
+#define _MATRIX_FILE_H_
+
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+/* Binary matrix file (CSC::WriteBinary, CSC(filename), and the same for CSR)
+ *
+ * header   matrixFileHeader_
+ * ptr      colptr[cols+1] (CSC) or rowptr[rows+1] (CSR)
+ * idx      rowids[nnz] (CSC) or colids[nnz] (CSR)
+ * val      values[nnz]
+ *
+ * Every section starts at a multiple of MATRIX_ALIGN bytes, so the arrays of a mapped file are used in place, zero-copy,
+ * and the pages are shared through the page cache by every process that maps the same file. Index and value types are
+ * recorded by size and must match the reader's IT and NT; the byte order is the one of the machine that wrote the file.
+ */
+
+#define MATRIX_MAGIC "BELLAMTX"
+#define MATRIX_VERSION 1
+#define MATRIX_ALIGN 64
+#define MATRIX_CSC 0
+#define MATRIX_CSR 1
+
+struct matrixFileHeader_ {
+	char magic[8];
+	uint32_t version;
+	uint32_t orientation;	// MATRIX_CSC or MATRIX_CSR
+	uint32_t itsize;		// sizeof(IT)
+	uint32_t ntsize;		// sizeof(NT)
+	uint64_t rows;
+	uint64_t cols;
+	uint64_t nnz;
+	uint64_t ptroffset;
+	uint64_t idxoffset;
+	uint64_t valoffset;
+	uint64_t filesize;
+};
+
+inline uint64_t matrixAlign(uint64_t offset) { return (offset + MATRIX_ALIGN - 1) / MATRIX_ALIGN * MATRIX_ALIGN; }
+
+/**
+ * @brief writeMatrixFile writes the three arrays of a compressed matrix; the file is written under a temporary name
+ * and renamed, so a reader never maps a partial matrix
+ */
+template <typename IT, typename NT>
+bool writeMatrixFile(const std::string & filename, uint32_t orientation, uint64_t rows, uint64_t cols, uint64_t nnz,
+	const IT * ptr, const IT * idx, const NT * val)
+{
+	uint64_t ptrlen = (orientation == MATRIX_CSC ? cols : rows) + 1;
+
+	matrixFileHeader_ header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MATRIX_MAGIC, sizeof(header.magic));
+	header.version = MATRIX_VERSION;
+	header.orientation = orientation;
+	header.itsize = sizeof(IT);
+	header.ntsize = sizeof(NT);
+	header.rows = rows;
+	header.cols = cols;
+	header.nnz = nnz;
+	header.ptroffset = matrixAlign(sizeof(header));
+	header.idxoffset = matrixAlign(header.ptroffset + ptrlen * sizeof(IT));
+	header.valoffset = matrixAlign(header.idxoffset + nnz * sizeof(IT));
+	header.filesize = header.valoffset + nnz * sizeof(NT);
+
+	std::string tmp = filename + ".tmp";
+	FILE * f = fopen(tmp.c_str(), "wb");
+	if(f == NULL)
+	{
+		fprintf(stderr, "File %s failed to open\n", tmp.c_str());
+		return false;
+	}
+
+	static const char zeros[MATRIX_ALIGN] = { 0 };
+	uint64_t at = 0;
+	auto section = [&](uint64_t offset, const void * data, uint64_t bytes) -> bool
+	{
+		bool ok = (offset == at) || (fwrite(zeros, 1, offset - at, f) == offset - at);	// padding up to the section
+		ok = ok && (bytes == 0 || fwrite(data, 1, bytes, f) == bytes);
+		at = offset + bytes;
+		return ok;
+	};
+	bool ok = section(0, &header, sizeof(header));
+	ok = ok && section(header.ptroffset, ptr, ptrlen * sizeof(IT));
+	ok = ok && section(header.idxoffset, idx, nnz * sizeof(IT));
+	ok = ok && section(header.valoffset, val, nnz * sizeof(NT));
+	ok = ok && (fflush(f) == 0) && (fsync(fileno(f)) == 0);
+	ok = (fclose(f) == 0) && ok;
+	ok = ok && (rename(tmp.c_str(), filename.c_str()) == 0);
+	if(!ok)
+	{
+		fprintf(stderr, "Writing the matrix file %s failed\n", filename.c_str());
+		remove(tmp.c_str());
+	}
+	return ok;
+}
+
+/**
+ * @brief mapMatrixFile maps a matrix file read-only after checking its layout against IT, NT and the orientation
+ * @return the base of the mapping (length bytes, to be released with munmap), NULL on error
+ */
+template <typename IT, typename NT>
+void * mapMatrixFile(const std::string & filename, uint32_t orientation, matrixFileHeader_ & header, size_t & length)
+{
+	int fd = open(filename.c_str(), O_RDONLY);
+	struct stat st;
+	if(fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(header))
+	{
+		fprintf(stderr, "Matrix file %s failed to open\n", filename.c_str());
+		if(fd >= 0) close(fd);
+		return NULL;
+	}
+	length = st.st_size;
+	void * base = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);	// the mapping keeps the file
+	if(base == MAP_FAILED)
+	{
+		fprintf(stderr, "Matrix file %s cannot be mapped\n", filename.c_str());
+		return NULL;
+	}
+
+	memcpy(&header, base, sizeof(header));
+	const char * problem = NULL;
+	if(memcmp(header.magic, MATRIX_MAGIC, sizeof(header.magic)) != 0) problem = "not a BELLA matrix file";
+	else if(header.version != MATRIX_VERSION) problem = "unsupported version";
+	else if(header.orientation != orientation) problem = (orientation == MATRIX_CSC) ? "stored as CSR, not CSC" : "stored as CSC, not CSR";
+	else if(header.itsize != sizeof(IT) || header.ntsize != sizeof(NT)) problem = "index or value type does not match";
+	else if(header.filesize != length) problem = "truncated";
+	if(problem != NULL)
+	{
+		fprintf(stderr, "Matrix file %s: %s\n", filename.c_str(), problem);
+		munmap(base, length);
+		return NULL;
+	}
+	return base;
+}
+
+#endif
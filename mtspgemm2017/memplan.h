@@ -0,0 +1,353 @@
+#ifndef _MEMORY_PLAN_H_
+#define _MEMORY_PLAN_H_
+
+#include "common.h"
+#include "../kmercode/Kmer.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <algorithm>
+#include <type_traits>
+#include <cmath>
+#include <stdint.h>
+
+#ifdef OSX
+#include <mach/mach.h>
+#include <mach/vm_statistics.h>
+#include <mach/mach_types.h>
+#include <mach/mach_init.h>
+#include <mach/mach_host.h>
+#endif
+
+#ifdef LINUX
+#include "sys/types.h"
+#include "sys/sysinfo.h"
+struct sysinfo info;
+#endif
+
+#if defined (__linux__)
+#include <sched.h>
+#endif
+
+#define PLAN_MB (1024.0 * 1024.0)
+#define MAX_COUNTING_PASSES 64
+#define MALLOC_CHUNK 16         // bookkeeping bytes of each heap allocation
+#define SOLID_FRACTION 0.25     // fraction of the k-mers that survive the Bloom filter and enter the counting table
+#define TABLE_OVERHEAD 1.3      // cuckoo hash table slots per entry
+#define BLOOM_BITS 6.3          // bits per element of a Bloom filter with 5% false positives
+
+double safety_net = 1.2;
+
+#if defined (__linux__)
+#define CGROUP_UNLIMITED 1e18   // cgroup v1 reports "no limit" as a huge page-aligned number
+
+/* first number in a cgroup file, false if the file is missing or says "max" */
+bool cgroupValue(const std::string & path, double & value)
+{
+    std::ifstream in(path.c_str());
+    std::string token;
+    if(!(in >> token) || token == "max")
+        return false;
+    value = atof(token.c_str());
+    return true;
+}
+
+/* path of this process in the hierarchy of a v1 controller, or in the v2 hierarchy if controller is empty */
+std::string cgroupPath(const std::string & controller)
+{
+    std::ifstream in("/proc/self/cgroup");
+    std::string line;
+    while(std::getline(in, line))
+    {
+        // hierarchy-ID:controller-list:path
+        size_t first = line.find(':');
+        size_t second = line.find(':', first+1);
+        if(first == std::string::npos || second == std::string::npos)
+            continue;
+        std::string controllers = line.substr(first+1, second-first-1);
+        std::string path = line.substr(second+1);
+        if(controller.empty() ? controllers.empty() : (","+controllers+",").find(","+controller+",") != std::string::npos)
+            return path;
+    }
+    return "";
+}
+
+/* tightest limit of a cgroup file along the path of this process; containers usually see their own cgroup as root */
+bool cgroupLimit(const std::string & root, std::string path, const std::string & file, double & limit)
+{
+    bool found = false;
+    limit = CGROUP_UNLIMITED;
+    while(true)
+    {
+        double value;
+        if(cgroupValue(root + path + "/" + file, value) && value < CGROUP_UNLIMITED)
+        {
+            limit = std::min(limit, value);
+            found = true;
+        }
+        if(path.empty() || path == "/")
+            break;
+        path = path.substr(0, path.find_last_of('/'));
+    }
+    return found;
+}
+
+/**
+ * @brief cgroupMemory returns the memory the cgroup of this process (v2 or v1) still allows, or -1 without a limit
+ */
+double cgroupMemory()
+{
+    double limit, usage;
+    std::string path = cgroupPath("");
+    if(cgroupLimit("/sys/fs/cgroup", path, "memory.max", limit))
+    {
+        if(!cgroupValue("/sys/fs/cgroup" + path + "/memory.current", usage) && !cgroupValue("/sys/fs/cgroup/memory.current", usage))
+            usage = 0;
+        return std::max(0.0, limit - usage);
+    }
+    path = cgroupPath("memory");
+    if(cgroupLimit("/sys/fs/cgroup/memory", path, "memory.limit_in_bytes", limit))
+    {
+        if(!cgroupValue("/sys/fs/cgroup/memory" + path + "/memory.usage_in_bytes", usage) && 
+            !cgroupValue("/sys/fs/cgroup/memory/memory.usage_in_bytes", usage))
+            usage = 0;
+        return std::max(0.0, limit - usage);
+    }
+    return -1;
+}
+
+/**
+ * @brief cgroupThreads returns the CPUs this process may use: its affinity mask, capped by the cgroup CPU quota
+ */
+int cgroupThreads()
+{
+    cpu_set_t mask;
+    int cpus = 0;
+    if(sched_getaffinity(0, sizeof(mask), &mask) == 0)
+        cpus = CPU_COUNT(&mask);
+
+    double quota = 0, period = 0;
+    std::string path = cgroupPath("");
+    std::ifstream v2(("/sys/fs/cgroup" + path + "/cpu.max").c_str());
+    std::ifstream v2root("/sys/fs/cgroup/cpu.max");
+    std::string q;
+    if((v2 >> q >> period) || (v2root >> q >> period))  // "quota period" or "max period"
+    {
+        if(q != "max") quota = atof(q.c_str());
+    }
+    else
+    {
+        std::string root = "/sys/fs/cgroup/cpu";
+        path = cgroupPath("cpu");
+        if(!cgroupValue(root + path + "/cpu.cfs_quota_us", quota) || !cgroupValue(root + path + "/cpu.cfs_period_us", period))
+        {
+            if(!cgroupValue(root + "/cpu.cfs_quota_us", quota) || !cgroupValue(root + "/cpu.cfs_period_us", period))
+                quota = 0;
+        }
+    }
+    if(quota > 0 && period > 0)
+    {
+        int quotacpus = std::max(1, (int)std::ceil(quota / period));
+        cpus = (cpus > 0) ? std::min(cpus, quotacpus) : quotacpus;
+    }
+    return cpus;
+}
+#endif
+
+double estimateMemory(const BELLApars & b_pars)
+{
+    double free_memory;
+    if (b_pars.userDefMem)
+    {
+    	free_memory = b_pars.totalMemory * 1024 * 1024;
+    }
+    else
+    {
+#if defined (OSX) // OSX-based memory consumption implementation
+    vm_size_t page_size;
+    mach_port_t mach_port;
+    mach_msg_type_number_t count;
+    vm_statistics64_data_t vm_stats;
+
+    mach_port = mach_host_self();
+    count = sizeof(vm_stats) / sizeof(natural_t);
+
+    if (KERN_SUCCESS == host_page_size(mach_port, &page_size) &&
+                KERN_SUCCESS == host_statistics64(mach_port, HOST_VM_INFO,
+                                                (host_info64_t)&vm_stats, &count))
+    {
+        free_memory = (double) vm_stats.free_count * (double)page_size;
+    }
+#elif defined (LINUX) // LINUX-based memory consumption implementation
+    if(sysinfo(&info) != 0)
+    {
+        return false;
+    }
+    free_memory = info.freeram * info.mem_unit;
+    free_memory += info.bufferram * info.mem_unit;	// swap is not counted: BELLA's working set is random access
+#else
+    free_memory = b_pars.totalMemory * 1024 * 1024;	// memory is neither user-supplied nor can be estimated, so use BELLA's default
+#endif
+#if defined (__linux__)
+    // in containers and batch jobs the cgroup limit, not the host RAM, is what triggers the OOM killer
+    double cgroup_memory = cgroupMemory();
+    if(cgroup_memory >= 0 && cgroup_memory < free_memory)
+    {
+        free_memory = cgroup_memory;
+        std::cout << "Memory capped by the cgroup limit: " << free_memory / (1024 * 1024) << " MB" << std::endl;
+    }
+#endif
+    }
+    return free_memory;
+}
+
+/**
+ * @brief memoryPlan_ sizes every phase of the pipeline from a single memory budget
+ * The estimates start from the input size and are refined with what each phase learns (bases, reliable k-mers,
+ * nnz(A), flops and nnz(C)); the knobs below are the only places where BELLA trades passes for memory.
+ */
+struct memoryPlan_
+{
+	double budget;			// bytes BELLA may use (estimateMemory)
+	int threads;
+
+	// known quantities, exact once the phase that computes them is done
+	size_t inputbytes;		// fastq(s) size
+	size_t bases;			// estimated from inputbytes until the reads are parsed
+	size_t reads;
+	double cardinality;		// distinct k-mers (HyperLogLog), summed over counting passes
+	size_t reliable;		// k-mers in the reliable range = columns of A
+	size_t tuples;			// reliable k-mer occurrences = nnz(A)
+
+	// decisions
+	int countingPasses;		// k-mers are counted one hash partition at a time
+	size_t fastqBlock;		// bytes per fastq block and thread (upperlimit)
+	size_t writerBuffer;	// bytes of each output buffer (two per thread)
+	int stages;				// SpGEMM + alignment stages
+
+	// estimated footprint of each phase (bytes)
+	double countingBytes;	// per counting pass
+	double readBytes;		// read store kept until the end
+	double dictionaryBytes;	// reliable k-mer dictionary, until A and At are built
+	double matrixBytes;		// peak of the tuples-to-CSC construction
+	double residentBytes;	// what stays allocated during SpGEMM: reads, A, At, output and alignment buffers
+	double nnzBytes;		// bytes per nonzero of C, values included
+	double spectrumFlops;	// SpGEMM flops predicted from the k-mer spectrum, 0 if it was not computed
+
+	memoryPlan_(): budget(0), threads(1), inputbytes(0), bases(0), reads(0), cardinality(0), reliable(0), tuples(0),
+		countingPasses(1), fastqBlock(10000000), writerBuffer(1 << 20), stages(1),
+		countingBytes(0), readBytes(0), dictionaryBytes(0), matrixBytes(0), residentBytes(0), nnzBytes(0), spectrumFlops(0) {};
+};
+
+/* sequence, Dna5 copies for the alignment (both strands) and name of every read */
+inline double readStoreBytes(size_t bases, size_t reads, bool align)
+{
+	double perbase = align ? 3.0 : 1.0;
+	return perbase * bases + reads * (double)(sizeof(readType_) + 64);
+}
+
+/* counting keeps all k-mers of the pass, the Bloom filter and the table of k-mers seen at least twice */
+inline double countingPassBytes(size_t kmers, int threads, size_t fastqBlock)
+{
+	double table = SOLID_FRACTION * kmers * (sizeof(Kmer) + sizeof(int)) * TABLE_OVERHEAD;
+	double bloom = kmers * BLOOM_BITS / 8;
+	return (double)kmers * sizeof(Kmer) + bloom + table + 2.0 * threads * fastqBlock;
+}
+
+/**
+ * @brief planCounting is called before anything is read: it sizes the fastq blocks, the output buffers and
+ * the number of k-mer counting passes from the input size
+ */
+void planCounting(memoryPlan_ & plan, double budget, int threads, size_t inputbytes, bool align)
+{
+	plan.budget = budget;
+	plan.threads = threads;
+	plan.inputbytes = inputbytes;
+	plan.bases = inputbytes / 2;	// fastq: sequence and quality dominate the record
+	plan.reads = 0;
+
+	// 1% of the budget for fastq blocks and output buffers, never more than BELLA's defaults
+	plan.fastqBlock = std::max((size_t)(1 << 20), std::min((size_t)10000000, (size_t)(0.01 * budget / threads)));
+	plan.writerBuffer = std::max((size_t)(1 << 16), std::min((size_t)(1 << 20), (size_t)(0.01 * budget / (2 * threads))));
+
+	plan.readBytes = readStoreBytes(plan.bases, plan.reads, align);
+	double all = countingPassBytes(plan.bases, threads, plan.fastqBlock);
+	plan.countingPasses = std::min(MAX_COUNTING_PASSES, std::max(1, (int)std::ceil(safety_net * all / budget)));
+	plan.countingBytes = countingPassBytes(plan.bases / plan.countingPasses, threads, plan.fastqBlock);
+}
+
+/**
+ * @brief planMatrices is called once the reads are parsed: the read store and nnz(A) are exact
+ */
+void planMatrices(memoryPlan_ & plan, size_t bases, size_t reads, size_t reliable, size_t tuples, bool align)
+{
+	plan.bases = bases;
+	plan.reads = reads;
+	plan.reliable = reliable;
+	plan.tuples = tuples;
+	plan.readBytes = readStoreBytes(bases, reads, align);
+	plan.dictionaryBytes = reliable * (sizeof(Kmer) + sizeof(int)) * TABLE_OVERHEAD;
+
+	// peak while A is built: both tuple vectors, A and its sort workspace
+	double tuplebytes = sizeof(tuple<size_t,size_t,size_t>);
+	double cscbytes = 2 * sizeof(size_t);
+	plan.matrixBytes = tuples * (2 * tuplebytes + 2 * cscbytes) + (reads + reliable) * sizeof(size_t);
+}
+
+/**
+ * @brief planSpGEMM splits the output columns in stages so that the nonzeros of one stage, their values and
+ * everything else still allocated fit the budget; returns the number of nonzeros per stage
+ */
+template <typename IT, typename FT>
+uint64_t planSpGEMM(memoryPlan_ & plan, IT flops, IT nnzc, IT maxcolnnz, IT nnzA, bool allKmer, size_t alignBytes)
+{
+	double hashtables = plan.threads * 2.0 * maxcolnnz * (sizeof(IT) + sizeof(FT));
+	double writer = 2.0 * plan.threads * plan.writerBuffer;
+	plan.residentBytes = plan.readBytes + 2.0 * nnzA * (sizeof(IT) + sizeof(size_t)) + (plan.reads + plan.reliable) * sizeof(IT)
+		+ hashtables + writer + alignBytes;
+
+	// rowids and values are copied once when a stage is combined
+	plan.nnzBytes = 2.0 * (sizeof(IT) + sizeof(FT));
+	if(std::is_same<FT, spmatPtr_>::value)
+	{
+		// make_shared block (control block and spmatType_) and the seed vector of each pair
+		double seeds = allKmer ? std::max(1.0, (double)flops / std::max(nnzc, (IT)1)) : 2.0;
+		plan.nnzBytes += 2 * MALLOC_CHUNK + 16 + sizeof(spmatType_) + seeds * sizeof(pair<int,int>);
+	}
+
+	double available = plan.budget - plan.residentBytes;
+	if(available < 0.1 * plan.budget)
+	{
+		std::cout << "Warning: reads and matrices take " << plan.residentBytes / PLAN_MB << " MB of the " << plan.budget / PLAN_MB
+			<< " MB budget, SpGEMM stages are sized on 10% of the budget" << std::endl;
+		available = 0.1 * plan.budget;
+	}
+
+	uint64_t nnzcperstage = std::max((uint64_t)1, (uint64_t)(available / (safety_net * plan.nnzBytes)));
+	plan.stages = std::max((uint64_t)1, (nnzc + nnzcperstage - 1) / nnzcperstage);
+	return nnzcperstage;
+}
+
+void printPlan(const memoryPlan_ & plan, const char * phase)
+{
+	std::cout << "\nMemory plan (" << phase << ") | budget: " << plan.budget / PLAN_MB << " MB | threads: " << plan.threads << std::endl;
+	if(plan.reads == 0)
+	{
+		std::cout << "  input: " << plan.inputbytes / PLAN_MB << " MB | estimated bases: " << plan.bases << std::endl;
+		std::cout << "  k-mer counting: " << plan.countingPasses << " pass(es) of " << plan.countingBytes / PLAN_MB << " MB" << std::endl;
+		std::cout << "  fastq block: " << plan.fastqBlock / PLAN_MB << " MB per thread | output buffer: " << plan.writerBuffer / PLAN_MB << " MB (x" << 2 * plan.threads << ")" << std::endl;
+	}
+	else
+	{
+		std::cout << "  reads: " << plan.reads << " | bases: " << plan.bases << " | read store: " << plan.readBytes / PLAN_MB << " MB" << std::endl;
+		std::cout << "  reliable k-mers: " << plan.reliable << " (" << plan.dictionaryBytes / PLAN_MB << " MB) | nnz(A): " << plan.tuples
+			<< " | matrix construction peak: " << plan.matrixBytes / PLAN_MB << " MB" << std::endl;
+		if(plan.readBytes + plan.dictionaryBytes + plan.matrixBytes > plan.budget)
+			std::cout << "  Warning: matrix construction is expected to exceed the budget (it is not staged)" << std::endl;
+	}
+	if(plan.nnzBytes > 0)
+		std::cout << "  SpGEMM: resident " << plan.residentBytes / PLAN_MB << " MB | " << plan.nnzBytes << " bytes per nnz(C) | stages: " << plan.stages << std::endl;
+}
+
+#endif
@@ -0,0 +1,252 @@
+#ifndef _OVERLAP_FORMAT_H_
+#define _OVERLAP_FORMAT_H_
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+
+/* Binary overlap format (-B)
+ *
+ * header       ovlHeader_
+ * read lengths uint32_t[numreads], indexed by read id
+ * read names   namebytes bytes of '\0'-terminated names, in read id order
+ * records      ovlRecord_ until the end of the file
+ *
+ * Records hold the raw extension coordinates, exactly as in BELLA's text format: the row read (H) coordinates are on
+ * the reverse complement when strand is 'c'. The overlap estimate and the PAF coordinates are derived from them by
+ * the converter (bench/ovl2text). Fields are stored in the byte order of the machine that ran BELLA (little-endian
+ * on every platform we run on).
+ */
+
+#define OVL_MAGIC "BELLAOVL"
+#define OVL_VERSION 1
+
+struct ovlHeader_ {
+	char magic[8];
+	uint32_t version;
+	uint32_t recordsize;    // sizeof(ovlRecord_) when the file was written
+	uint64_t numreads;
+	uint64_t namebytes;
+};
+
+struct ovlRecord_ {
+	uint32_t idV;           // column read id
+	uint32_t idH;           // row read id
+	uint32_t begV;
+	uint32_t endV;
+	uint32_t begH;
+	uint32_t endH;
+	int32_t score;          // alignment score
+	uint32_t count;         // number of shared k-mers
+	uint8_t strand;         // 'n' or 'c'
+	uint8_t pad[3];
+};
+
+static_assert(sizeof(ovlRecord_) == 36, "ovlRecord_ must stay packed: it is the on-disk layout");
+
+/* extend the alignment to the end of the sequences along its diagonal */
+
+inline void extendToEnds(size_t& begpV, size_t& endpV, const int lenV, size_t& begpH, size_t& endpH, const int lenH)
+{
+    if(begpH < begpV)
+    {
+        begpV = begpV - begpH;
+        begpH = 0;
+    }
+    else
+    {
+        begpH = begpH - begpV;
+        begpV = 0;
+    }
+
+    if((lenH - endpH) < (lenV - endpV))
+    {
+        endpV = endpV + (lenH - endpH);
+        endpH = lenH;
+    }
+    else
+    {
+        endpH = endpH + (lenV - endpV);
+        endpV = lenV;
+    }
+}
+
+/* same overlap length estimate BELLA reports in both text formats */
+inline int overlapEstimate(size_t begpV, size_t endpV, int lenV, size_t begpH, size_t endpH, int lenH)
+{
+    int diffCol = endpV - begpV;
+    int diffRow = endpH - begpH;
+    int minLeft = std::min(begpV, begpH);
+    int minRight = std::min(lenV - (int)endpV, lenH - (int)endpH);
+    return minLeft+minRight+(diffCol+diffRow)/2;
+}
+
+/**
+ * @brief writeOverlapHeader creates filename with the header and the read table; records are appended afterwards
+ * @return false if the file cannot be written
+ */
+template <typename TReads>
+bool writeOverlapHeader(const char * filename, const TReads & reads)
+{
+	FILE * f = fopen(filename, "wb");
+	if(f == NULL)
+	{
+		fprintf(stderr, "File %s failed to open\n", filename);
+		return false;
+	}
+
+	std::vector<uint32_t> lengths(reads.size());
+	ovlHeader_ header;
+	memcpy(header.magic, OVL_MAGIC, sizeof(header.magic));
+	header.version = OVL_VERSION;
+	header.recordsize = sizeof(ovlRecord_);
+	header.numreads = reads.size();
+	header.namebytes = 0;
+	for(size_t i = 0; i < reads.size(); ++i)
+	{
+		lengths[i] = reads[i].seq.length();
+		header.namebytes += reads[i].nametag.length() + 1;
+	}
+
+	bool ok = (fwrite(&header, sizeof(header), 1, f) == 1);
+	ok = ok && (fwrite(lengths.data(), sizeof(uint32_t), lengths.size(), f) == lengths.size());
+	for(size_t i = 0; ok && i < reads.size(); ++i)
+		ok = (fwrite(reads[i].nametag.c_str(), 1, reads[i].nametag.length() + 1, f) == reads[i].nametag.length() + 1);
+	ok = (fclose(f) == 0) && ok;
+
+	if(!ok) fprintf(stderr, "Writing the header of %s failed\n", filename);
+	return ok;
+}
+
+/**
+ * @brief OverlapReader streams the records of a binary overlap file after loading its read table
+ */
+class OverlapReader
+{
+public:
+	OverlapReader(): f(NULL) {}
+	~OverlapReader() { if(f != NULL) fclose(f); }
+
+	bool open(const char * filename)
+	{
+		f = fopen(filename, "rb");
+		if(f == NULL)
+		{
+			fprintf(stderr, "File %s failed to open\n", filename);
+			return false;
+		}
+		if(fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, OVL_MAGIC, sizeof(header.magic)) != 0)
+		{
+			fprintf(stderr, "%s is not a BELLA binary overlap file\n", filename);
+			return false;
+		}
+		if(header.version != OVL_VERSION || header.recordsize != sizeof(ovlRecord_))
+		{
+			fprintf(stderr, "%s: unsupported version %u (record size %u)\n", filename, header.version, header.recordsize);
+			return false;
+		}
+
+		lengths.resize(header.numreads);
+		names.resize(header.namebytes);
+		if(fread(lengths.data(), sizeof(uint32_t), lengths.size(), f) != lengths.size() ||
+			fread(names.data(), 1, names.size(), f) != names.size())
+		{
+			fprintf(stderr, "%s: truncated read table\n", filename);
+			return false;
+		}
+
+		offsets.resize(header.numreads);
+		size_t at = 0;
+		for(size_t i = 0; i < header.numreads; ++i)
+		{
+			offsets[i] = at;
+			at += strlen(names.data() + at) + 1;
+		}
+		return true;
+	}
+
+	// read up to max records, returns how many were read (0 at the end of the file)
+	size_t next(ovlRecord_ * records, size_t max) { return fread(records, sizeof(ovlRecord_), max, f); }
+
+	const char * name(uint32_t id) const { return names.data() + offsets[id]; }
+	uint32_t length(uint32_t id) const { return lengths[id]; }
+	uint64_t numreads() const { return header.numreads; }
+
+private:
+	FILE * f;
+	ovlHeader_ header;
+	std::vector<uint32_t> lengths;
+	std::vector<char> names;
+	std::vector<size_t> offsets;
+};
+
+inline void appendInt(std::string & out, int64_t value)
+{
+	char digits[24];
+	int pos = sizeof(digits);
+	bool negative = (value < 0);
+	uint64_t v = negative ? (uint64_t)(-value) : (uint64_t)value;
+	do
+	{
+		digits[--pos] = '0' + (v % 10);
+		v /= 10;
+	} while(v != 0);
+	if(negative) digits[--pos] = '-';
+	out.append(digits+pos, sizeof(digits)-pos);
+}
+
+/* same line BELLA writes without -p */
+inline void formatBELLA(const ovlRecord_ & r, const OverlapReader & reads, std::string & out)
+{
+	int lenV = reads.length(r.idV);
+	int lenH = reads.length(r.idH);
+	int ov = overlapEstimate(r.begV, r.endV, lenV, r.begH, r.endH, lenH);
+
+	out.append(reads.name(r.idV)); out.push_back('\t');
+	out.append(reads.name(r.idH)); out.push_back('\t');
+	appendInt(out, r.count); out.push_back('\t');
+	appendInt(out, r.score); out.push_back('\t');
+	appendInt(out, ov); out.push_back('\t');
+	out.push_back(r.strand); out.push_back('\t');
+	appendInt(out, r.begV); out.push_back('\t');
+	appendInt(out, r.endV); out.push_back('\t');
+	appendInt(out, lenV); out.push_back('\t');
+	appendInt(out, r.begH); out.push_back('\t');
+	appendInt(out, r.endH); out.push_back('\t');
+	appendInt(out, lenH); out.push_back('\n');
+}
+
+/* same line BELLA writes with -p */
+inline void formatPAF(const ovlRecord_ & r, const OverlapReader & reads, std::string & out)
+{
+	int lenV = reads.length(r.idV);
+	int lenH = reads.length(r.idH);
+	size_t begV = r.begV, endV = r.endV, begH = r.begH, endH = r.endH;
+
+	extendToEnds(begV, endV, lenV, begH, endH, lenH);
+	if(r.strand == 'c')
+	{
+		size_t temp = begH;
+		begH = lenH-endH;
+		endH = lenH-temp;
+	}
+	int ov = overlapEstimate(begV, endV, lenV, begH, endH, lenH);
+
+	out.append(reads.name(r.idV)); out.push_back('\t');
+	appendInt(out, lenV); out.push_back('\t');
+	appendInt(out, begV); out.push_back('\t');
+	appendInt(out, endV); out.push_back('\t');
+	out.push_back(r.strand == 'n' ? '+' : '-'); out.push_back('\t');
+	out.append(reads.name(r.idH)); out.push_back('\t');
+	appendInt(out, lenH); out.push_back('\t');
+	appendInt(out, begH); out.push_back('\t');
+	appendInt(out, endH); out.push_back('\t');
+	appendInt(out, r.score); out.push_back('\t');
+	appendInt(out, ov); out.push_back('\t');
+	out.append("255\n");
+}
+
+#endif
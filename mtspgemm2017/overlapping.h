@@ -1,6 +1,12 @@
 #include "CSC.h"
 #include "align.h"
 #include "common.h"
+#include "writer.h"
+#include "overlapformat.h"
+#include "memplan.h"
+#include "telemetry.h"
+#include "checkpoint.h"
+#include "candidates.h"
 #include "../kmercode/hash_funcs.h"
 #include "../kmercode/Kmer.hpp"
 #include "../kmercode/Buffer.h"
@@ -35,6 +41,7 @@ typedef Seed<Simple>  TSeed;
 typedef SeedSet<TSeed> TSeedSet;
 
 #define PERCORECACHE (1024 * 1024)
+#define COST_BUCKETS 48     // per-pair alignment cost histogram, bucket b counts pairs with [2^b, 2^(b+1)) DP cells
 #define TIMESTEP
 
 #ifndef PRINT
@@ -47,21 +54,8 @@ typedef SeedSet<TSeed> TSeedSet;
 //#define LINUX
 //#define RAM
 
-#ifdef OSX
-#include <mach/mach.h>
-#include <mach/vm_statistics.h>
-#include <mach/mach_types.h>
-#include <mach/mach_init.h>
-#include <mach/mach_host.h>
-#endif
 
-#ifdef LINUX
-#include "sys/types.h"
-#include "sys/sysinfo.h"
-struct sysinfo info;
-#endif
 
-double safety_net = 1.2;
 
 /*
  Multithreaded prefix sum
@@ -121,27 +115,7 @@ T* prefixsum(T* in, int size, int nthreads)
 void toPAF(size_t& begpV, size_t& endpV, const int lenV, size_t& begpH, size_t& endpH, const int lenH, const string& rev)
 {
     /* first, extend to the end of the sequences */
-    if(begpH < begpV)
-    {
-        begpV = begpV - begpH;
-        begpH = 0;
-    }
-    else
-    {
-        begpH = begpH - begpV;
-        begpV = 0;
-    }
-
-    if((lenH - endpH) < (lenV - endpV))
-    {
-        endpV = endpV + (lenH - endpH);
-        endpH = lenH;
-    }
-    else
-    {
-        endpH = endpH + (lenV - endpV);
-        endpV = lenV;
-    }
+    extendToEnds(begpV, endpV, lenV, begpH, endpH, lenH);
 
     /* second, (possibly) convert back the seqH seed position according to the original strand */
     if(rev == "c")
@@ -371,47 +345,182 @@ void LocalSpGEMM(IT & start, IT & end, const CSC<IT,NT> & A, const CSC<IT,NT> &
 
 }
 
-double estimateMemory(const BELLApars & b_pars)
-{
-    double free_memory;
-    if (b_pars.userDefMem)
-    {
-    	free_memory = b_pars.totalMemory * 1024 * 1024;
-    }
-    else
-    {
-#if defined (OSX) // OSX-based memory consumption implementation 
-    vm_size_t page_size;
-    mach_port_t mach_port;
-    mach_msg_type_number_t count;
-    vm_statistics64_data_t vm_stats;
-
-    mach_port = mach_host_self();
-    count = sizeof(vm_stats) / sizeof(natural_t);
-
-    if (KERN_SUCCESS == host_page_size(mach_port, &page_size) &&
-                KERN_SUCCESS == host_statistics64(mach_port, HOST_VM_INFO,
-                                                (host_info64_t)&vm_stats, &count))
-    {
-        free_memory = (double) vm_stats.free_count * (double)page_size;
-    } 
-#elif defined (LINUX) // LINUX-based memory consumption implementation 
-    if(sysinfo(&info) != 0)
+
+/**
+ * @brief alignStats_ collects the counters of one stage of RunPairWiseAlignments
+ */
+struct alignStats_ {
+    size_t alignedpairs = 0;
+    size_t alignedbases = 0;
+    size_t totalreadlen = 0;
+    size_t outputted = 0;
+    size_t alignedtrue = 0;     // bases in successful alignments
+    size_t alignedfalse = 0;    // bases in failed alignments
+    size_t filteredstrand = 0;  // pairs skipped by the diagonal pre-filter
+    size_t filtereddiag = 0;
+    size_t cacheskipped = 0;    // seeds not extended because an extension of the same pair already covers them
+    size_t cells = 0;           // DP cells computed
+    size_t costhist[COST_BUCKETS] = {0};    // aligned pairs by DP cells computed (log2 buckets)
+    double timeoutputt = 0;
+    double threadtimemax = 0;   // alignment time of the slowest and fastest thread and mean over threads (stage only)
+    double threadtimemin = 0;
+    double threadtimemean = 0;
+    double threadgcupsmax = 0;  // cell updates per second of the fastest and slowest thread (stage only)
+    double threadgcupsmin = 0;
+    size_t levelaligned[MAX_CASCADE_LEVELS] = {0};      // extensions run at each cascade level
+    size_t levelaccepted[MAX_CASCADE_LEVELS] = {0};     // extensions passing the threshold at each level
+    size_t levelpruned[MAX_CASCADE_LEVELS] = {0};       // extensions stopped early at each level
+    size_t levelescalated[MAX_CASCADE_LEVELS] = {0};    // borderline extensions sent to the next level
+
+    alignStats_ & operator+=(const alignStats_ & rhs)
     {
-        return false;
-    }   
-    free_memory = info.freeram * info.mem_unit;
-    free_memory += info.freeswap * info.mem_unit;
-    free_memory += info.bufferram * info.mem_unit;
-#else
-    free_memory = b_pars.totalMemory * 1024 * 1024;	// memory is neither user-supplied nor can be estimated, so use BELLA's default
-#endif
+        alignedpairs += rhs.alignedpairs;
+        alignedbases += rhs.alignedbases;
+        totalreadlen += rhs.totalreadlen;
+        outputted += rhs.outputted;
+        alignedtrue += rhs.alignedtrue;
+        alignedfalse += rhs.alignedfalse;
+        filteredstrand += rhs.filteredstrand;
+        filtereddiag += rhs.filtereddiag;
+        cacheskipped += rhs.cacheskipped;
+        cells += rhs.cells;
+        for(int c = 0; c < COST_BUCKETS; ++c)
+            costhist[c] += rhs.costhist[c];
+        for(int l = 0; l < MAX_CASCADE_LEVELS; ++l)
+        {
+            levelaligned[l] += rhs.levelaligned[l];
+            levelaccepted[l] += rhs.levelaccepted[l];
+            levelpruned[l] += rhs.levelpruned[l];
+            levelescalated[l] += rhs.levelescalated[l];
+        }
+        return *this;
     }
-    return free_memory;
+};
+
+/**
+ * @brief AlignmentThreshold is the score an extension must exceed to pass: adaptive, from the overlap it implies, or fixed
+ */
+double AlignmentThreshold(const seqAnResult & maxExtScore, int read1len, int read2len, const BELLApars & b_pars, double ratioPhi)
+{
+	if(!b_pars.adapThr)
+		return b_pars.defaultThr;
+
+	auto maxseed = maxExtScore.seed;
+	int begpV = beginPositionV(maxseed);
+	int endpV = endPositionV(maxseed);
+	int begpH = beginPositionH(maxseed);
+	int endpH = endPositionH(maxseed);
+
+    int diffCol = endpV - begpV;
+    int diffRow = endpH - begpH;
+    int minLeft = min(begpV, begpH);
+    int minRight = min(read2len - endpV, read1len - endpH);
+    int ov = minLeft+minRight+(diffCol+diffRow)/2;
+
+	return (1-b_pars.deltaChernoff)*(ratioPhi*(double)ov);
+}
+
+/**
+ * @brief AlignmentPasses applies the adaptive (or fixed) score threshold and the optional alignment-on-edge constraint
+ */
+bool AlignmentPasses(const seqAnResult & maxExtScore, int read1len, int read2len, const BELLApars & b_pars, double ratioPhi)
+{
+	if(maxExtScore.earlyExit)	// stopped because the threshold was out of reach
+		return false;
+
+	auto maxseed = maxExtScore.seed;
+	int begpV = beginPositionV(maxseed);
+	int endpV = endPositionV(maxseed);
+	int begpH = beginPositionH(maxseed);
+	int endpH = endPositionH(maxseed);
+
+	bool passed = false;
+	if((double)maxExtScore.score > AlignmentThreshold(maxExtScore, read1len, read2len, b_pars, ratioPhi))
+	{
+		if(b_pars.alignEnd)
+		{
+			if(toEnd(begpV, endpV, read2len, begpH, endpH, read1len, b_pars.relaxMargin))
+				passed = true;
+		}
+		else 
+		{
+			passed = true;
+		}
+	}
+
+	return passed;
+}
+
+/**
+ * @brief CascadeThreshold is a score that no extension inside the band can exceed without passing AlignmentPasses' threshold
+ * An extension starts on the first row or column and ends on the last row or column, so the overlap AlignmentPasses
+ * tests is half the bases it covers on the two reads: rlen+clen-|ds|-|de-(clen-rlen)| for start and end diagonals ds and
+ * de. Taking ds and de as far as the band allows gives the smallest overlap of any extension in the band, and an
+ * extension scoring at or below the threshold of that overlap fails the final test whatever its actual overlap
+ * @param rlen row read length
+ * @param clen column read length
+ * @param diag seed diagonal (column pos - row pos, on the strand of the alignment)
+ * @param halfBand
+ */
+int CascadeThreshold(int rlen, int clen, int diag, int halfBand, const BELLApars & b_pars, double ratioPhi)
+{
+	if(!b_pars.adapThr)
+		return b_pars.defaultThr;
+
+	int lo = max(diag-halfBand, -rlen);	// diagonals of the band inside the matrix
+	int hi = min(diag+halfBand, clen);
+	int startoff = max(abs(lo), abs(hi));
+	int endoff = max(abs(lo-(clen-rlen)), abs(hi-(clen-rlen)));
+	int ovmin = max(0, (rlen+clen-startoff-endoff)/2);
+	return (int)floor((1-b_pars.deltaChernoff)*(ratioPhi*(double)ovmin));
+}
+
+/**
+ * @brief CascadeAlign extends a seed through the levels of the alignment cascade (b_pars.cascadeBands)
+ * A level's result is final if it passes the threshold, if it scores below cascadeCutoff times the threshold of its own
+ * overlap, or if it is the last level; otherwise the pair is borderline and is extended again with the band of the
+ * next level. A level that stopped early has no alignment able to pass inside its band (see CascadeThreshold), but a
+ * wider band may have one, so the pair goes on to the next level as well
+ */
+seqAnResult CascadeAlign(const readType_ & read1, const readType_ & read2, int i, int j, int kmer_len, 
+					const BELLApars & b_pars, double ratioPhi, alignContext_ & ctx, alignStats_ & stats)
+{
+	int read1len = read1.seq.length();
+	int read2len = read2.seq.length();
+	int diag = seedDiagonal(i, j, read1len, seedSpan(read1.seq, i, kmer_len), seedStrand(read1.seq, read2.seq, i, j, kmer_len));
+	int nlevels = b_pars.cascadeBands.size();
+
+	seqAnResult maxExtScore;
+	for(int l = 0; l < nlevels; ++l)
+	{
+		int band = b_pars.cascadeBands[l];
+		int halfBand = (band > 0) ? band/2 : read1len+read2len;
+		int thr = CascadeThreshold(read1len, read2len, diag, halfBand, b_pars, ratioPhi);
+		size_t cells;
+
+		maxExtScore = alignSeqAnBanded(read1, read2, i, j, kmer_len, band, thr, ctx, cells);
+		stats.levelaligned[l]++;
+		stats.cells += cells;
+
+		if(maxExtScore.earlyExit)
+			stats.levelpruned[l]++;
+		else if(AlignmentPasses(maxExtScore, read1len, read2len, b_pars, ratioPhi))
+		{
+			stats.levelaccepted[l]++;
+			break;
+		}
+		if(l == nlevels-1)
+			break;
+		if(!maxExtScore.earlyExit && maxExtScore.score < b_pars.cascadeCutoff*AlignmentThreshold(maxExtScore, read1len, read2len, b_pars, ratioPhi))
+			break;
+
+		stats.levelescalated[l]++;
+	}
+	return maxExtScore;
 }
 
 void PostAlignDecision(const seqAnResult & maxExtScore, const readType_ & read1, const readType_ & read2, 
-					const BELLApars & b_pars, double ratioPhi, int count, stringstream & myBatch, size_t & outputted,
+					const BELLApars & b_pars, double ratioPhi, int count, OutputStream & myBatch, size_t & outputted,
 					size_t & numBasesAlignedTrue, size_t & numBasesAlignedFalse, bool & passed)
 {
 	auto maxseed = maxExtScore.seed;	// returns a seqan:Seed object
@@ -436,42 +545,29 @@ void PostAlignDecision(const seqAnResult & maxExtScore, const readType_ & read1,
     int minRight = min(read2len - endpV, read1len - endpH);
     int ov = minLeft+minRight+(diffCol+diffRow)/2;
 
-	if(b_pars.adapThr)
-	{
-		double newThr = (1-b_pars.deltaChernoff)*(ratioPhi*(double)ov);
-
-		if((double)maxExtScore.score > newThr)
-		{
-			if(b_pars.alignEnd)
-			{
-				if(toEnd(begpV, endpV, read2len, begpH, endpH, read1len, b_pars.relaxMargin))
-					passed = true;
-			}
-			else 
-			{
-				passed = true;
-			}
-		}
-	}
-	else if(maxExtScore.score > b_pars.defaultThr)
-	{
-		if(b_pars.alignEnd)
-		{
-			if(toEnd(begpV, endpV, read2len, begpH, endpH, read1len, b_pars.relaxMargin))
-				passed = true;
-		}
-		else 
-		{
-			passed = true;
-		}
-	}
+	passed = AlignmentPasses(maxExtScore, read1len, read2len, b_pars, ratioPhi);
 
 	if(passed)
 	{
-        if(!b_pars.outputPaf)  // BELLA output format
+        if(b_pars.outputBinary)     // fixed-width record, the read table is in the file header (overlapformat.h)
+        {
+            ovlRecord_ record;
+            record.idV = read2.readid;
+            record.idH = read1.readid;
+            record.begV = begpV;
+            record.endV = endpV;
+            record.begH = begpH;
+            record.endH = endpH;
+            record.score = maxExtScore.score;
+            record.count = count;
+            record.strand = maxExtScore.strand[0];
+            memset(record.pad, 0, sizeof(record.pad));
+            myBatch.write(&record, sizeof(record));
+        }
+        else if(!b_pars.outputPaf)  // BELLA output format
         {
             myBatch << read2.nametag << '\t' << read1.nametag << '\t' << count << '\t' << maxExtScore.score << '\t' << ov << '\t' << maxExtScore.strand << '\t' << 
-                begpV << '\t' << endpV << '\t' << read2len << '\t' << begpH << '\t' << endpH << '\t' << read1len << endl;
+                begpV << '\t' << endpV << '\t' << read2len << '\t' << begpH << '\t' << endpH << '\t' << read1len << '\n';
                 // column seq name
                 // row seq name
                 // number of shared k-mer
@@ -487,6 +583,16 @@ void PostAlignDecision(const seqAnResult & maxExtScore, const readType_ & read1,
         }
         else    // PAF format is the output format used by minimap/minimap2: https://github.com/lh3/miniasm/blob/master/PAF.md
         {
+            /* traceback only for accepted pairs: the CIGAR covers the reported block, on the forward strand of the target */
+            string cigar;
+            if(b_pars.outputCigar)
+            {
+                size_t cbegpV = begpV, cendpV = endpV, cbegpH = begpH, cendpH = endpH;
+                extendToEnds(cbegpV, cendpV, read2len, cbegpH, cendpH, read1len);
+                const Dna5String & seqH = (maxExtScore.strand == "c") ? read1.dna5rc : read1.dna5;
+                lazyCigar(seqH, read2.dna5, cbegpH, cendpH, cbegpV, cendpV, maxExtScore.strand == "c", cigar);
+            }
+
             /* field adjustment to match the PAF format */
             toPAF(begpV, endpV, read2len, begpH, endpH, read1len, maxExtScore.strand);
             /* re-compute overlap estimation with extended alignment to the edges */
@@ -504,7 +610,10 @@ void PostAlignDecision(const seqAnResult & maxExtScore, const readType_ & read1,
             // If PAF is generated from an alignment, column 10 equals the number of sequence matches, 
             // and column 11 equals the total number of sequence matches, mismatches, insertions and deletions in the alignment     
             myBatch << read2.nametag << '\t' << read2len << '\t' << begpV << '\t' << endpV << '\t' << pafstrand << '\t' << 
-                read1.nametag << '\t' << read1len << '\t' << begpH << '\t' << endpH << '\t' << maxExtScore.score << '\t' << ov << '\t' << mapq << endl;
+                read1.nametag << '\t' << read1len << '\t' << begpH << '\t' << endpH << '\t' << maxExtScore.score << '\t' << ov << '\t' << mapq;
+            if(b_pars.outputCigar)
+                myBatch << '\t' << "cg:Z:" << cigar;
+            myBatch << '\n';
                 // column seq name
                 // column seq length
                 // column seq start
@@ -517,6 +626,7 @@ void PostAlignDecision(const seqAnResult & maxExtScore, const readType_ & read1,
                 // number of residue matches (alignment score)
                 // alignment block length (overlap length)
                 // mapping quality (0-255; 255 for missing)
+                // CIGAR of the block, query is the column seq, reverse-complemented for '-' (optional, -C)
         }
 		++outputted;
 		numBasesAlignedTrue += (endpV-begpV);	
@@ -528,36 +638,29 @@ void PostAlignDecision(const seqAnResult & maxExtScore, const readType_ & read1,
 }
 
 template <typename IT, typename FT>
-auto RunPairWiseAlignments(IT start, IT end, IT offset, IT * colptrC, IT * rowids, FT * values, const readVector_ & reads, 
-								int kmer_len, int xdrop, char* filename, const BELLApars & b_pars, double ratioPhi)
+auto RunPairWiseAlignments(IT start, IT end, IT offset, const IT * colptrC, const IT * rowids, const FT * values, const readVector_ & reads, 
+								int kmer_len, OverlapWriter & writer, const BELLApars & b_pars, double ratioPhi, vector<alignContext_> & contexts)
 {
-    size_t alignedpairs = 0;
-    size_t alignedbases = 0;
-    size_t totalreadlen = 0;
-    size_t totaloutputt = 0;
-    size_t totsuccbases = 0;
-    size_t totfailbases = 0;
+    alignStats_ stagestats;
+    size_t bytesbefore = writer.byteswritten;
     
     int numThreads = 1;
 #pragma omp parallel
     {
         numThreads = omp_get_num_threads();
     }
+    vector<alignStats_> threadstats(numThreads);
+    vector<double> threadtime(numThreads, 0);
 
-    vector<stringstream> vss(numThreads); // any chance of false sharing here? depends on how stringstream is implemented. optimize later if needed...
+#pragma omp parallel
+  {
+    int ithread = omp_get_thread_num();
+    double threadstart = omp_get_wtime();
 
-#pragma omp parallel for
+#pragma omp for nowait
     for(IT j = start; j<end; ++j) // for (end-start) columns of A^T A (one block)
     {
-        size_t numAlignmentsThread = 0;
-        size_t numBasesAlignedThread = 0;
-        size_t readLengthsThread = 0;
-        size_t numBasesAlignedTrue = 0;
-        size_t numBasesAlignedFalse = 0;
-
-        size_t outputted = 0;
-
-        int ithread = omp_get_thread_num();	
+        alignStats_ colstats;
 
         for (IT i = colptrC[j]; i < colptrC[j+1]; ++i)  // all nonzeros in that column of A^T A
         {
@@ -573,112 +676,143 @@ auto RunPairWiseAlignments(IT start, IT end, IT offset, IT * colptrC, IT * rowid
 
             if(!b_pars.skipAlignment) // fix -z to not print 
             {
+                const vector<pair<int,int>> * seeds = &val->pos;  // val is shared, only read it
+                if(b_pars.diagFilter)
+                {
+                    bool sameStrand;
+                    seeds = &contexts[ithread].seeds;
+                    if(!diagonalFilter(val->pos, seq1, seq2, kmer_len, b_pars.errorRate, sameStrand, contexts[ithread].seeds))
+                    {
+                        if(sameStrand) colstats.filtereddiag++;
+                        else colstats.filteredstrand++;
+                        continue;   // seeds disagree, skip the alignment
+                    }
+                }
 #ifdef TIMESTEP
-                numAlignmentsThread++;
-                readLengthsThread = readLengthsThread + seq1len + seq2len;
+                colstats.alignedpairs++;
+                colstats.totalreadlen += seq1len + seq2len;
 #endif
                 seqAnResult maxExtScore;
                 bool passed = false;
+                size_t cellsbefore = colstats.cells;
 
                 if(val->count == 1)
                 {
-                    auto it = val->pos.begin();
+                    auto it = seeds->begin();
                     int i = it->first, j = it->second;
 
-                    maxExtScore = alignSeqAn(seq1, seq2, seq1len, i, j, xdrop, kmer_len);
-                    PostAlignDecision(maxExtScore, reads[rid], reads[cid], b_pars, ratioPhi, val->count, vss[ithread], outputted, numBasesAlignedTrue, numBasesAlignedFalse, passed);
+                    if(b_pars.cascadeBands.empty())
+                    {
+                        maxExtScore = alignSeqAn(reads[rid], reads[cid], i, j, kmer_len, contexts[ithread]);
+                        colstats.cells += (size_t)seq1len * seq2len;
+                    }
+                    else
+                        maxExtScore = CascadeAlign(reads[rid], reads[cid], i, j, kmer_len, b_pars, ratioPhi, contexts[ithread], colstats);
+                    PostAlignDecision(maxExtScore, reads[rid], reads[cid], b_pars, ratioPhi, val->count, writer.stream(ithread), colstats.outputted, colstats.alignedtrue, colstats.alignedfalse, passed);
                 }
                 else
                 {
-                    for(auto it = val->pos.begin(); it != val->pos.end(); ++it) // if !b_pars.allKmer this should be at most two cycle
+                    // without a cascade the full DP depends on the strand of the seed only: one extension per strand,
+                    // with a cascade the banded extensions of seeds on nearby diagonals are remembered by their span
+                    bool fullDP = b_pars.cascadeBands.empty();
+                    bool extended[2] = {false, false};     // strand 'n', 'c'
+                    int diagTolerance = fullDP ? 0 : max(1, b_pars.cascadeBands[0]/2);
+                    contexts[ithread].spans.clear();
+
+                    for(auto it = seeds->begin(); it != seeds->end(); ++it) // if !b_pars.allKmer this should be at most two cycle
                     {
                         int i = it->first, j = it->second;
 
-                        maxExtScore = alignSeqAn(seq1, seq2, seq1len, i, j, xdrop, kmer_len);
-                        PostAlignDecision(maxExtScore, reads[rid], reads[cid], b_pars, ratioPhi, val->count, vss[ithread], outputted, numBasesAlignedTrue, numBasesAlignedFalse, passed);
+                        char strand = seedStrand(seq1, seq2, i, j, kmer_len);
+                        int span = seedSpan(seq1, i, kmer_len);
+                        int diag = seedDiagonal(i, j, seq1len, span, strand);
+                        if(fullDP)
+                        {
+                            if(extended[strand == 'c'])
+                            {
+                                colstats.cacheskipped++;    // same DP as the extension that failed already
+                                continue;
+                            }
+                            extended[strand == 'c'] = true;
+                            maxExtScore = alignSeqAn(reads[rid], reads[cid], i, j, kmer_len, contexts[ithread]);
+                            colstats.cells += (size_t)seq1len * seq2len;
+                        }
+                        else
+                        {
+                            int iH = (strand == 'c') ? seq1len-i-span : i;
+                            if(seedCovered(contexts[ithread], strand, diag, iH, j, span, diagTolerance))
+                            {
+                                colstats.cacheskipped++;
+                                continue;
+                            }
+                            maxExtScore = CascadeAlign(reads[rid], reads[cid], i, j, kmer_len, b_pars, ratioPhi, contexts[ithread], colstats);
+                        }
+                        PostAlignDecision(maxExtScore, reads[rid], reads[cid], b_pars, ratioPhi, val->count, writer.stream(ithread), colstats.outputted, colstats.alignedtrue, colstats.alignedfalse, passed);
 
                         if(passed)
                             break;
+                        if(!fullDP)
+                            recordSpan(contexts[ithread], strand, diag, maxExtScore.seed);
                     }
                 }
 #ifdef TIMESTEP
-            numBasesAlignedThread += endPositionV(maxExtScore.seed)-beginPositionV(maxExtScore.seed);
+            colstats.alignedbases += endPositionV(maxExtScore.seed)-beginPositionV(maxExtScore.seed);
+            size_t paircells = colstats.cells - cellsbefore;
+            if(paircells > 0)
+                colstats.costhist[min(COST_BUCKETS-1, 63-__builtin_clzll(paircells))]++;
 #endif
             }
             else // if skipAlignment == false do alignment, else save just some info on the pair to file
             {
-                vss[ithread] << reads[cid].nametag << '\t' << reads[rid].nametag << '\t' << val->count << '\t' << 
-                        seq2len << '\t' << seq1len << endl;
-                ++outputted;
+                writer.stream(ithread) << reads[cid].nametag << '\t' << reads[rid].nametag << '\t' << val->count << '\t' << 
+                        seq2len << '\t' << seq1len << '\n';
+                ++colstats.outputted;
             }
         } // all nonzeros in that column of A^T A
 
 #ifdef TIMESTEP	
-        #pragma omp critical
-        {
-            alignedpairs += numAlignmentsThread;
-            alignedbases += numBasesAlignedThread;
-            totalreadlen += readLengthsThread;
-            totaloutputt += outputted;
-            totsuccbases += numBasesAlignedTrue;
-            totfailbases += numBasesAlignedFalse;
-        }
+        threadstats[ithread] += colstats;
 #endif
     } // all columns from start...end (omp for loop)
+    threadtime[ithread] = omp_get_wtime() - threadstart;
+  }
 
-    double outputting = omp_get_wtime();
-
-    int64_t * bytes = new int64_t[numThreads];
-    for(int i=0; i< numThreads; ++i)
+    // load balance: a thread's time covers its share of the columns, it does not wait for the others (nowait)
+    stagestats.threadtimemin = threadtime[0];
+    stagestats.threadgcupsmin = stagestats.threadgcupsmax = threadstats[0].cells / max(threadtime[0], 1e-9) / 1e9;
+    for(int t = 0; t < numThreads; ++t)
     {
-        vss[i].seekg(0, ios::end);
-        bytes[i] = vss[i].tellg();
-        vss[i].seekg(0, ios::beg);
+        stagestats += threadstats[t];
+        double gcups = threadstats[t].cells / max(threadtime[t], 1e-9) / 1e9;
+        stagestats.threadtimemax = max(stagestats.threadtimemax, threadtime[t]);
+        stagestats.threadtimemin = min(stagestats.threadtimemin, threadtime[t]);
+        stagestats.threadgcupsmax = max(stagestats.threadgcupsmax, gcups);
+        stagestats.threadgcupsmin = min(stagestats.threadgcupsmin, gcups);
+        stagestats.threadtimemean += threadtime[t] / numThreads;
     }
-    int64_t bytestotal = std::accumulate(bytes, bytes+numThreads, static_cast<int64_t>(0));
 
-    std::ofstream ofs(filename, std::ios::binary | std::ios::app);
-#ifdef PRINT
-    cout << "Creating or appending to output file with " << (double)bytestotal/(double)(1024 * 1024) << " MB" << endl;
-#endif
-    ofs.seekp(bytestotal - 1);
-    ofs.write("", 1); // this will likely create a sparse file so the actual disks won't spin yet
-    ofs.close();
+    double outputting = omp_get_wtime();
 
-    #pragma omp parallel
-    {
-        int ithread = omp_get_thread_num();	
+    // lines went to the writer thread while aligning, only the last partially filled buffers are left
+    writer.flush();
+    cout << "Appended " << (double)(writer.byteswritten-bytesbefore)/(double)(1024 * 1024) << " MB to the output file" << endl;
+    stagestats.timeoutputt = omp_get_wtime()-outputting;
 
-        FILE *ffinal;
-        if ((ffinal = fopen(filename, "rb+")) == NULL)	// then everyone fills it
-        {
-            fprintf(stderr, "File %s failed to open at thread %d\n", filename, ithread);
-        }
-        int64_t bytesuntil = std::accumulate(bytes, bytes+ithread, static_cast<int64_t>(0));
-        fseek (ffinal , bytesuntil , SEEK_SET );
-        std::string text = vss[ithread].str();
-        fwrite(text.c_str(),1, bytes[ithread] ,ffinal);
-        fflush(ffinal);
-        fclose(ffinal);
-    }
-    delete [] bytes;
-    double timeoutputt = omp_get_wtime()-outputting;
-
-    return make_tuple(alignedpairs, alignedbases, totalreadlen, totaloutputt, totsuccbases, totfailbases, timeoutputt);
+    return stagestats;
 }
 
 
 /**
   * Sparse multithreaded GEMM.
  **/
-template <typename IT, typename NT, typename FT, typename MultiplyOperation, typename AddOperation>
+template <typename IT, typename NT, typename MultiplyOperation, typename AddOperation>
 void HashSpGEMM(const CSC<IT,NT> & A, const CSC<IT,NT> & B, MultiplyOperation multop, AddOperation addop, const readVector_ & reads, 
-    FT & getvaluetype, int kmer_len, int xdrop, char* filename, const BELLApars & b_pars, double ratioPhi)
+    int kmer_len, char* filename, const BELLApars & b_pars, double ratioPhi, memoryPlan_ & plan, StageLog & stagelog)
 {
-    double free_memory = estimateMemory(b_pars);
-
+    typedef typename std::decay<decltype(multop(A.values[0], B.values[0]))>::type FT;    // values of C
+    ScopedPhase phase("overlap and alignment");
 #ifdef PRINT
-    cout << "Available RAM is assumed to be: " << free_memory / (1024 * 1024) << " MB" << endl;
+    cout << "Available RAM is assumed to be: " << plan.budget / (1024 * 1024) << " MB" << endl;
 #endif
 
     int numThreads = 1;
@@ -687,32 +821,52 @@ void HashSpGEMM(const CSC<IT,NT> & A, const CSC<IT,NT> & B, MultiplyOperation mu
         numThreads = omp_get_num_threads();
     }
 
+    // streams the output while aligning, with a fixed memory footprint; with -M, C goes to the candidate file instead
+    std::unique_ptr<OverlapWriter> writer;
+    CandidateWriter candidates;
+    bool candidatemode = !b_pars.candidateFile.empty();
+    if(!candidatemode)
+        writer.reset(new OverlapWriter(filename, numThreads, plan.writerBuffer));
+
     IT* flopC = estimateFLOP(A, B, true);
     IT* flopptr = prefixsum<IT>(flopC, B.cols, numThreads);
     IT flops = flopptr[B.cols];
 
-#ifdef PRINT    
-    cout << "FLOPS is " << flops << endl;
-#endif
-
     IT* colnnzC = estimateNNZ_Hash(A, B, flopC, true);
     IT* colptrC = prefixsum<IT>(colnnzC, B.cols, numThreads);	// colptrC[i] = rolling sum of nonzeros in C[1...i]
     delete [] colnnzC;
-    delete [] flopptr;
     delete [] flopC;
     IT nnzc = colptrC[B.cols];
     double compression_ratio = (double)flops / nnzc;
 
-
-    uint64_t required_memory = safety_net * nnzc * (sizeof(FT)+sizeof(IT));	// required memory to form the output
-    int stages = std::ceil((double) required_memory/ free_memory); 	// form output in stages 
-    uint64_t nnzcperstage = free_memory / (safety_net * (sizeof(FT)+sizeof(IT)));
+    // the cost of the overlap detection is known before any stage runs
+    cout << "FLOPS is " << flops;
+    if(plan.spectrumFlops > 0)
+        cout << " (" << plan.spectrumFlops << " predicted from the k-mer spectrum)";
+    cout << " | candidate pairs: " << nnzc << " | compression ratio: " << compression_ratio << endl;
+
+    IT maxcolnnz = 0;
+    for(IT i = 0; i < B.cols; ++i)
+        maxcolnnz = std::max(maxcolnnz, colptrC[i+1]-colptrC[i]);
+    size_t maxreadlen = 0;
+    for(size_t i = 0; i < reads.size(); ++i)
+        maxreadlen = std::max(maxreadlen, reads[i].seq.length());
+    size_t alignBytes = b_pars.skipAlignment ? 0 : numThreads * maxreadlen * 4 * sizeof(int);    // alignContext_ rows and DP vectors
+
+    // form output in stages: the values (and their heap) of a stage must fit next to the reads and the matrices
+    uint64_t nnzcperstage = planSpGEMM<IT,FT>(plan, flops, nnzc, maxcolnnz, A.nnz, b_pars.allKmer, alignBytes);
+    int stages = plan.stages;
+    uint64_t required_memory = safety_net * nnzc * plan.nnzBytes;	// required memory to form the output
 
 #ifdef PRINT
-    cout << "nnz(output): " << nnzc << " | free memory: " << free_memory << " | required memory: " << required_memory << endl; 
+    printPlan(plan, "SpGEMM");
+    cout << "nnz(output): " << nnzc << " | free memory: " << plan.budget - plan.residentBytes << " | required memory: " << required_memory << endl; 
     cout << "Stages: " << stages << " | max nnz per stage: " << nnzcperstage << endl;    
 #endif
 
+    if(candidatemode && !candidates.open(b_pars.candidateFile.c_str(), reads, colptrC, b_pars, kmer_len))
+        exit(1);
+
     IT * colStart = new IT[stages+1];	// one array is enough to set stage boundaries	              
     colStart[0] = 0;
 
@@ -725,18 +879,32 @@ void HashSpGEMM(const CSC<IT,NT> & A, const CSC<IT,NT> & B, MultiplyOperation mu
     }
     colStart[stages] = B.cols;
 
+    IT resumecol = stagelog.done();     // columns completed by a previous run (-R), whatever its stage boundaries were
+    if(resumecol > 0)
+    {
+        for(int i = 0; i <= stages; ++i)
+            colStart[i] = std::max(colStart[i], resumecol);
+        cout << "Resuming from column " << resumecol << " of " << B.cols << " (" << stagelog.stages() << " stages completed)" << endl;
+    }
+
+    size_t filteredpairs = 0;
+    size_t totalcells = 0;
+    double totalaligntime = 0;
+    vector<alignContext_> contexts(numThreads);   // per-thread alignment buffers, reused across stages
+
     for(int b = 0; b < stages; ++b) 
     {
-#ifdef TIMESTEP
+        if(colStart[b] == colStart[b+1])  // completed before resuming
+            continue;
         double ovl = omp_get_wtime();
-#endif
+        telemetry.begin("spgemm");
         vector<IT> * RowIdsofC = new vector<IT>[colStart[b+1]-colStart[b]];    // row ids for each column of C (bunch of cols)
         vector<FT> * ValuesofC = new vector<FT>[colStart[b+1]-colStart[b]];    // values for each column of C (bunch of cols)
 
         LocalSpGEMM(colStart[b], colStart[b+1], A, B, multop, addop, RowIdsofC, ValuesofC, colptrC, true);
 
-#ifdef TIMESTEP
         double ov2 = omp_get_wtime();
+#ifdef TIMESTEP
         cout << "\nColumns [" << colStart[b] << " - " << colStart[b+1] << "] overlap time: " << ov2-ovl << "s" << endl;
 #endif
 
@@ -756,28 +924,100 @@ void HashSpGEMM(const CSC<IT,NT> & A, const CSC<IT,NT> & B, MultiplyOperation mu
 
         delete [] RowIdsofC;
         delete [] ValuesofC;
+        telemetry.end();
 
-        tuple<size_t, size_t, size_t, size_t, size_t, size_t, double> alignstats; // (alignedpairs, alignedbases, totalreadlen, outputted, alignedtrue, alignedfalse, timeoutputt)
-        alignstats = RunPairWiseAlignments(colStart[b], colStart[b+1], begnz, colptrC, rowids, values, reads, kmer_len, xdrop, filename, b_pars, ratioPhi);
+        if(candidatemode)   // the alignment is left to bella-align
+        {
+            candidates.writeStage(begnz, endnz, rowids, values);
+            IT stageflops = flopptr[colStart[b+1]] - flopptr[colStart[b]];
+            telemetry.stage({ {"stage", b}, {"first_column", colStart[b]}, {"last_column", colStart[b+1]}, {"flops", stageflops},
+                {"nnz", endnz-begnz}, {"spgemm_s", ov2-ovl}, {"candidates_s", omp_get_wtime()-ov2} });
+            cout << "Columns [" << colStart[b] << " - " << colStart[b+1] << "] written to the candidate matrix in " << omp_get_wtime()-ov2 << "s" << endl;
+            delete [] rowids;
+            delete [] values;
+            continue;
+        }
+
+        telemetry.begin("alignment");
+        alignStats_ alignstats;
+        alignstats = RunPairWiseAlignments(colStart[b], colStart[b+1], begnz, colptrC, rowids, values, reads, kmer_len, *writer, b_pars, ratioPhi, contexts);
+        telemetry.end();
+        double ov3 = omp_get_wtime();
+
+        double aligntime = ov3-ov2-alignstats.timeoutputt;   // substracting outputting time
+        double gcups = alignstats.cells / aligntime / 1e9;
+        double imbalance = alignstats.threadtimemax / alignstats.threadtimemean;
+        totalcells += alignstats.cells;
+        totalaligntime += aligntime;
+
+        IT stageflops = flopptr[colStart[b+1]] - flopptr[colStart[b]];
+        metrics_ stagemetrics = { {"stage", b}, {"first_column", colStart[b]}, {"last_column", colStart[b+1]}, {"flops", stageflops}, {"nnz", endnz-begnz},
+            {"compression_ratio", (double)stageflops/(endnz-begnz)}, {"spgemm_s", ov2-ovl}, {"alignment_s", aligntime},
+            {"output_s", alignstats.timeoutputt}, {"pairs_aligned", alignstats.alignedpairs}, {"pairs_filtered", alignstats.filteredstrand+alignstats.filtereddiag},
+            {"pairs_output", alignstats.outputted}, {"seeds_skipped", alignstats.cacheskipped}, {"cells", alignstats.cells}, {"gcups", gcups},
+            {"thread_gcups_min", alignstats.threadgcupsmin}, {"thread_gcups_max", alignstats.threadgcupsmax},
+            {"thread_time_min_s", alignstats.threadtimemin}, {"thread_time_max_s", alignstats.threadtimemax}, {"load_imbalance", imbalance} };
+        for(int c = 0; c < COST_BUCKETS; ++c)
+            if(alignstats.costhist[c] > 0)
+                stagemetrics.push_back(make_pair("pairs_cells_log2_" + to_string(c), (double)alignstats.costhist[c]));
+        telemetry.stage(stagemetrics);
 
 #ifdef TIMESTEP
         if(!b_pars.skipAlignment)
         {
-	    	double elapsed = omp_get_wtime()-ov2;
-            double aligntime = elapsed-get<6>(alignstats); // substracting outputting time
-            cout << "\nColumns [" << colStart[b] << " - " << colStart[b+1] << "] alignment time: " << aligntime << "s | alignment rate: " << static_cast<double>(get<1>(alignstats))/aligntime;
-            cout << " bases/s | average read length: " <<static_cast<double>(get<2>(alignstats))/(2* get<0>(alignstats));
-            cout << " | read pairs aligned this stage: " << get<0>(alignstats) << endl;
-            cout << "Average length of successful alignment " << static_cast<double>(get<4>(alignstats)) / get<3>(alignstats) << " bps" << endl;
-            cout << "Average length of failed alignment " << static_cast<double>(get<5>(alignstats)) / (get<0>(alignstats) - get<3>(alignstats)) << " bps" << endl;		
+            cout << "\nColumns [" << colStart[b] << " - " << colStart[b+1] << "] alignment time: " << aligntime << "s | alignment rate: " << static_cast<double>(alignstats.alignedbases)/aligntime;
+            cout << " bases/s | average read length: " <<static_cast<double>(alignstats.totalreadlen)/(2* alignstats.alignedpairs);
+            cout << " | read pairs aligned this stage: " << alignstats.alignedpairs << endl;
+            cout << "Average length of successful alignment " << static_cast<double>(alignstats.alignedtrue) / alignstats.outputted << " bps" << endl;
+            cout << "Average length of failed alignment " << static_cast<double>(alignstats.alignedfalse) / (alignstats.alignedpairs - alignstats.outputted) << " bps" << endl;		
+            if(b_pars.diagFilter)
+                cout << "Pairs filtered before alignment this stage: " << alignstats.filteredstrand+alignstats.filtereddiag << " (strand: " << alignstats.filteredstrand << " | diagonal: " << alignstats.filtereddiag << ")" << endl;
+            cout << "Seeds skipped (already covered by an extension of the same pair) this stage: " << alignstats.cacheskipped << endl;
+            for(size_t l = 0; l < b_pars.cascadeBands.size(); ++l)
+                cout << "Cascade level " << l << " (band " << b_pars.cascadeBands[l] << "): extensions " << alignstats.levelaligned[l] << " | accepted " << alignstats.levelaccepted[l] << 
+                    " | stopped early " << alignstats.levelpruned[l] << " | escalated " << alignstats.levelescalated[l] << endl;
+            cout << "DP cells: " << alignstats.cells << " | GCUPS: " << gcups << " (per thread " << alignstats.threadgcupsmin << " - " << alignstats.threadgcupsmax << 
+                ") | load imbalance (max/mean thread time): " << imbalance << endl;
+            cout << "Pairs by alignment cost (DP cells):";
+            for(int c = 0; c < COST_BUCKETS; ++c)
+                if(alignstats.costhist[c] > 0)
+                    cout << " [2^" << c << "]=" << alignstats.costhist[c];
+            cout << endl;
        }
 #endif
-        cout << "\nOutputted " << get<3>(alignstats) << " lines in " << get<6>(alignstats) << "s" << endl;
+        filteredpairs += alignstats.filteredstrand+alignstats.filtereddiag;
+        cout << "\nOutputted " << alignstats.outputted << " lines in " << alignstats.timeoutputt << "s" << endl;
+        if(stagelog.enabled() && !(writer->sync() && stagelog.append(colStart[b], colStart[b+1], writer->size())))
+            cout << "Checkpoint of columns [" << colStart[b] << " - " << colStart[b+1] << "] failed: a resumed run will recompute them" << endl;
         delete [] rowids;
         delete [] values;
 
     }//for(int b = 0; b < states; ++b)
 
+    if(b_pars.diagFilter)
+        cout << "\nTotal pairs filtered by the diagonal pre-filter: " << filteredpairs << endl;
+    if(!b_pars.skipAlignment && totalaligntime > 0)
+    {
+        cout << "\nTotal DP cells: " << totalcells << " | GCUPS: " << totalcells / totalaligntime / 1e9 << endl;
+        telemetry.metric("cells", totalcells);
+        telemetry.metric("gcups", totalcells / totalaligntime / 1e9);
+    }
+
+    telemetry.metric("flops", flops);
+    telemetry.metric("nnz_c", nnzc);
+    telemetry.metric("compression_ratio", compression_ratio);
+    telemetry.metric("stages", stages);
+    if(candidatemode)
+    {
+        if(candidates.finish())
+            cout << "\nCandidate matrix: " << nnzc << " pairs, " << candidates.seeds() << " seeds written to " << b_pars.candidateFile << endl;
+        else
+            exit(1);
+    }
+    else
+        telemetry.metric("output_bytes", writer->byteswritten);
+
+    delete [] flopptr;
     delete [] colptrC;
     delete [] colStart;
 }
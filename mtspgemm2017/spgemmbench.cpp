@@ -0,0 +1,434 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "../optlist/optlist.h" /* command line parser */
+#include "GTgraph/R-MAT/defs.h"
+#include "GTgraph/R-MAT/init.h"
+#include "GTgraph/R-MAT/graph.h"
+#ifdef __cplusplus
+}
+#endif
+
+#include <omp.h>
+#include <stdio.h>
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <functional>
+#include <fstream>
+#include <sstream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include "../kmercode/hash_funcs.h"
+#include "../kmercode/Kmer.hpp"
+#include "../kmercode/Buffer.h"
+#include "../kmercode/common.h"
+#include "../kmercode/fq_reader.h"
+#include "../kmercode/ParallelFASTQ.h"
+
+#include "utility.h"
+#include "CSC.h"
+#include "common.h"
+#include "overlapping.h"
+#include "synthetic.h"
+
+using namespace std;
+
+//
+// spgemm-bench: the overlap kernel of BELLA, C = lower triangle of A * A^T, on its own
+// A is an R-MAT (or Erdos-Renyi) graph from GTgraph, a matrix file written by bella -S, or a synthetic reads x k-mers
+// incidence matrix (synthetic.h). Every variant runs with every thread count, the fastest of -n runs is kept
+//
+//   symbolic   estimateFLOP and estimateNNZ_Hash, the column sizes of C
+//   count      LocalSpGEMM counting the shared k-mers of every pair (one integer per nonzero)
+//   overlap    LocalSpGEMM with the values of main.cpp: shared k-mer count and up to two seed positions
+//
+// The numeric variants go through the columns in -s stages with balanced nonzeros, as HashSpGEMM does. Bandwidth
+// counts the entries of A fetched once per flop, B read once and C written once, so it is a lower bound of the traffic
+//
+
+struct spgemmResult_ {
+    string variant;
+    int threads;
+    double seconds;
+    double bytes;
+};
+
+/* stage boundaries with at most nnzc / stages nonzeros per stage, as in HashSpGEMM */
+vector<size_t> stageColumns(const size_t * colptrC, size_t cols, int stages)
+{
+    vector<size_t> colStart(stages + 1, 0);
+    size_t nnzcperstage = (colptrC[cols] + stages - 1) / stages;
+    for(int i = 1; i < stages; ++i)
+        colStart[i] = std::upper_bound(colptrC, colptrC + cols + 1, i * nnzcperstage) - colptrC - 1;
+    colStart[stages] = cols;
+    return colStart;
+}
+
+template <typename FT, typename MultiplyOperation, typename AddOperation>
+size_t stagedSpGEMM(const CSC<size_t,size_t> & A, const CSC<size_t,size_t> & B, size_t * colptrC,
+        const vector<size_t> & colStart, MultiplyOperation multop, AddOperation addop,
+        std::function<size_t(const vector<FT> &)> check)
+{
+    size_t checksum = 0;
+    for(size_t b = 0; b + 1 < colStart.size(); ++b)
+    {
+        size_t start = colStart[b], end = colStart[b+1];
+        if(start == end)
+            continue;
+        vector<size_t> * RowIdsofC = new vector<size_t>[end-start];
+        vector<FT> * ValuesofC = new vector<FT>[end-start];
+        LocalSpGEMM(start, end, A, B, multop, addop, RowIdsofC, ValuesofC, colptrC, true);
+        for(size_t i = 0; i < end-start; ++i)
+            checksum += check(ValuesofC[i]);
+        delete [] RowIdsofC;
+        delete [] ValuesofC;
+    }
+    return checksum;
+}
+
+int main(int argc, char* argv[])
+{
+    cout << "\nBELLA - SpGEMM benchmark of the overlap kernel (lower triangle of A * A^T)\n" << endl;
+
+    option_t *optList, *thisOpt;
+    optList = NULL;
+    optList = GetOptList(argc, argv, (char*)"r:E:ua:g:c:l:e:k:R:C:t:n:s:v:o:S:h");
+
+    int scale = 0;              // R-MAT scale, 2^scale vertices (r)
+    int edgefactor = 16;        // R-MAT edges per vertex (E)
+    bool uniform = false;       // Erdos-Renyi instead of R-MAT (u)
+    char *matrix_file = NULL;   // A written by bella -S, A^T is the AT.mtx next to it (a)
+    incidencePars_ incidence;   // synthetic reads x k-mers matrix (g, c, l, e, k, R, C)
+    double erate = 0.15;
+    vector<int> threads;        // thread counts (t)
+    int runs = 3;               // runs per variant, the fastest is kept (n)
+    int stages = 1;             // column stages of the numeric variants (s)
+    char *filter = NULL;        // variants whose name contains this (v)
+    char *out_file = NULL;      // tab-separated results (o)
+    uint64_t seed = 1;          // (S)
+
+    while (optList!=NULL) {
+        thisOpt = optList;
+        optList = optList->next;
+        switch (thisOpt->option) {
+            case 'r': {
+                scale = atoi(thisOpt->argument);
+                break;
+            }
+            case 'E': {
+                edgefactor = atoi(thisOpt->argument);
+                break;
+            }
+            case 'u': uniform = true; break;
+            case 'a': {
+                matrix_file = strdup(thisOpt->argument);
+                break;
+            }
+            case 'g': {
+                incidence.genome = strtoull(thisOpt->argument, NULL, 10);
+                break;
+            }
+            case 'c': {
+                incidence.coverage = atof(thisOpt->argument);
+                break;
+            }
+            case 'l': {
+                incidence.readlen = strtoull(thisOpt->argument, NULL, 10);
+                break;
+            }
+            case 'e': {
+                erate = atof(thisOpt->argument);
+                break;
+            }
+            case 'k': {
+                incidence.kmer_len = atoi(thisOpt->argument);
+                break;
+            }
+            case 'R': {
+                incidence.replen = strtoull(thisOpt->argument, NULL, 10);
+                break;
+            }
+            case 'C': {
+                incidence.copies = atoi(thisOpt->argument);
+                break;
+            }
+            case 't': {
+                if(thisOpt->argument == NULL)
+                {
+                    cout << "-t requires a comma-separated list of thread counts" << endl;
+                    return 0;
+                }
+                char* list = strdup(thisOpt->argument);
+                for(char* t = strtok(list, ","); t != NULL; t = strtok(NULL, ","))
+                    threads.push_back(std::max(1, atoi(t)));
+                free(list);
+                break;
+            }
+            case 'n': {
+                runs = std::max(1, atoi(thisOpt->argument));
+                break;
+            }
+            case 's': {
+                stages = std::max(1, atoi(thisOpt->argument));
+                break;
+            }
+            case 'v': {
+                filter = strdup(thisOpt->argument);
+                break;
+            }
+            case 'o': {
+                out_file = strdup(thisOpt->argument);
+                break;
+            }
+            case 'S': {
+                seed = strtoull(thisOpt->argument, NULL, 10);
+                break;
+            }
+            case 'h': {
+                cout << "Usage:\n" << endl;
+                cout << "Input, one of (synthetic reads x k-mers matrix by default):" << endl;
+                cout << " -r : R-MAT graph of 2^r vertices from GTgraph" << endl;
+                cout << " -E : R-MAT edge factor [16]" << endl;
+                cout << " -u : Erdos-Renyi graph instead of R-MAT" << endl;
+                cout << " -a : A.mtx written by bella -S, A^T is read from the AT.mtx next to it" << endl;
+                cout << " -g : genome length in k-mers of the synthetic matrix [2000000]" << endl;
+                cout << " -c : read coverage [30]" << endl;
+                cout << " -l : read length [2000]" << endl;
+                cout << " -e : error rate, a k-mer is reliable with probability (1-e)^k [0.15]" << endl;
+                cout << " -k : k-mer length [17]" << endl;
+                cout << " -R : repeat length in k-mers, 0 for no repeats [0]" << endl;
+                cout << " -C : repeat copies [1]" << endl;
+                cout << "Benchmark:" << endl;
+                cout << " -t : comma-separated thread counts [1,2,4,... up to OMP_NUM_THREADS]" << endl;
+                cout << " -n : runs per variant, the fastest is kept [3]" << endl;
+                cout << " -s : column stages of the numeric variants [1]" << endl;
+                cout << " -v : only run the variants whose name contains this string (symbolic, count, overlap) [all]" << endl;
+                cout << " -o : write the results as tab-separated values to this file" << endl;
+                cout << " -S : random seed of the synthetic matrix [1]" << endl;
+                cout << " -h : usage\n" << endl;
+                FreeOptList(thisOpt); // done with this list, free it
+                return 0;
+            }
+        }
+    }
+
+    free(optList);
+    free(thisOpt);
+
+    int maxthreads = omp_get_max_threads();
+    if(threads.empty())
+    {
+        for(int t = 1; t < maxthreads; t *= 2)
+            threads.push_back(t);
+        threads.push_back(maxthreads);
+    }
+
+    //
+    // Input matrices: A (rows are the output rows) and B = A^T
+    //
+
+    CSC<size_t,size_t> A, B;
+    string input;
+    double build = omp_get_wtime();
+    if(matrix_file != NULL)
+    {
+        string afile(matrix_file);
+        size_t slash = afile.find_last_of('/');
+        string atfile = (slash == string::npos ? string("") : afile.substr(0, slash + 1)) + CKPT_AT;
+        A = CSC<size_t,size_t>(afile);
+        B = CSC<size_t,size_t>(atfile);
+        if(A.isEmpty() || B.isEmpty() || A.cols != B.rows || A.rows != B.cols)
+        {
+            cout << "Matrix files " << afile << " and " << atfile << " failed to open or do not match" << endl;
+            return 0;
+        }
+        input = afile;
+    }
+    else if(scale > 0)
+    {
+        double a = 0.45, b = 0.15, c = 0.15, d = 0.25;
+        if(uniform)
+            a = b = c = d = 0.25;
+        getParams();
+        setGTgraphParams(scale, edgefactor, a, b, c, d);
+        graph G;
+        graphGen(&G);
+
+        // parallel edges are merged, their weight plays the k-mer position
+        vector<tuple<size_t,size_t,size_t>> tuples(G.m), transtuples(G.m);
+        for(LONG_T e = 0; e < G.m; ++e)
+        {
+            tuples[e] = make_tuple((size_t)G.start[e], (size_t)G.end[e], (size_t)G.w[e]);
+            transtuples[e] = make_tuple((size_t)G.end[e], (size_t)G.start[e], (size_t)G.w[e]);
+        }
+        free(G.start);
+        free(G.end);
+        free(G.w);
+        A = CSC<size_t,size_t>(tuples, G.n, G.n, [] (size_t & p1, size_t & p2) { return p1; });
+        B = CSC<size_t,size_t>(transtuples, G.n, G.n, [] (size_t & p1, size_t & p2) { return p1; });
+        input = string(uniform ? "Erdos-Renyi" : "R-MAT") + " scale " + to_string(scale) + " edge factor " + to_string(edgefactor);
+    }
+    else
+    {
+        std::mt19937_64 gen(seed);
+        incidence.keep = pow(1 - erate, incidence.kmer_len);
+        incidenceMatrices(incidence, A, B, gen);
+        stringstream ss;
+        ss << "synthetic reads x k-mers, " << incidence.genome << " k-mers at " << incidence.coverage << "x";
+        if(incidence.copies > 1 && incidence.replen > 0)
+            ss << ", " << incidence.copies << " copies of a " << incidence.replen << " k-mer repeat";
+        input = ss.str();
+    }
+
+    //
+    // Symbolic phase once, for the sizes of C; the numeric variants reuse colptrC
+    //
+
+    size_t* flopC = estimateFLOP(A, B, true);
+    size_t* colnnzC = estimateNNZ_Hash(A, B, flopC, true);
+    size_t* flopptr = prefixsum<size_t>(flopC, B.cols, maxthreads);
+    size_t* colptrC = prefixsum<size_t>(colnnzC, B.cols, maxthreads);
+    size_t flops = flopptr[B.cols];
+    size_t nnzc = colptrC[B.cols];
+    delete [] flopC;
+    delete [] colnnzC;
+    delete [] flopptr;
+    vector<size_t> colStart = stageColumns(colptrC, B.cols, stages);
+    double cr = (double)flops / std::max<size_t>(nnzc, 1);
+
+    cout << "Input: " << input << " (" << omp_get_wtime() - build << "s)" << endl;
+    cout << "A: " << A.rows << " x " << A.cols << ", nnz " << A.nnz << " | flops " << flops << " | nnz(C) " << nnzc
+         << " | compression ratio " << cr << " | stages " << stages << "\n" << endl;
+
+    const double entry = sizeof(size_t) + sizeof(size_t);          // row id and value of A and B
+    auto selected = [&filter] (const char* variant) { return filter == NULL || strstr(variant, filter) != NULL; };
+    vector<spgemmResult_> results;
+
+    auto run = [&] (const char* variant, double bytes, std::function<size_t()> kernel, size_t expected)
+    {
+        for(int t : threads)
+        {
+            omp_set_num_threads(t);
+            double best = std::numeric_limits<double>::max();
+            size_t checksum = 0;
+            for(int i = 0; i < runs; ++i)
+            {
+                double start = omp_get_wtime();
+                checksum = kernel();
+                best = std::min(best, omp_get_wtime() - start);
+            }
+            if(checksum != expected)
+                cout << variant << ": checksum " << checksum << ", expected " << expected << endl;
+            results.push_back({variant, t, best, bytes});
+            cout << variant << "\t" << t << " threads\t" << best << "s\t" << flops / best << " flops/s\t"
+                 << bytes / best / 1e9 << " GB/s" << endl;
+        }
+        omp_set_num_threads(maxthreads);
+    };
+
+    // estimateFLOP and estimateNNZ_Hash each go through the columns of A once per flop
+    if(selected("symbolic"))
+        run("symbolic", 2 * (flops * sizeof(size_t) + B.nnz * sizeof(size_t)) + 2 * B.cols * sizeof(size_t), [&] ()
+        {
+            size_t* f = estimateFLOP(A, B, true);
+            size_t* n = estimateNNZ_Hash(A, B, f, true);
+            size_t total = std::accumulate(n, n + B.cols, (size_t)0);
+            delete [] f;
+            delete [] n;
+            return total;
+        }, nnzc);
+
+    // every flop adds one to a count, the counts of C sum up to the flops
+    if(selected("count"))
+        run("count", flops * entry + B.nnz * entry + nnzc * (sizeof(size_t) + sizeof(size_t)), [&] ()
+        {
+            return stagedSpGEMM<size_t>(A, B, colptrC, colStart,
+                [] (size_t & pi, size_t & pj) { return (size_t)1; },
+                [] (size_t & m1, size_t & m2) { return m1 + m2; },
+                [] (const vector<size_t> & values) { return std::accumulate(values.begin(), values.end(), (size_t)0); });
+        }, flops);
+
+    if(selected("overlap"))
+    {
+        BELLApars b_parameters;
+        int kmer_len = incidence.kmer_len;
+        run("overlap", flops * entry + B.nnz * entry + nnzc * (sizeof(size_t) + sizeof(spmatPtr_) + sizeof(spmatType_)), [&] ()
+        {
+            return stagedSpGEMM<spmatPtr_>(A, B, colptrC, colStart,
+                [] (size_t & pi, size_t & pj)
+                {   spmatPtr_ value(make_shared<spmatType_>());
+                    value->count = 1;
+                    value->pos.push_back(make_pair(pi, pj));
+                    return value;
+                },
+                [&kmer_len,&b_parameters] (spmatPtr_ & m1, spmatPtr_ & m2)
+                {
+                    for(int i = 0; i < m1->pos.size(); ++i)
+                    {
+                        int left  = m2->pos[i].first - kmer_len - b_parameters.kmerRift;
+                        int right = m2->pos[i].first + kmer_len + b_parameters.kmerRift;
+                        int newseed  = m1->pos[i].first;
+
+                        if(!isinrift(newseed, left, right))
+                        {
+                            left  = m2->pos[i].second - kmer_len - b_parameters.kmerRift;
+                            right = m2->pos[i].second + kmer_len + b_parameters.kmerRift;
+                            newseed  = m1->pos[i].second;
+
+                            if(!isinrift(newseed, left, right))
+                            {
+                                m2->count = m2->count+m1->count;
+                                m2->pos.clear();
+
+                                m2->pos.push_back(make_pair(m2->pos[i].first, m2->pos[i].second));
+                                m2->pos.push_back(make_pair(m1->pos[i].first, m1->pos[i].second));
+
+                                break;
+                            }
+                        }
+                    }
+                    return m2;
+                },
+                [] (const vector<spmatPtr_> & values) { return values.size(); });
+        }, nnzc);
+    }
+
+    //
+    // Summary, speedup over the first thread count of each variant
+    //
+
+    ofstream out;
+    if(out_file != NULL)
+    {
+        out.open(out_file);
+        if(!out.is_open())
+            cout << "Output file " << out_file << " failed to open" << endl;
+        else
+            out << "variant\tthreads\tflops\tnnz_c\tcompression_ratio\tseconds\tflops_per_s\tgb_per_s\tspeedup" << endl;
+    }
+
+    cout << "\nVariant    Threads     Seconds       Flops/s      GB/s   Speedup" << endl;
+    double first = 0;
+    for(size_t i = 0; i < results.size(); ++i)
+    {
+        const spgemmResult_ & r = results[i];
+        if(i == 0 || results[i-1].variant != r.variant)
+            first = r.seconds;
+        double gbs = r.bytes / r.seconds / 1e9;
+        printf("%-10s %7d %11.4g %13.4g %9.3f %9.2f\n", r.variant.c_str(), r.threads, r.seconds, flops / r.seconds, gbs, first / r.seconds);
+        if(out.is_open())
+            out << r.variant << "\t" << r.threads << "\t" << flops << "\t" << nnzc << "\t" << cr << "\t" << r.seconds << "\t"
+                << flops / r.seconds << "\t" << gbs << "\t" << first / r.seconds << endl;
+    }
+    if(out.is_open())
+        cout << "\nResults written to " << out_file << endl;
+
+    delete [] colptrC;
+    return 0;
+}
@@ -0,0 +1,73 @@
+#ifndef _SYNTHETIC_H_
+#define _SYNTHETIC_H_
+
+#include "CSC.h"
+#include <vector>
+#include <tuple>
+#include <random>
+#include <algorithm>
+#include <stdint.h>
+
+/* Synthetic reads x k-mers incidence matrices, shaped like the A and A^T that BELLA multiplies
+ *
+ * Reads of <readlen> bases start uniformly on a genome of <genome> k-mer positions, <coverage> times over. A k-mer of a
+ * read is reliable (error-free, so it is in the matrix) with probability <keep>, (1-e)^k for an error rate e. Its value
+ * is its position on the read. With <copies> > 1, that many copies of a repeat of <replen> k-mers are planted on the
+ * genome and share their k-mer ids: the columns of a repeat hold <copies> times more reads, the tail of the k-mer
+ * multiplicity spectrum that BELLA's reliable upper bound usually cuts.
+ */
+
+struct incidencePars_ {
+	size_t genome = 2000000;	// k-mer positions on the genome
+	double coverage = 30;
+	size_t readlen = 2000;
+	int kmer_len = 17;
+	double keep = 0.063;		// (1-0.15)^17
+	size_t replen = 0;			// k-mers per repeat copy, 0 = no repeats
+	int copies = 1;
+};
+
+template <typename Generator>
+void incidenceMatrices(const incidencePars_ & pars, CSC<size_t,size_t> & A, CSC<size_t,size_t> & AT, Generator & gen)
+{
+	std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+	std::vector<size_t> kmerid(pars.genome);
+	for(size_t p = 0; p < pars.genome; ++p)
+		kmerid[p] = p;
+	if(pars.copies > 1 && pars.replen > 0 && pars.replen < pars.genome)
+	{
+		std::uniform_int_distribution<size_t> where(0, pars.genome - pars.replen);
+		size_t first = where(gen);
+		for(int c = 1; c < pars.copies; ++c)
+		{
+			size_t at = where(gen);
+			for(size_t q = 0; q < pars.replen; ++q)
+				kmerid[at + q] = first + q;
+		}
+	}
+
+	std::uniform_int_distribution<size_t> where(0, pars.genome - std::min(pars.genome, pars.readlen));
+	size_t nreads = std::max<size_t>(2, (size_t)(pars.coverage * pars.genome / pars.readlen));
+	std::vector<std::tuple<size_t,size_t,size_t>> tuples;
+	std::vector<std::tuple<size_t,size_t,size_t>> transtuples;
+	for(size_t r = 0; r < nreads; ++r)
+	{
+		size_t start = where(gen);
+		for(size_t p = 0; p + pars.kmer_len <= pars.readlen && start + p < pars.genome; ++p)
+		{
+			if(unit(gen) < pars.keep)
+			{
+				tuples.push_back(std::make_tuple(r, kmerid[start + p], p));
+				transtuples.push_back(std::make_tuple(kmerid[start + p], r, p));
+			}
+		}
+	}
+
+	// a read that crosses two copies of a repeat has the k-mer twice, one position is kept as in BELLA
+	A = CSC<size_t,size_t>(tuples, nreads, pars.genome, [] (size_t & p1, size_t &) { return p1; });
+	std::vector<std::tuple<size_t,size_t,size_t>>().swap(tuples);
+	AT = CSC<size_t,size_t>(transtuples, pars.genome, nreads, [] (size_t & p1, size_t &) { return p1; });
+}
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include <omp.h>
+#include <string>
+#include <vector>
+#include <utility>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <stdint.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#if defined (__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define NUM_HW_COUNTERS 3   // cycles, instructions, last-level cache misses
+
+/**
+ * @brief perfCounters_ counts hardware events of every OpenMP thread with perf_event_open (Linux only)
+ * Counters are opened once per thread of the pool and read (summed over threads) at phase boundaries;
+ * when the kernel refuses them (perf_event_paranoid, containers, no PMU) they are reported as unavailable
+ */
+struct perfCounters_
+{
+	std::vector<int> fds;	// NUM_HW_COUNTERS per thread, -1 if not available
+	bool available = false;
+
+	void open(int threads)
+	{
+		fds.assign(threads * NUM_HW_COUNTERS, -1);
+#if defined (__linux__)
+		const uint64_t configs[NUM_HW_COUNTERS] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES };
+		#pragma omp parallel num_threads(threads)
+		{
+			int t = omp_get_thread_num();
+			for(int c = 0; c < NUM_HW_COUNTERS; ++c)
+			{
+				struct perf_event_attr attr;
+				memset(&attr, 0, sizeof(attr));
+				attr.size = sizeof(attr);
+				attr.type = PERF_TYPE_HARDWARE;
+				attr.config = configs[c];
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				fds[t*NUM_HW_COUNTERS + c] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);	// this thread, any CPU
+			}
+		}
+		available = true;
+		for(int fd : fds)
+			if(fd < 0) available = false;
+#endif
+	}
+
+	void read(uint64_t * totals) const
+	{
+		for(int c = 0; c < NUM_HW_COUNTERS; ++c)
+			totals[c] = 0;
+#if defined (__linux__)
+		if(!available) return;
+		for(size_t i = 0; i < fds.size(); ++i)
+		{
+			uint64_t value = 0;
+			if(::read(fds[i], &value, sizeof(value)) == sizeof(value))
+				totals[i % NUM_HW_COUNTERS] += value;
+		}
+#endif
+	}
+
+	~perfCounters_()
+	{
+#if defined (__linux__)
+		for(int fd : fds)
+			if(fd >= 0) close(fd);
+#endif
+	}
+};
+
+/* wall and CPU time, I/O and hardware counters at one point of the run */
+struct telemetrySample_
+{
+	double wall;
+	double cpu;				// user + system time of all threads
+	uint64_t bytesread;		// read()/write() bytes of the process (/proc/self/io)
+	uint64_t byteswritten;
+	uint64_t hw[NUM_HW_COUNTERS];
+};
+
+struct phaseRecord_
+{
+	std::string name;
+	int depth;				// nesting level, 0 for top-level phases
+	double wall;
+	double cpu;
+	double peakrss;			// MB, high-water mark of the process at the end of the phase
+	uint64_t bytesread;
+	uint64_t byteswritten;
+	uint64_t hw[NUM_HW_COUNTERS];
+};
+
+typedef std::vector<std::pair<std::string, double>> metrics_;
+
+/**
+ * @brief Telemetry collects the phases, per-stage metrics and run-level metrics of one run and writes them as JSON (-j)
+ * The phases are also timed when no report is requested: it costs a handful of system calls per phase
+ */
+class Telemetry
+{
+public:
+	Telemetry(): enabled(false) {}
+
+	void start(const std::string & file, int threads, const std::string & command)
+	{
+		enabled = true;
+		filename = file;
+		this->threads = threads;
+		this->command = command;
+		counters.open(threads);
+		if(!counters.available)
+			std::cout << "Hardware counters are not available (perf_event_open), the report will not include them" << std::endl;
+	}
+
+	void begin(const std::string & name)
+	{
+		running.push_back(std::make_pair(name, sample()));
+	}
+
+	void end()
+	{
+		if(running.empty()) return;
+		telemetrySample_ now = sample();
+		const telemetrySample_ & then = running.back().second;
+
+		phaseRecord_ phase;
+		phase.name = running.back().first;
+		phase.depth = running.size()-1;
+		phase.wall = now.wall - then.wall;
+		phase.cpu = now.cpu - then.cpu;
+		phase.bytesread = now.bytesread - then.bytesread;
+		phase.byteswritten = now.byteswritten - then.byteswritten;
+		for(int c = 0; c < NUM_HW_COUNTERS; ++c)
+			phase.hw[c] = now.hw[c] - then.hw[c];
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		phase.peakrss = usage.ru_maxrss / 1024.0;	// KB on Linux
+		phases.push_back(phase);
+		running.pop_back();
+	}
+
+	void metric(const std::string & name, double value) { runmetrics.push_back(std::make_pair(name, value)); }
+	void stage(const metrics_ & m) { stages.push_back(m); }
+
+	bool write() const
+	{
+		if(!enabled) return true;
+		std::ofstream out(filename.c_str());
+		if(!out)
+		{
+			std::cerr << "File " << filename << " failed to open" << std::endl;
+			return false;
+		}
+		out.precision(12);
+		out << "{\n  \"command\": \"" << escape(command) << "\",\n  \"threads\": " << threads << ",\n";
+		out << "  \"hardware_counters\": " << (counters.available ? "true" : "false") << ",\n";
+		out << "  \"metrics\": ";
+		writeMetrics(out, runmetrics);
+		out << ",\n  \"phases\": [";
+		for(size_t i = 0; i < phases.size(); ++i)
+		{
+			const phaseRecord_ & p = phases[i];
+			out << (i ? ",\n" : "\n") << "    {\"name\": \"" << escape(p.name) << "\", \"depth\": " << p.depth << ", \"wall_s\": " << p.wall << ", \"cpu_s\": " << p.cpu
+				<< ", \"peak_rss_mb\": " << p.peakrss << ", \"bytes_read\": " << p.bytesread << ", \"bytes_written\": " << p.byteswritten;
+			if(counters.available)
+				out << ", \"cycles\": " << p.hw[0] << ", \"instructions\": " << p.hw[1] << ", \"llc_misses\": " << p.hw[2];
+			out << "}";
+		}
+		out << "\n  ],\n  \"stages\": [";
+		for(size_t i = 0; i < stages.size(); ++i)
+		{
+			out << (i ? ",\n" : "\n") << "    ";
+			writeMetrics(out, stages[i]);
+		}
+		out << "\n  ]\n}\n";
+		return out.good();
+	}
+
+	bool enabled;
+
+private:
+	telemetrySample_ sample() const
+	{
+		telemetrySample_ s;
+		s.wall = omp_get_wtime();
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		s.cpu = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+		s.bytesread = s.byteswritten = 0;
+		std::ifstream io("/proc/self/io");
+		std::string key;
+		uint64_t value;
+		while(io >> key >> value)
+		{
+			if(key == "rchar:") s.bytesread = value;
+			else if(key == "wchar:") s.byteswritten = value;
+		}
+		counters.read(s.hw);
+		return s;
+	}
+
+	static std::string escape(const std::string & s)
+	{
+		std::string e;
+		for(char c : s)
+		{
+			if(c == '"' || c == '\\') e.push_back('\\');
+			e.push_back(c);
+		}
+		return e;
+	}
+
+	static void writeMetrics(std::ofstream & out, const metrics_ & m)
+	{
+		out << "{";
+		for(size_t i = 0; i < m.size(); ++i)
+		{
+			out << (i ? ", " : "") << "\"" << escape(m[i].first) << "\": ";
+			if(std::isfinite(m[i].second)) out << m[i].second;
+			else out << "null";	// e.g. a ratio over an empty stage
+		}
+		out << "}";
+	}
+
+	std::string filename;
+	std::string command;
+	int threads;
+	perfCounters_ counters;
+	std::vector<std::pair<std::string, telemetrySample_>> running;	// phases that have begun and not ended, innermost last
+	std::vector<phaseRecord_> phases;
+	std::vector<metrics_> stages;
+	metrics_ runmetrics;
+};
+
+Telemetry telemetry;
+
+/**
+ * @brief ScopedPhase times the enclosing scope as a telemetry phase
+ */
+class ScopedPhase
+{
+public:
+	ScopedPhase(const std::string & name) { telemetry.begin(name); }
+	~ScopedPhase() { telemetry.end(); }
+};
+
+#endif
@@ -0,0 +1,296 @@
+#ifndef _WRITER_H_
+#define _WRITER_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <type_traits>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/**
+ * @brief OutputBuffer is a fixed-size block of complete output lines
+ */
+struct OutputBuffer
+{
+    OutputBuffer(size_t cap): data(new char[cap]), size(0), capacity(cap), lines(0) {}
+    ~OutputBuffer() { delete [] data; }
+
+    char * data;
+    size_t size;
+    size_t capacity;
+    size_t lines;
+};
+
+class OverlapWriter;
+
+/**
+ * @brief OutputStream is the handle a thread formats its lines into (integers are formatted without iostream)
+ * Only complete lines leave the thread: when the next field does not fit, the lines completed so far are handed
+ * to the writer and the unfinished one moves to an empty buffer
+ */
+class OutputStream
+{
+public:
+    OutputStream(): buf(NULL), committed(0), writer(NULL) {}
+
+    OutputStream & operator<<(const std::string & s) { append(s.data(), s.length()); return *this; }
+    OutputStream & operator<<(const char * s) { append(s, strlen(s)); return *this; }
+    OutputStream & operator<<(char c)
+    {
+        append(&c, 1);
+        if(c == '\n')
+        {
+            committed = buf->size;
+            ++buf->lines;
+        }
+        return *this;
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value, OutputStream &>::type operator<<(T value)
+    {
+        char digits[24];
+        int pos = sizeof(digits);
+        bool negative = (value < 0);
+        uint64_t v = negative ? (uint64_t)(-(int64_t)value) : (uint64_t)value;
+        do
+        {
+            digits[--pos] = '0' + (v % 10);
+            v /= 10;
+        } while(v != 0);
+        if(negative) digits[--pos] = '-';
+        append(digits+pos, sizeof(digits)-pos);
+        return *this;
+    }
+
+    // a binary record counts as one complete line
+    void write(const void * record, size_t len)
+    {
+        append((const char *)record, len);
+        committed = buf->size;
+        ++buf->lines;
+    }
+
+    inline void append(const char * s, size_t len);
+
+    OutputBuffer * buf;     // buffer being filled
+    size_t committed;       // bytes of buf holding complete lines
+    OverlapWriter * writer;
+};
+
+/**
+ * @brief OverlapWriter streams the output lines of all threads to the output file while the alignment goes on
+ * Each thread fills its own OutputStream; full buffers are queued to a background thread that appends them to the file
+ * with pwrite. A fixed pool of buffers (two per thread) bounds the memory: a thread that finds the pool empty waits
+ * for the writer. Lines of different threads are interleaved in no particular order but are never split.
+ */
+class OverlapWriter
+{
+public:
+    OverlapWriter(const char * filename, int nthreads, size_t buffersize = (1 << 20)):
+        byteswritten(0), lineswritten(0), buffersize(buffersize), done(false), failed(false), writing(0), streams(nthreads)
+    {
+        fd = open(filename, O_WRONLY | O_CREAT, 0644);
+        if(fd < 0)
+        {
+            fprintf(stderr, "File %s failed to open\n", filename);
+            failed = true;
+        }
+        struct stat st;
+        offset = (fd >= 0 && fstat(fd, &st) == 0) ? st.st_size : 0;   // append to what is already there
+
+        for(int i = 0; i < 2*nthreads; ++i)
+            pool.push_back(new OutputBuffer(buffersize));
+        freebuffers = pool;
+
+        for(int t = 0; t < nthreads; ++t)
+        {
+            streams[t].writer = this;
+            streams[t].buf = takeFree();
+        }
+        background = std::thread(&OverlapWriter::run, this);
+    }
+
+    ~OverlapWriter()
+    {
+        flush();
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            done = true;
+        }
+        filled.notify_all();
+        background.join();
+        if(fd >= 0) close(fd);
+        for(OutputBuffer * b : pool) delete b;
+    }
+
+    OutputStream & stream(int thread) { return streams[thread]; }
+
+    // hand the complete lines of a stream to the writer thread and move its unfinished line to an empty buffer
+    void rotate(OutputStream & os)
+    {
+        OutputBuffer * full = os.buf;
+        OutputBuffer * next = takeFree();
+
+        size_t tail = full->size - os.committed;
+        if(tail > next->capacity)   // a single line larger than a buffer (e.g. a long CIGAR): grow this buffer
+        {
+            delete [] next->data;
+            next->capacity = std::max(2*tail, buffersize);
+            next->data = new char[next->capacity];
+        }
+        memcpy(next->data, full->data + os.committed, tail);
+        next->size = tail;
+        full->size = os.committed;
+
+        submit(full);
+        os.buf = next;
+        os.committed = 0;
+    }
+
+    // queue the lines of all threads and wait until everything is on disk (call outside parallel regions)
+    void flush()
+    {
+        for(OutputStream & os : streams)
+        {
+            if(os.buf->size > 0)
+                rotate(os);
+        }
+        std::unique_lock<std::mutex> lock(mtx);
+        drained.wait(lock, [this] { return queue.empty() && writing == 0; });
+    }
+
+    // flush and make the file durable, e.g. before a checkpoint refers to its size (call outside parallel regions)
+    bool sync()
+    {
+        flush();
+        return !failed && fsync(fd) == 0;
+    }
+
+    // size of the file once the queued buffers are written
+    size_t size() const { return offset; }
+
+    size_t memoryFootprint() const { return pool.size() * buffersize; }
+
+    size_t byteswritten;
+    size_t lineswritten;
+
+private:
+    OutputBuffer * takeFree()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        released.wait(lock, [this] { return !freebuffers.empty(); });
+        OutputBuffer * b = freebuffers.back();
+        freebuffers.pop_back();
+        return b;
+    }
+
+    void submit(OutputBuffer * b)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            queue.push_back(b);
+        }
+        filled.notify_one();
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        while(true)
+        {
+            filled.wait(lock, [this] { return done || !queue.empty(); });
+            if(queue.empty() && done)
+                break;
+
+            OutputBuffer * b = queue.front();
+            queue.pop_front();
+            ++writing;
+            off_t at = offset;
+            offset += b->size;
+            lock.unlock();
+
+            size_t written = 0;
+            while(!failed && written < b->size)
+            {
+                ssize_t w = pwrite(fd, b->data + written, b->size - written, at + written);
+                if(w < 0)
+                {
+                    fprintf(stderr, "Writing the output failed\n");
+                    failed = true;
+                    break;
+                }
+                written += w;
+            }
+
+            // a buffer grown for a long line goes back to the pool at its normal size, the pool stays within the plan
+            if(b->capacity > buffersize)
+            {
+                delete [] b->data;
+                b->data = new char[buffersize];
+                b->capacity = buffersize;
+            }
+
+            lock.lock();
+            byteswritten += b->size;
+            lineswritten += b->lines;
+            b->size = 0;
+            b->lines = 0;
+            freebuffers.push_back(b);
+            --writing;
+            released.notify_one();
+            if(queue.empty() && writing == 0)
+                drained.notify_all();
+        }
+    }
+
+    int fd;
+    off_t offset;           // end of the file, where the next buffer goes
+    size_t buffersize;
+    bool done;
+    std::atomic<bool> failed;   // set by the writer thread, read by the others
+    int writing;            // buffers being written right now
+
+    std::vector<OutputStream> streams;          // one per thread
+    std::vector<OutputBuffer *> pool;           // all buffers
+    std::vector<OutputBuffer *> freebuffers;    // buffers owned by nobody
+    std::deque<OutputBuffer *> queue;           // buffers waiting for the writer thread
+
+    std::mutex mtx;
+    std::condition_variable filled;
+    std::condition_variable released;
+    std::condition_variable drained;
+    std::thread background;
+};
+
+inline void OutputStream::append(const char * s, size_t len)
+{
+    if(buf->size + len > buf->capacity)
+    {
+        writer->rotate(*this);
+        if(buf->size + len > buf->capacity)     // the current line alone does not fit: grow the buffer
+        {
+            size_t cap = std::max(2*(buf->size + len), buf->capacity);
+            char * bigger = new char[cap];
+            memcpy(bigger, buf->data, buf->size);
+            delete [] buf->data;
+            buf->data = bigger;
+            buf->capacity = cap;
+        }
+    }
+    memcpy(buf->data + buf->size, s, len);
+    buf->size += len;
+}
+
+#endif